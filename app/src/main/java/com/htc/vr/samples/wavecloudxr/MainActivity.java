@@ -12,11 +12,16 @@ import android.content.pm.PackageManager;
 import android.content.res.AssetManager;
 import android.os.Bundle;
 import android.util.Log;
+import android.view.Display;
+import android.view.WindowManager;
+
+import java.util.Arrays;
 
 public class MainActivity extends VRActivity {
     private static final String TAG = "WaveCloudXRJAVA";
     private final int PERMISSION_REQUEST_CODE = 1;
     private boolean mPermissionGranted = false;
+    private static MainActivity sInstance;
 
     static {
         System.loadLibrary("WaveCloudXRJNI");
@@ -30,6 +35,9 @@ public class MainActivity extends VRActivity {
     @Override
     protected void onCreate(Bundle icicle) {
         super.onCreate(icicle);
+        sInstance = this;
+        // Before nativeInit, the native main reads the rates when it queries the device
+        nativeSetRefreshRates(getSupportedRefreshRates());
         nativeInit(getResources().getAssets());
 
         try {
@@ -97,8 +105,50 @@ public class MainActivity extends VRActivity {
         OnPermission();
     }
 
+    // Refresh rates of the display modes at the current resolution
+    private float[] getSupportedRefreshRates() {
+        Display display = getWindowManager().getDefaultDisplay();
+        Display.Mode current = display.getMode();
+        Display.Mode[] modes = display.getSupportedModes();
+        float[] rates = new float[modes.length];
+        int count = 0;
+        for (Display.Mode mode : modes) {
+            if (mode.getPhysicalWidth() == current.getPhysicalWidth() &&
+                mode.getPhysicalHeight() == current.getPhysicalHeight()) {
+                rates[count++] = mode.getRefreshRate();
+            }
+        }
+        return Arrays.copyOf(rates, count);
+    }
+
+    // Called from native code by the refresh rate negotiator, applied on the UI thread
+    static void requestRefreshRate(final float hz) {
+        final MainActivity activity = sInstance;
+        if (activity == null) return;
+        activity.runOnUiThread(new Runnable() {
+            @Override
+            public void run() {
+                Display display = activity.getWindowManager().getDefaultDisplay();
+                Display.Mode current = display.getMode();
+                for (Display.Mode mode : display.getSupportedModes()) {
+                    if (mode.getPhysicalWidth() == current.getPhysicalWidth() &&
+                        mode.getPhysicalHeight() == current.getPhysicalHeight() &&
+                        Math.abs(mode.getRefreshRate() - hz) < 0.5f) {
+                        WindowManager.LayoutParams params = activity.getWindow().getAttributes();
+                        params.preferredDisplayModeId = mode.getModeId();
+                        activity.getWindow().setAttributes(params);
+                        Log.i(TAG, "Display mode " + mode.getModeId() + " at " + mode.getRefreshRate() + " Hz requested");
+                        return;
+                    }
+                }
+                Log.w(TAG, "No display mode at " + hz + " Hz");
+            }
+        });
+    }
+
     // JNI
     static native void nativeInit(AssetManager am);
+    static native void nativeSetRefreshRates(float[] rates);
     static native void nativeOnPause();
     static native void nativeOnResume();
 }
@@ -0,0 +1,288 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <new>
+
+#include "AllocTracker.h"
+
+#ifdef CXR_TRACK_ALLOCATIONS
+
+/*
+ * Counters live in a fixed table reached through a pthread key: thread_local may
+ * allocate its storage on first use, which would recurse into the hooks.
+ * Everything here is trivially constructible so it is usable before static init.
+ * */
+namespace {
+
+struct ThreadCounters
+{
+    std::atomic<pid_t> tid;             // 0 free, -1 being claimed
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> violations;
+    std::atomic<const char*> violationRegion;
+    std::atomic<uint32_t> violationSize;
+
+    // Owner thread only
+    int noAllocDepth;
+    int allowedDepth;
+    const char* region;
+
+    // As of the last report
+    std::atomic<uint64_t> reportedAllocations;
+    std::atomic<uint64_t> reportedBytes;
+    std::atomic<uint64_t> reportedViolations;
+};
+
+const int kMaxThreads = 64;
+ThreadCounters sThreads[kMaxThreads];
+ThreadCounters sExited;                 // folded in when a thread ends
+std::atomic<uint64_t> sUntracked;       // allocations of threads beyond kMaxThreads
+pthread_key_t sKey;
+pthread_once_t sKeyOnce = PTHREAD_ONCE_INIT;
+
+uint64_t Unreported(std::atomic<uint64_t>& total, std::atomic<uint64_t>& reported) {
+    return total.load(std::memory_order_relaxed) - reported.load(std::memory_order_relaxed);
+}
+
+void ReleaseThread(void* value) {
+    ThreadCounters* t = (ThreadCounters*)value;
+    sExited.allocations.fetch_add(Unreported(t->allocations, t->reportedAllocations), std::memory_order_relaxed);
+    sExited.bytes.fetch_add(Unreported(t->bytes, t->reportedBytes), std::memory_order_relaxed);
+    uint64_t violations = Unreported(t->violations, t->reportedViolations);
+    if (violations) {
+        sExited.violations.fetch_add(violations, std::memory_order_relaxed);
+        sExited.violationRegion.store(t->violationRegion.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sExited.violationSize.store(t->violationSize.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    t->tid.store(0, std::memory_order_release);
+}
+
+void CreateKey() {
+    pthread_key_create(&sKey, ReleaseThread);
+}
+
+ThreadCounters* CurrentThread() {
+    pthread_once(&sKeyOnce, CreateKey);
+    ThreadCounters* t = (ThreadCounters*)pthread_getspecific(sKey);
+    if (t) {
+        return t;
+    }
+
+    for (int i = 0; i < kMaxThreads; i++) {
+        pid_t expected = 0;
+        if (!sThreads[i].tid.compare_exchange_strong(expected, -1)) continue;
+        t = &sThreads[i];
+        t->allocations = 0;
+        t->bytes = 0;
+        t->violations = 0;
+        t->violationRegion = nullptr;
+        t->violationSize = 0;
+        t->noAllocDepth = 0;
+        t->allowedDepth = 0;
+        t->region = nullptr;
+        t->reportedAllocations = 0;
+        t->reportedBytes = 0;
+        t->reportedViolations = 0;
+        t->tid.store((pid_t)syscall(SYS_gettid), std::memory_order_release);
+        pthread_setspecific(sKey, t);
+        return t;
+    }
+    return nullptr;
+}
+
+void OnAllocate(size_t size) {
+    ThreadCounters* t = CurrentThread();
+    if (t == nullptr) {
+        sUntracked.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    t->allocations.fetch_add(1, std::memory_order_relaxed);
+    t->bytes.fetch_add(size, std::memory_order_relaxed);
+    if (t->noAllocDepth > 0 && t->allowedDepth == 0) {
+        t->violations.fetch_add(1, std::memory_order_relaxed);
+        t->violationRegion.store(t->region, std::memory_order_relaxed);
+        t->violationSize.store((uint32_t)size, std::memory_order_relaxed);
+#ifdef CXR_ALLOC_ASSERT
+        __android_log_assert(nullptr, LOG_TAG, "[Alloc] %zu byte allocation in no-alloc region %s", size, t->region);
+#endif
+    }
+}
+
+void LogCounters(const char* name, ThreadCounters& t) {
+    uint64_t allocations = t.allocations.load(std::memory_order_relaxed);
+    uint64_t bytes = t.bytes.load(std::memory_order_relaxed);
+    uint64_t violations = t.violations.load(std::memory_order_relaxed);
+    uint64_t newAllocations = allocations - t.reportedAllocations.exchange(allocations);
+    uint64_t newBytes = bytes - t.reportedBytes.exchange(bytes);
+    uint64_t newViolations = violations - t.reportedViolations.exchange(violations);
+    if (newAllocations == 0) {
+        return;
+    }
+
+    if (newViolations) {
+        const char* region = t.violationRegion.load(std::memory_order_relaxed);
+        LOGW("[Alloc] %s: %llu allocations, %llu B, %llu in no-alloc regions, last %u B in %s",
+             name, (unsigned long long)newAllocations, (unsigned long long)newBytes,
+             (unsigned long long)newViolations, t.violationSize.load(std::memory_order_relaxed),
+             region ? region : "?");
+    } else {
+        LOGI("[Alloc] %s: %llu allocations, %llu B",
+             name, (unsigned long long)newAllocations, (unsigned long long)newBytes);
+    }
+}
+
+}
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+// Linked with -Wl,--wrap, so these only see calls made from this library
+void* __wrap_malloc(size_t size) {
+    OnAllocate(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    OnAllocate(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (size) OnAllocate(size);
+    return __real_realloc(ptr, size);
+}
+}
+
+static void* NewImpl(size_t size) {
+    if (size == 0) size = 1;
+    OnAllocate(size);
+    void* p;
+    while ((p = __real_malloc(size)) == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+    return p;
+}
+
+void* operator new(size_t size) {
+    return NewImpl(size);
+}
+
+void* operator new[](size_t size) {
+    return NewImpl(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    if (size == 0) size = 1;
+    OnAllocate(size);
+    return __real_malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept {
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+bool AllocTracker::Enabled() {
+    return true;
+}
+
+AllocCounters AllocTracker::Current() {
+    AllocCounters counters;
+    ThreadCounters* t = CurrentThread();
+    if (t) {
+        counters.allocations = t->allocations.load(std::memory_order_relaxed);
+        counters.bytes = t->bytes.load(std::memory_order_relaxed);
+        counters.violations = t->violations.load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+void AllocTracker::EnterNoAlloc(const char* region) {
+    ThreadCounters* t = CurrentThread();
+    if (t && t->noAllocDepth++ == 0) {
+        t->region = region;
+    }
+}
+
+void AllocTracker::LeaveNoAlloc() {
+    ThreadCounters* t = CurrentThread();
+    if (t && t->noAllocDepth > 0 && --t->noAllocDepth == 0) {
+        t->region = nullptr;
+    }
+}
+
+void AllocTracker::EnterAllowed() {
+    ThreadCounters* t = CurrentThread();
+    if (t) t->allowedDepth++;
+}
+
+void AllocTracker::LeaveAllowed() {
+    ThreadCounters* t = CurrentThread();
+    if (t && t->allowedDepth > 0) t->allowedDepth--;
+}
+
+void AllocTracker::LogReport() {
+    for (int i = 0; i < kMaxThreads; i++) {
+        ThreadCounters& t = sThreads[i];
+        pid_t tid = t.tid.load(std::memory_order_acquire);
+        if (tid <= 0) continue;
+
+        // Threads name themselves after their first allocation, read it now
+        char path[64];
+        char name[16] = "?";
+        snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+        FILE* file = fopen(path, "r");
+        if (file) {
+            if (fgets(name, sizeof(name), file)) name[strcspn(name, "\n")] = 0;
+            fclose(file);
+        }
+        char label[40];
+        snprintf(label, sizeof(label), "%s (%d)", name, tid);
+        LogCounters(label, t);
+    }
+    LogCounters("exited threads", sExited);
+
+    uint64_t untracked = sUntracked.exchange(0, std::memory_order_relaxed);
+    if (untracked) {
+        LOGW("[Alloc] %llu allocations on threads beyond the %d tracked", (unsigned long long)untracked, kMaxThreads);
+    }
+}
+
+#else
+
+bool AllocTracker::Enabled() { return false; }
+AllocCounters AllocTracker::Current() { return AllocCounters(); }
+void AllocTracker::LogReport() {}
+void AllocTracker::EnterNoAlloc(const char*) {}
+void AllocTracker::LeaveNoAlloc() {}
+void AllocTracker::EnterAllowed() {}
+void AllocTracker::LeaveAllowed() {}
+
+#endif
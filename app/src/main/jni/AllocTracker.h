@@ -0,0 +1,63 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+
+struct AllocCounters
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t violations = 0;    // made inside a NoAllocScope
+};
+
+/*
+ * Opt-in heap allocation accounting, built with CXR_TRACK_ALLOCATIONS (see Android.mk).
+ * operator new and this library's malloc, calloc and realloc calls are counted per
+ * thread. Code that must not allocate runs inside a NoAllocScope, an allocation there
+ * is a violation, and aborts when also built with CXR_ALLOC_ASSERT.
+ * Without CXR_TRACK_ALLOCATIONS nothing is hooked and the scopes are empty.
+ * */
+class AllocTracker
+{
+public:
+    static bool Enabled();
+
+    // Calling thread, since it first allocated
+    static AllocCounters Current();
+
+    // One line per thread that allocated since the last report
+    static void LogReport();
+
+    static void EnterNoAlloc(const char* region);
+    static void LeaveNoAlloc();
+    static void EnterAllowed();
+    static void LeaveAllowed();
+};
+
+// The enclosed code must not allocate, e.g. NoAllocScope noAlloc("renderFrame");
+class NoAllocScope
+{
+public:
+#ifdef CXR_TRACK_ALLOCATIONS
+    explicit NoAllocScope(const char* region) { AllocTracker::EnterNoAlloc(region); }
+    ~NoAllocScope() { AllocTracker::LeaveNoAlloc(); }
+#else
+    explicit NoAllocScope(const char*) {}
+#endif
+    NoAllocScope(const NoAllocScope&) = delete;
+    NoAllocScope& operator=(const NoAllocScope&) = delete;
+};
+
+// One-time setup inside a no-alloc region, e.g. a buffer sized on first use
+class AllocAllowedScope
+{
+public:
+#ifdef CXR_TRACK_ALLOCATIONS
+    AllocAllowedScope() { AllocTracker::EnterAllowed(); }
+    ~AllocAllowedScope() { AllocTracker::LeaveAllowed(); }
+#else
+    AllocAllowedScope() {}
+#endif
+    AllocAllowedScope(const AllocAllowedScope&) = delete;
+    AllocAllowedScope& operator=(const AllocAllowedScope&) = delete;
+};
@@ -29,6 +29,30 @@ COMMON_INCLUDES := \
 
 COMMON_FILES := \
  WaveCloudXRApp.cpp \
+ StartupOrchestrator.cpp \
+ TuningConfig.cpp \
+ ServerProbe.cpp \
+ ThreadManager.cpp \
+ FrameTracker.cpp \
+ PoseLatencyTracker.cpp \
+ MotionRecorder.cpp \
+ AsyncLog.cpp \
+ StatsServer.cpp \
+ EyeTextureQueue.cpp \
+ ControllerManager.cpp \
+ HandTracker.cpp \
+ UserDataChannel.cpp \
+ LifecycleEventQueue.cpp \
+ AllocTracker.cpp \
+ StallWatchdog.cpp \
+ FlightRecorder.cpp \
+ ClientProfile.cpp \
+ VoiceActivity.cpp \
+ MicUplink.cpp \
+ RefreshRateNegotiator.cpp \
+ SwapchainPlanner.cpp \
+ PredictionTuner.cpp \
+ PoseSampler.cpp \
  jni.cpp
 
 #USE_CONTROLLER use device controller.
@@ -39,6 +63,15 @@ LOCAL_MODULE    := WaveCloudXRJNI
 LOCAL_C_INCLUDES := $(COMMON_INCLUDES)
 LOCAL_SRC_FILES := $(COMMON_FILES)
 LOCAL_CPPFLAGS += -fexceptions
+# Heap allocation tracking, see AllocTracker.h: ndk-build CXR_TRACK_ALLOCATIONS=1,
+# add CXR_ALLOC_ASSERT=1 to abort on an allocation inside a no-alloc region
+ifeq ($(CXR_TRACK_ALLOCATIONS),1)
+LOCAL_CPPFLAGS += -DCXR_TRACK_ALLOCATIONS
+LOCAL_LDFLAGS += -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+ifeq ($(CXR_ALLOC_ASSERT),1)
+LOCAL_CPPFLAGS += -DCXR_ALLOC_ASSERT
+endif
+endif
 LOCAL_LDLIBS    := -llog -ljnigraphics -landroid -lEGL -lGLESv3
 LOCAL_SHARED_LIBRARIES := wvr_api Oboe CloudXRClient
 include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,357 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include "AsyncLog.h"
+#include "AllocTracker.h"
+
+#define ASYNC_LOG_TAG "WaveCloudXRJNI"
+#define LOG_WINDOW_NS 1000000000LL
+#define LOG_LINES_PER_SITE 5            // per call site per window
+#define LOG_WRITER_PERIOD_MS 5
+
+using namespace AsyncLogDetail;
+
+uint8_t* Ring::reserve(uint32_t size, uint32_t& newTail) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t index = t & (CAPACITY - 1);
+    uint32_t contiguous = CAPACITY - index;
+
+    // A record never wraps, the rest of the buffer is skipped instead
+    uint32_t needed = size <= contiguous ? size : contiguous + size;
+    if (CAPACITY - (t - h) < needed) {
+        return nullptr;
+    }
+
+    if (size > contiguous) {
+        uint32_t wrap = RECORD_WRAP;
+        memcpy(buffer + index, &wrap, sizeof(wrap));
+        t += contiguous;
+        index = 0;
+    }
+    newTail = t + size;
+    return buffer + index;
+}
+
+// Releases the ring when its thread exits, the writer still drains it
+struct RingOwner
+{
+    Ring* ring = nullptr;
+    ~RingOwner() {
+        if (ring) ring->owned.store(false, std::memory_order_release);
+    }
+};
+static thread_local RingOwner tRingOwner;
+
+void AsyncLog::WriteSync(int prio, const char* tag, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    __android_log_vprint(prio, tag, fmt, args);
+    va_end(args);
+}
+
+AsyncLog& AsyncLog::Instance() {
+    static AsyncLog instance;
+    return instance;
+}
+
+Ring* AsyncLog::threadRing() {
+    if (tRingOwner.ring) {
+        return tRingOwner.ring;
+    }
+
+    // Reuse the ring of an exited thread before allocating one
+    Ring* ring = nullptr;
+    for (Ring* r = mRings.load(std::memory_order_acquire); r && !ring; r = r->next) {
+        bool expected = false;
+        if (r->owned.compare_exchange_strong(expected, true)) ring = r;
+    }
+    if (!ring) {
+        // Once per thread, may be its first log inside a no-alloc region
+        AllocAllowedScope allowAlloc;
+        ring = new Ring();
+        ring->owned = true;
+        ring->next = mRings.load(std::memory_order_relaxed);
+        while (!mRings.compare_exchange_weak(ring->next, ring)) {}
+    }
+
+    tRingOwner.ring = ring;
+    return ring;
+}
+
+void AsyncLog::start() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mThread) {
+        return;
+    }
+    mExit = false;
+    mThread = new std::thread(&AsyncLog::writerLoop, this);
+    mRunning = true;
+}
+
+void AsyncLog::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mThread) {
+        return;
+    }
+    mRunning = false;
+    mExit = true;
+    mThread->join();
+    delete mThread;
+    mThread = nullptr;
+}
+
+void AsyncLog::writerLoop() {
+    pthread_setname_np(pthread_self(), "cxr-log");
+
+    std::vector<Entry> entries;
+    while (true) {
+        bool exiting = mExit.load();
+        entries.clear();
+        bool more = drain(entries);
+
+        // Rings are drained one after the other, restore the order across threads
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.timeNs < b.timeNs;
+        });
+        for (const Entry& entry : entries) {
+            emit(entry);
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        int64_t nowNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        flushSites(nowNs, exiting && !more);
+
+        if (mDropped && (nowNs - mDroppedReportNs >= LOG_WINDOW_NS || (exiting && !more))) {
+            __android_log_print(ANDROID_LOG_WARN, ASYNC_LOG_TAG, "[Log] %u messages dropped, log ring full", mDropped);
+            mDropped = 0;
+            mDroppedReportNs = nowNs;
+        }
+
+        if (exiting && !more) {
+            break;
+        }
+        if (!more) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITER_PERIOD_MS));
+        }
+    }
+}
+
+// Returns true if a ring still had records after the pass
+bool AsyncLog::drain(std::vector<Entry>& out) {
+    bool more = false;
+    for (Ring* ring = mRings.load(std::memory_order_acquire); ring; ring = ring->next) {
+        uint32_t h = ring->head.load(std::memory_order_relaxed);
+        uint32_t t = ring->tail.load(std::memory_order_acquire);
+
+        // Bounded so one chatty thread can't starve the others
+        for (int n = 0; h != t && n < 256; n++) {
+            uint32_t index = h & (Ring::CAPACITY - 1);
+            RecordHeader header;
+            memcpy(&header.size, ring->buffer + index, sizeof(header.size));
+            if (header.size == RECORD_WRAP) {
+                h += Ring::CAPACITY - index;
+                continue;
+            }
+            memcpy(&header, ring->buffer + index, sizeof(header));
+
+            Entry entry;
+            entry.timeNs = header.timeNs;
+            entry.prio = header.prio;
+            entry.tag = header.tag;
+            entry.fmt = header.fmt;
+            entry.text = Format(header.fmt, header.argCount, ring->buffer + index + sizeof(header),
+                                ring->buffer + index + header.size);
+            out.push_back(std::move(entry));
+            h += header.size;
+        }
+        ring->head.store(h, std::memory_order_release);
+        more |= (h != t);
+
+        mDropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    return more;
+}
+
+// Messages differing only in numbers share a limiter slot, so a per frame
+// warning is throttled while distinct messages from one call site are not
+uint64_t AsyncLog::SiteKey(const Entry& entry) {
+    uint64_t hash = 1469598103934665603ULL ^ (uint64_t)(uintptr_t)entry.fmt;
+    bool inNumber = false;
+    for (char c : entry.text) {
+        bool digit = c >= '0' && c <= '9';
+        if (digit && inNumber) continue;
+        inNumber = digit;
+        hash = (hash ^ (uint8_t)(digit ? '#' : c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void AsyncLog::emit(const Entry& entry) {
+    Site& site = mSites[SiteKey(entry)];
+    if (site.windowBeginNs == 0) {
+        site.windowBeginNs = entry.timeNs;
+        site.prio = entry.prio;
+        site.tag = entry.tag;
+    }
+
+    // Same text again, or the slot is over its budget for this window
+    if (entry.text == site.lastText || site.printed >= LOG_LINES_PER_SITE) {
+        site.suppressed++;
+        site.lastText = entry.text;
+        return;
+    }
+
+    site.printed++;
+    site.lastText = entry.text;
+    __android_log_print(entry.prio, entry.tag, "%s", entry.text.c_str());
+}
+
+// Summarizes what each slot suppressed once its window is over
+void AsyncLog::flushSites(int64_t nowNs, bool all) {
+    for (auto it = mSites.begin(); it != mSites.end(); ) {
+        Site& site = it->second;
+        if (!all && nowNs - site.windowBeginNs < LOG_WINDOW_NS) {
+            ++it;
+            continue;
+        }
+        if (site.suppressed) {
+            __android_log_print(site.prio, site.tag, "%s [repeated, %u more in %.1f s]", site.lastText.c_str(),
+                                site.suppressed, (nowNs - site.windowBeginNs) / 1e9);
+        }
+        it = mSites.erase(it);
+    }
+}
+
+/*
+ * printf subset used by the client: flags, width, precision (also '*'),
+ * length modifiers and d i u o x X c s p f F e E g G a A %.
+ * Every conversion is formatted on its own with the captured value widened
+ * to long long or double, so the length modifier is rewritten accordingly.
+ * */
+std::string AsyncLog::Format(const char* fmt, uint32_t argCount, const uint8_t* args, const uint8_t* end) {
+    char line[1024];
+    size_t len = 0;
+
+    // Reads the next argument, returns false if the record has none left
+    auto next = [&](uint8_t& kind, uint8_t& size, int64_t& value, double& real, const char*& str, uint16_t& strLen) {
+        if (argCount == 0 || args >= end) return false;
+        argCount--;
+        uint8_t tagByte = *args++;
+        kind = tagByte & 0xf;
+        size = tagByte >> 4;
+        if (kind == Arg_String) {
+            memcpy(&strLen, args, 2);
+            str = (const char*)args + 2;
+            args += 2 + strLen;
+        } else if (kind == Arg_Double) {
+            memcpy(&real, args, 8);
+            args += 8;
+        } else {
+            memcpy(&value, args, 8);
+            args += 8;
+        }
+        return true;
+    };
+
+    auto append = [&](int n) {
+        if (n > 0) len = std::min(len + (size_t)n, sizeof(line) - 1);
+    };
+
+    for (const char* p = fmt; *p && len < sizeof(line) - 1; ) {
+        if (*p != '%') {
+            line[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        char spec[32];
+        size_t specLen = 0;
+        spec[specLen++] = *p++;
+
+        uint8_t kind = 0, size = 0;
+        int64_t value = 0;
+        double real = 0.0;
+        const char* str = nullptr;
+        uint16_t strLen = 0;
+
+        // flags, width and precision, '*' takes an int argument
+        while (*p && strchr("-+ #0123456789.*", *p) && specLen < sizeof(spec) - 8) {
+            if (*p == '*') {
+                if (next(kind, size, value, real, str, strLen)) {
+                    specLen += snprintf(spec + specLen, sizeof(spec) - specLen, "%d", (int)value);
+                }
+                p++;
+            } else {
+                spec[specLen++] = *p++;
+            }
+        }
+        while (*p && strchr("hlLqjzt", *p)) p++;
+
+        char conv = *p;
+        if (!conv) break;
+        p++;
+
+        if (!next(kind, size, value, real, str, strLen)) {
+            append(snprintf(line + len, sizeof(line) - len, "<?>"));
+            continue;
+        }
+
+        switch (conv) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': {
+                spec[specLen++] = 'l';
+                spec[specLen++] = 'l';
+                spec[specLen++] = conv;
+                spec[specLen] = 0;
+                if (kind == Arg_Double) value = (int64_t)real;
+                // %u / %x of a negative int prints its own width, not 64 bits
+                if (conv != 'd' && conv != 'i' && size > 0 && size < 8) value &= (1LL << (size * 8)) - 1;
+                append(snprintf(line + len, sizeof(line) - len, spec, (long long)value));
+                break;
+            }
+            case 'c':
+                spec[specLen++] = 'c';
+                spec[specLen] = 0;
+                append(snprintf(line + len, sizeof(line) - len, spec, (int)value));
+                break;
+            case 's':
+                if (kind == Arg_String) {
+                    // Strings are not terminated in the ring
+                    char text[kMaxString + 1];
+                    memcpy(text, str, strLen);
+                    text[strLen] = 0;
+                    spec[specLen++] = 's';
+                    spec[specLen] = 0;
+                    append(snprintf(line + len, sizeof(line) - len, spec, text));
+                } else {
+                    append(snprintf(line + len, sizeof(line) - len, "%p", (void*)(uintptr_t)value));
+                }
+                break;
+            case 'p':
+                append(snprintf(line + len, sizeof(line) - len, "%p", (void*)(uintptr_t)value));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[specLen++] = conv;
+                spec[specLen] = 0;
+                if (kind != Arg_Double) real = (double)value;
+                append(snprintf(line + len, sizeof(line) - len, spec, real));
+                break;
+            default:
+                append(snprintf(line + len, sizeof(line) - len, "<?>"));
+                break;
+        }
+    }
+
+    line[len] = 0;
+    return std::string(line, len);
+}
@@ -0,0 +1,208 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <android/log.h>
+
+/*
+ * Deferred logging. The LOGx macros copy the format arguments into a ring
+ * owned by the calling thread, a background thread formats them, merges the
+ * rings in time order, rate limits each call site and writes to logcat.
+ * Format strings must be literals, string arguments are copied.
+ * Until start() and after stop() messages are written synchronously.
+ * */
+namespace AsyncLogDetail
+{
+    enum ArgKind
+    {
+        Arg_Signed = 0,
+        Arg_Unsigned,
+        Arg_Double,
+        Arg_String,
+        Arg_Pointer,
+    };
+
+    static const uint32_t kMaxString = 1024;
+
+    // Encoded size of an argument, tag byte included
+    template<typename T>
+    inline typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, uint32_t>::type
+    ArgSize(T) { return 1 + 8; }
+    template<typename T>
+    inline uint32_t ArgSize(const T*) { return 1 + 8; }
+    inline uint32_t ArgSize(const char* s) { return 1 + 2 + (s ? (uint32_t)strnlen(s, kMaxString) : 0); }
+
+    inline uint32_t ArgsSize() { return 0; }
+    template<typename T, typename... Rest>
+    inline uint32_t ArgsSize(T first, Rest... rest) { return ArgSize(first) + ArgsSize(rest...); }
+
+    // Tag byte: kind in the low nibble, size of the original type in the high one
+    template<typename T>
+    inline typename std::enable_if<std::is_floating_point<T>::value>::type
+    Put(uint8_t*& p, T v) {
+        double d = v;
+        *p++ = Arg_Double | (sizeof(d) << 4);
+        memcpy(p, &d, 8);
+        p += 8;
+    }
+    template<typename T>
+    inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    Put(uint8_t*& p, T v) {
+        bool isSigned = std::is_signed<T>::value || std::is_enum<T>::value;
+        int64_t i = isSigned ? (int64_t)v : (int64_t)(uint64_t)v;
+        *p++ = (isSigned ? Arg_Signed : Arg_Unsigned) | (sizeof(T) << 4);
+        memcpy(p, &i, 8);
+        p += 8;
+    }
+    template<typename T>
+    inline void Put(uint8_t*& p, const T* v) {
+        uint64_t u = (uint64_t)(uintptr_t)v;
+        *p++ = Arg_Pointer | (8 << 4);
+        memcpy(p, &u, 8);
+        p += 8;
+    }
+    inline void Put(uint8_t*& p, const char* s) {
+        uint16_t len = s ? (uint16_t)strnlen(s, kMaxString) : 0;
+        *p++ = Arg_String;
+        memcpy(p, &len, 2);
+        memcpy(p + 2, s, len);
+        p += 2 + len;
+    }
+
+    inline void PutArgs(uint8_t*&) {}
+    template<typename T, typename... Rest>
+    inline void PutArgs(uint8_t*& p, T first, Rest... rest) {
+        Put(p, first);
+        PutArgs(p, rest...);
+    }
+
+    struct RecordHeader
+    {
+        uint32_t size;          // whole record, 8 byte aligned. RECORD_WRAP = continue at 0
+        uint8_t prio;
+        uint8_t argCount;
+        uint16_t reserved;
+        int64_t timeNs;
+        const char* tag;
+        const char* fmt;
+    };
+    static const uint32_t RECORD_WRAP = 0xffffffff;
+
+    /*
+     * Single producer (the owning thread), single consumer (the writer) byte ring.
+     * Positions only grow, index = position & (CAPACITY - 1).
+     * */
+    struct Ring
+    {
+        static const uint32_t CAPACITY = 32 * 1024;
+
+        uint8_t buffer[CAPACITY];
+        std::atomic<uint32_t> head{0};     // consumer
+        std::atomic<uint32_t> tail{0};     // producer
+        std::atomic<uint32_t> dropped{0};
+        std::atomic<bool> owned{false};
+        Ring* next = nullptr;
+
+        // Producer side, returns nullptr when full
+        uint8_t* reserve(uint32_t size, uint32_t& newTail);
+        void commit(uint32_t newTail) { tail.store(newTail, std::memory_order_release); }
+    };
+}
+
+class AsyncLog
+{
+public:
+    static AsyncLog& Instance();
+
+    void start();
+    void stop();    // flushes everything pending
+    bool running() const { return mRunning.load(std::memory_order_relaxed); }
+
+    template<typename... Args>
+    static void Write(int prio, const char* tag, const char* fmt, Args... args) {
+        AsyncLog& log = Instance();
+        if (!log.running() || prio >= ANDROID_LOG_FATAL) {
+            WriteSync(prio, tag, fmt, args...);
+            return;
+        }
+
+        using namespace AsyncLogDetail;
+        uint32_t size = (sizeof(RecordHeader) + ArgsSize(args...) + 7) & ~7u;
+        if (size > Ring::CAPACITY / 4) {
+            WriteSync(prio, tag, fmt, args...);
+            return;
+        }
+
+        Ring* ring = log.threadRing();
+        uint32_t newTail = 0;
+        uint8_t* p = ring->reserve(size, newTail);
+        if (!p) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        RecordHeader header;
+        header.size = size;
+        header.prio = (uint8_t)prio;
+        header.argCount = (uint8_t)sizeof...(args);
+        header.reserved = 0;
+        header.timeNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        header.tag = tag;
+        header.fmt = fmt;
+        memcpy(p, &header, sizeof(header));
+        p += sizeof(header);
+        PutArgs(p, args...);
+        ring->commit(newTail);
+    }
+
+private:
+    static void WriteSync(int prio, const char* tag, const char* fmt, ...);
+
+    struct Entry {
+        int64_t timeNs;
+        int prio;
+        const char* tag;
+        const char* fmt;
+        std::string text;
+    };
+
+    // Rate limiter state per call site and message shape, see SiteKey()
+    struct Site {
+        int64_t windowBeginNs = 0;
+        uint32_t printed = 0;
+        uint32_t suppressed = 0;
+        int prio = 0;
+        const char* tag = nullptr;
+        std::string lastText;
+    };
+
+    AsyncLog() = default;
+    AsyncLogDetail::Ring* threadRing();
+    void writerLoop();
+    bool drain(std::vector<Entry>& out);
+    static uint64_t SiteKey(const Entry& entry);
+    void emit(const Entry& entry);
+    void flushSites(int64_t nowNs, bool all);
+    static std::string Format(const char* fmt, uint32_t argCount, const uint8_t* args, const uint8_t* end);
+
+    std::atomic<AsyncLogDetail::Ring*> mRings{nullptr};
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mExit{false};
+    std::mutex mMutex;
+    std::thread* mThread = nullptr;
+    std::unordered_map<uint64_t, Site> mSites;
+    uint32_t mDropped = 0;          // writer thread only
+    int64_t mDroppedReportNs = 0;
+};
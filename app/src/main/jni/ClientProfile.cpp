@@ -0,0 +1,173 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ClientProfile.h"
+
+struct ProfileKey {
+    const char* name;
+    uint32_t ClientProfile::* field;    // one of field and floatField
+    float ClientProfile::* floatField;
+    float min;
+    float max;
+};
+
+static const ProfileKey kProfileKeys[] = {
+        { "latchTimeoutMs",    &ClientProfile::latchTimeoutMs,    nullptr, 1,    1000 },
+        { "posePollHz",        &ClientProfile::posePollHz,        nullptr, 30,   1000 },
+        { "audioBufferBursts", &ClientProfile::audioBufferBursts, nullptr, 1,    16 },
+        { "predOffsetMs",      &ClientProfile::predOffsetMs,      nullptr, 0,    100 },
+        { "autoPredOffset",    &ClientProfile::autoPredOffset,    nullptr, 0,    1 },
+        { "foveation",         &ClientProfile::foveation,         nullptr, 0,    99 },
+        { "maxResFactor",      nullptr, &ClientProfile::maxResFactor,      0.5f, 2.0f },
+        { "eyeBufferMB",       &ClientProfile::eyeBufferMB,       nullptr, 32,   1024 },
+};
+static const size_t kProfileKeyCount = sizeof(kProfileKeys) / sizeof(*kProfileKeys);
+
+struct ProfilePreset {
+    const char* name;
+    const char* values;     // space separated key=value, parsed like the overrides
+};
+
+static const ProfilePreset kPresets[] = {
+        { "default",       "latchTimeoutMs=100 posePollHz=250 audioBufferBursts=2 predOffsetMs=10 eyeBufferMB=192" },
+        // Shortest queues everywhere, foveation to cut encode and decode time
+        { "low-latency",   "latchTimeoutMs=20 posePollHz=500 audioBufferBursts=1 predOffsetMs=8 "
+                           "foveation=50 maxResFactor=1.0 eyeBufferMB=192" },
+        // Wait for every frame, full resolution, no foveation
+        { "quality",       "latchTimeoutMs=100 posePollHz=250 audioBufferBursts=3 predOffsetMs=10 "
+                           "foveation=0 maxResFactor=1.2 eyeBufferMB=256" },
+        // Less sampling and decoding, deeper audio buffer for fewer wakeups
+        { "battery-saver", "latchTimeoutMs=100 posePollHz=120 audioBufferBursts=4 predOffsetMs=12 "
+                           "foveation=40 maxResFactor=0.8 eyeBufferMB=96" },
+};
+static const size_t kPresetCount = sizeof(kPresets) / sizeof(*kPresets);
+
+static void SplitWords(const std::string& text, std::vector<std::string>& out) {
+    size_t pos = 0;
+    while (true) {
+        size_t begin = text.find_first_not_of(" \t\r\n", pos);
+        if (begin == std::string::npos) break;
+        size_t end = text.find_first_of(" \t\r\n", begin);
+        out.push_back(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (end == std::string::npos) break;
+        pos = end;
+    }
+}
+
+bool ClientProfile::ReadLaunchOptions(const char* path, std::string& cloudXRArgs, std::vector<std::string>& clientArgs) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string text;
+    char buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, n);
+    }
+    fclose(file);
+
+    std::vector<std::string> words;
+    SplitWords(text, words);
+    cloudXRArgs.clear();
+    clientArgs.clear();
+    for (size_t i = 0; i < words.size(); i++) {
+        if (words[i] == "--client-profile" || words[i] == "--client") {
+            // A missing value is reported by apply()
+            clientArgs.push_back(words[i]);
+            if (i + 1 < words.size()) clientArgs.push_back(words[++i]);
+            continue;
+        }
+        if (!cloudXRArgs.empty()) cloudXRArgs += ' ';
+        cloudXRArgs += words[i];
+    }
+    return true;
+}
+
+bool ClientProfile::set(const char* key, const char* value) {
+    const ProfileKey* match = nullptr;
+    for (size_t i = 0; i < kProfileKeyCount; i++) {
+        if (strcmp(kProfileKeys[i].name, key) == 0) {
+            match = &kProfileKeys[i];
+            break;
+        }
+    }
+    if (match == nullptr) {
+        LOGE("[Profile] Unknown key %s", key);
+        return false;
+    }
+
+    char* end = nullptr;
+    float v = strtof(value, &end);
+    if (end == value || *end != 0 || v < match->min || v > match->max ||
+        (match->field && v != (float)(uint32_t)v)) {
+        LOGE("[Profile] Invalid %s=%s, expected %s %g..%g", key, value,
+             match->field ? "an integer in" : "a value in", match->min, match->max);
+        return false;
+    }
+    if (match->field) this->*(match->field) = (uint32_t)v;
+    else this->*(match->floatField) = v;
+    return true;
+}
+
+bool ClientProfile::apply(const std::vector<std::string>& clientArgs) {
+    // The preset goes first wherever it is on the line
+    std::vector<std::string> assignments;
+    const ProfilePreset* preset = &kPresets[0];
+    for (size_t i = 0; i < clientArgs.size(); i += 2) {
+        if (i + 1 >= clientArgs.size()) {
+            LOGE("[Profile] %s needs a value", clientArgs[i].c_str());
+            return false;
+        }
+        const std::string& value = clientArgs[i + 1];
+        if (clientArgs[i] == "--client") {
+            assignments.push_back(value);
+            continue;
+        }
+        preset = nullptr;
+        for (size_t p = 0; p < kPresetCount; p++) {
+            if (value == kPresets[p].name) preset = &kPresets[p];
+        }
+        if (preset == nullptr) {
+            LOGE("[Profile] Unknown preset %s, expected default, low-latency, quality or battery-saver", value.c_str());
+            return false;
+        }
+    }
+
+    std::vector<std::string> presetValues;
+    SplitWords(preset->values, presetValues);
+    presetValues.insert(presetValues.end(), assignments.begin(), assignments.end());
+
+    this->preset = preset->name;
+    overrides.clear();
+    for (size_t i = 0; i < presetValues.size(); i++) {
+        const std::string& assignment = presetValues[i];
+        size_t sep = assignment.find('=');
+        if (sep == std::string::npos) {
+            LOGE("[Profile] Expected key=value, got %s", assignment.c_str());
+            return false;
+        }
+        std::string key = assignment.substr(0, sep);
+        if (!set(key.c_str(), assignment.c_str() + sep + 1)) {
+            return false;
+        }
+        if (i + assignments.size() >= presetValues.size()) {
+            if (!overrides.empty()) overrides += ", ";
+            overrides += key;
+        }
+    }
+    return true;
+}
+
+void ClientProfile::log() const {
+    LOGI("[Profile] %s%s%s", preset.c_str(), overrides.empty() ? "" : " with overrides of ", overrides.c_str());
+    for (size_t i = 0; i < kProfileKeyCount; i++) {
+        const ProfileKey& key = kProfileKeys[i];
+        if (key.field) LOGI("[Profile]   %s=%u", key.name, this->*(key.field));
+        else LOGI("[Profile]   %s=%.2f", key.name, this->*(key.floatField));
+    }
+}
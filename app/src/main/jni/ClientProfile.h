@@ -0,0 +1,46 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define LAUNCH_OPTIONS_PATH "/sdcard/CloudXRLaunchOptions.txt"
+
+/*
+ * Client behaviour fixed for a connection, picked in CloudXRLaunchOptions.txt
+ * next to the CloudXR flags, which never see these:
+ *   -s 192.168.1.1 --client-profile low-latency --client predOffsetMs=6
+ * A preset (default, low-latency, quality, battery-saver) sets every key, each
+ * --client key=value then overrides one. The default preset keeps foveation and
+ * maxResFactor from the CloudXR flags, the other presets replace them.
+ * latchTimeoutMs, posePollHz and audioBufferBursts become the TuningParams
+ * defaults, CloudXRClientTuning.txt can still change them while streaming.
+ * */
+struct ClientProfile
+{
+    std::string preset = "default";
+    uint32_t latchTimeoutMs = 100;      // cxrLatchFrame timeout
+    uint32_t posePollHz = 250;          // updatePose sampling rate
+    uint32_t audioBufferBursts = 2;     // playback buffer size in bursts
+    uint32_t predOffsetMs = 10;         // cxrDeviceDesc::predOffset, for servers without history
+    uint32_t autoPredOffset = 1;        // 1 = learn predOffset per server, see PredictionTuner
+    uint32_t foveation = 0;             // cxrDeviceDesc::foveatedScaleFactor, 0 = off
+    float maxResFactor = 1.0f;          // cxrDeviceDesc::maxResFactor
+    uint32_t eyeBufferMB = 192;         // eye texture queues of both eyes, see SwapchainPlanner
+    std::string overrides;              // keys set by --client, for the log
+
+    // Reads the launch options file, the client options go to clientArgs and the
+    // rest to cloudXRArgs for CloudXR::ClientOptions::ParseString
+    static bool ReadLaunchOptions(const char* path, std::string& cloudXRArgs, std::vector<std::string>& clientArgs);
+
+    // Applies the preset then the overrides of clientArgs on top of the current values.
+    // False with the reason logged for an unknown preset or key, or a value out of range
+    bool apply(const std::vector<std::string>& clientArgs);
+
+    // One line per key, the effective profile
+    void log() const;
+
+private:
+    bool set(const char* key, const char* value);
+};
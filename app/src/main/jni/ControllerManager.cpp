@@ -0,0 +1,156 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <wvr/wvr_device.h>
+
+#include "ControllerManager.h"
+
+static const char* kRoles[ControllerManager::HAND_COUNT] = {
+        "cxr://input/hand/left",
+        "cxr://input/hand/right",
+};
+
+ControllerManager::ControllerManager() {
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        mConnected[hand].store(false);
+        mAnalogCount[hand].store(0);
+        mHandTracked[hand].store(false);
+    }
+}
+
+int ControllerManager::HandOf(WVR_DeviceType device) {
+    if (device == WVR_DeviceType_Controller_Left) return 0;
+    if (device == WVR_DeviceType_Controller_Right) return 1;
+    return -1;
+}
+
+WVR_DeviceType ControllerManager::DeviceOf(int hand) {
+    return hand == 0 ? WVR_DeviceType_Controller_Left : WVR_DeviceType_Controller_Right;
+}
+
+void ControllerManager::init(const cxrControllerDesc& base) {
+    mBase = base;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        refresh(hand);
+    }
+    LOGI("[Controllers] Left %s, right %s",
+         connected(0) ? "connected" : "disconnected", connected(1) ? "connected" : "disconnected");
+}
+
+void ControllerManager::refresh(int hand) {
+    WVR_DeviceType device = DeviceOf(hand);
+    bool isConnected = WVR_IsDeviceConnected(device);
+    int32_t analogs = isConnected ? WVR_GetInputTypeCount(device, WVR_InputType_Analog) : 0;
+    mAnalogCount[hand].store(analogs > 0 ? (uint32_t)analogs : 0, std::memory_order_relaxed);
+    mConnected[hand].store(isConnected, std::memory_order_relaxed);
+}
+
+bool ControllerManager::onEvent(const WVR_Event_t& event) {
+    switch (event.common.type) {
+    case WVR_EventType_DeviceConnected:
+    case WVR_EventType_DeviceDisconnected:
+        {
+            int hand = HandOf(event.device.deviceType);
+            if (hand < 0) {
+                return false;
+            }
+            refresh(hand);
+            LOGI("[Controllers] %s %s", hand == 0 ? "Left" : "Right",
+                 connected(hand) ? "connected" : "disconnected");
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (present(hand)) {
+                add(hand);
+            } else {
+                remove(hand);
+            }
+            return true;
+        }
+
+    // Left and right may have swapped devices, start over for both
+    case WVR_EventType_DeviceRoleChanged:
+        {
+            LOGI("[Controllers] Role changed");
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (int hand = 0; hand < HAND_COUNT; hand++) {
+                refresh(hand);
+                remove(hand);
+                if (present(hand)) {
+                    add(hand);
+                }
+            }
+            return true;
+        }
+
+    default:
+        return false;
+    }
+}
+
+void ControllerManager::attach(cxrReceiverHandle receiver) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mReceiver == receiver) {
+        return;
+    }
+    mReceiver = receiver;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        if (present(hand)) {
+            add(hand);
+        }
+    }
+}
+
+void ControllerManager::setHandTracked(int hand, bool tracked) {
+    if (mHandTracked[hand].load(std::memory_order_relaxed) == tracked) {
+        return;
+    }
+    mHandTracked[hand].store(tracked, std::memory_order_relaxed);
+    LOGI("[Controllers] %s hand %s", hand == 0 ? "Left" : "Right", tracked ? "tracked" : "lost");
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (present(hand)) {
+        add(hand);
+    } else {
+        remove(hand);
+    }
+}
+
+void ControllerManager::detach() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        remove(hand);
+    }
+    mReceiver = nullptr;
+}
+
+void ControllerManager::add(int hand) {
+    if (mReceiver == nullptr || mHandles[hand] != nullptr) {
+        return;
+    }
+
+    cxrControllerDesc desc = mBase;
+    desc.id = DeviceOf(hand);
+    desc.role = kRoles[hand];
+    cxrError err = cxrAddController(mReceiver, &desc, &mHandles[hand]);
+    if (err != cxrError_Success) {
+        LOGE("[Controllers] Error adding controller %s: %s", desc.role, cxrErrorString(err));
+        mHandles[hand] = nullptr;
+        return;
+    }
+    LOGI("[Controllers] Added controller %s, %s", desc.controllerName, desc.role);
+}
+
+void ControllerManager::remove(int hand) {
+    if (mHandles[hand] == nullptr) {
+        return;
+    }
+
+    // Fails once the server is gone, the handle is dropped either way
+    cxrError err = cxrRemoveController(mReceiver, mHandles[hand]);
+    if (err != cxrError_Success) {
+        LOGW("[Controllers] Removing controller %s: %s", kRoles[hand], cxrErrorString(err));
+    } else {
+        LOGI("[Controllers] Removed controller %s", kRoles[hand]);
+    }
+    mHandles[hand] = nullptr;
+}
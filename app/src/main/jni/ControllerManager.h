@@ -0,0 +1,65 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <wvr/wvr_types.h>
+#include <wvr/wvr_events.h>
+#include <CloudXRClient.h>
+
+/*
+ * Controller connection state and CloudXR controller handles.
+ * A hand is registered while its controller is connected or the hand itself is tracked.
+ * Connection state is cached from WVR device events, so the pose and input paths
+ * read a flag instead of asking WVR every sample. Handles are registered as soon
+ * as a stream is attached and follow hot-plug from then on, the first button press
+ * never waits for cxrAddController.
+ * */
+class ControllerManager
+{
+public:
+    static const int HAND_COUNT = 2;    // index 0 left, 1 right
+
+    ControllerManager();
+
+    // 0 or 1 for a controller, -1 for anything else
+    static int HandOf(WVR_DeviceType device);
+
+    // Input layout shared by both hands, id and role are filled in per hand
+    void init(const cxrControllerDesc& base);
+
+    // WVR device events, true if the event was about a controller
+    bool onEvent(const WVR_Event_t& event);
+
+    // Registers every connected controller with the receiver, detach() removes them
+    void attach(cxrReceiverHandle receiver);
+    void detach();
+    bool attached() const { return mReceiver != nullptr; }
+
+    // Safe from any thread
+    bool connected(int hand) const { return mConnected[hand].load(std::memory_order_relaxed); }
+    bool present(int hand) const { return connected(hand) || mHandTracked[hand].load(std::memory_order_relaxed); }
+    uint32_t analogCount(int hand) const { return mAnalogCount[hand].load(std::memory_order_relaxed); }
+
+    // nullptr while the controller is disconnected or nothing is attached
+    cxrControllerHandle handle(int hand) const { return mHandles[hand]; }
+
+    // Hand tracking stands in for a missing controller, see HandTracker
+    void setHandTracked(int hand, bool tracked);
+
+private:
+    static WVR_DeviceType DeviceOf(int hand);
+    void refresh(int hand);
+    void add(int hand);
+    void remove(int hand);
+
+    cxrControllerDesc mBase = {};
+    std::atomic<bool> mConnected[HAND_COUNT];
+    std::atomic<uint32_t> mAnalogCount[HAND_COUNT];
+    std::atomic<bool> mHandTracked[HAND_COUNT];
+
+    std::mutex mMutex;      // handles and receiver, taken by the render thread and shutdown
+    cxrReceiverHandle mReceiver = nullptr;
+    cxrControllerHandle mHandles[HAND_COUNT] = {};
+};
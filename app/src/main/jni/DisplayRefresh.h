@@ -0,0 +1,22 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * Display modes of the activity's window, see MainActivity. The supported rates
+ * are handed over once from onCreate, requests go back through
+ * MainActivity.requestRefreshRate and apply on the UI thread a few frames later.
+ * Implemented in jni.cpp.
+ * */
+class DisplayRefresh
+{
+public:
+    static const uint32_t MAX_RATES = 8;
+
+    // Copies up to capacity rates, returns how many. 0 until the activity reported them
+    static uint32_t SupportedRates(float* rates, uint32_t capacity);
+
+    // Any thread, attaches to the VM for the call if needed
+    static bool Request(float hz);
+};
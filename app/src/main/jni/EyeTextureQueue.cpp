@@ -0,0 +1,120 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+
+#include "EyeTextureQueue.h"
+
+std::atomic<int32_t> EyeTextureQueue::sLiveQueues(0);
+std::atomic<int32_t> EyeTextureQueue::sLiveFramebuffers(0);
+
+EyeTextureQueue::~EyeTextureQueue() {
+    // The GL context is usually gone by now, all we can do is report it
+    if (mQueue) {
+        LOGE("[Textures] %ux%u queue of generation %u was never released", mWidth, mHeight, mGeneration);
+    }
+}
+
+GLuint EyeTextureQueue::CreateFramebuffer(GLuint texId, uint32_t width, uint32_t height) {
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        LOGE("Incomplete frame buffer object (%d). Requested dimensions: %d x %d.", status, width, height);
+    }
+    sLiveFramebuffers++;
+    return fbo;
+}
+
+bool EyeTextureQueue::allocate(uint32_t width, uint32_t height) {
+    if (mQueue && mWidth == width && mHeight == height) {
+        return true;
+    }
+    release();
+
+    mQueue = WVR_ObtainTextureQueue(WVR_TextureTarget_2D, WVR_TextureFormat_RGBA, WVR_TextureType_UnsignedByte, width, height, 0);
+    if (mQueue == nullptr) {
+        LOGE("[Textures] Can't obtain a %ux%u texture queue", width, height);
+        return false;
+    }
+    sLiveQueues++;
+
+    mLength = WVR_GetTextureQueueLength(mQueue);
+    if (mLength > MAX_TEXTURES) {
+        LOGW("[Textures] Queue has %d textures, only %d are used", mLength, MAX_TEXTURES);
+        mLength = MAX_TEXTURES;
+    }
+
+    for (int32_t i = 0; i < mLength; i++) {
+        Slot& slot = mSlots[i];
+        slot.index = i;
+        slot.texture = WVR_GetTexture(mQueue, i);
+        slot.fbo = CreateFramebuffer(TextureId(slot.texture), width, height);
+        slot.tag = -1;
+
+        GLuint id = TextureId(slot.texture);
+        uint32_t h = id & (LOOKUP_SIZE - 1);
+        while (mLookupSlot[h] != 0) h = (h + 1) & (LOOKUP_SIZE - 1);
+        mLookupId[h] = id;
+        mLookupSlot[h] = (uint8_t)(i + 1);
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mGeneration++;
+    LOGI("[Textures] Allocated %ux%u x%d, generation %u", width, height, mLength, mGeneration);
+    return true;
+}
+
+void EyeTextureQueue::release() {
+    if (mQueue == nullptr) {
+        return;
+    }
+
+    for (int32_t i = 0; i < mLength; i++) {
+        glDeleteFramebuffers(1, &mSlots[i].fbo);
+        mSlots[i] = Slot();
+        sLiveFramebuffers--;
+    }
+    for (uint32_t h = 0; h < LOOKUP_SIZE; h++) {
+        mLookupId[h] = 0;
+        mLookupSlot[h] = 0;
+    }
+
+    WVR_ReleaseTextureQueue(mQueue);
+    sLiveQueues--;
+    mQueue = nullptr;
+    mLength = 0;
+    mWidth = 0;
+    mHeight = 0;
+}
+
+EyeTextureQueue::Slot* EyeTextureQueue::acquire() {
+    if (mQueue == nullptr) {
+        return nullptr;
+    }
+    int32_t index = WVR_GetAvailableTextureIndex(mQueue);
+    if (index < 0 || index >= mLength) {
+        LOGE("[Textures] Invalid texture index %d", index);
+        return nullptr;
+    }
+    return &mSlots[index];
+}
+
+GLuint EyeTextureQueue::framebufferFor(GLuint textureId) const {
+    uint32_t h = textureId & (LOOKUP_SIZE - 1);
+    for (uint32_t probe = 0; probe < LOOKUP_SIZE && mLookupSlot[h] != 0; probe++) {
+        if (mLookupId[h] == textureId) {
+            return mSlots[mLookupSlot[h] - 1].fbo;
+        }
+        h = (h + 1) & (LOOKUP_SIZE - 1);
+    }
+    return 0;
+}
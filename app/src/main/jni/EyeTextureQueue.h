@@ -0,0 +1,70 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <GLES3/gl31.h>
+#include <wvr/wvr_render.h>
+
+/*
+ * A WVR texture queue and one FBO per texture, allocated and released together.
+ * The generation changes on every allocation so anything cached per texture
+ * (contents, FBO names) can tell it is stale.
+ * */
+class EyeTextureQueue
+{
+public:
+    static const int32_t MAX_TEXTURES = 8;
+
+    struct Slot
+    {
+        int32_t index = -1;
+        WVR_TextureParams_t texture = {};
+        GLuint fbo = 0;
+        int32_t tag = -1;   // free for the owner, reset to -1 on allocation
+    };
+
+    ~EyeTextureQueue();
+
+    // Releases the current queue first, a no-op if the size is unchanged
+    bool allocate(uint32_t width, uint32_t height);
+    void release();
+
+    bool valid() const { return mQueue != nullptr; }
+    void* queue() const { return mQueue; }
+    uint32_t generation() const { return mGeneration; }
+    uint32_t width() const { return mWidth; }
+    uint32_t height() const { return mHeight; }
+    int32_t length() const { return mLength; }
+
+    // Next texture for rendering. No allocation, nullptr if the queue is not valid
+    Slot* acquire();
+
+    // FBO attached to a texture of this queue, 0 if unknown
+    GLuint framebufferFor(GLuint textureId) const;
+
+    // Queues and FBOs alive across all instances, both 0 after shutdown
+    static int32_t LiveQueues() { return sLiveQueues; }
+    static int32_t LiveFramebuffers() { return sLiveFramebuffers; }
+
+private:
+    static const uint32_t LOOKUP_SIZE = 16;     // power of two, > MAX_TEXTURES
+
+    static GLuint CreateFramebuffer(GLuint texId, uint32_t width, uint32_t height);
+    static GLuint TextureId(const WVR_TextureParams_t& texture) { return (GLuint)(size_t)texture.id; }
+
+    void* mQueue = nullptr;
+    uint32_t mGeneration = 0;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    int32_t mLength = 0;
+    Slot mSlots[MAX_TEXTURES];
+
+    // Open addressing, texture id -> slot index + 1
+    GLuint mLookupId[LOOKUP_SIZE] = {};
+    uint8_t mLookupSlot[LOOKUP_SIZE] = {};
+
+    static std::atomic<int32_t> sLiveQueues;
+    static std::atomic<int32_t> sLiveFramebuffers;
+};
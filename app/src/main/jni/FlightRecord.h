@@ -0,0 +1,98 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+
+// File format of FlightRecorder, shared with tools/FlightDecode.cpp so no SDK types here
+
+#define FLIGHT_RECORDER_PATH "/sdcard/CloudXRFlightRecorder.bin"
+#define FLIGHT_FILE_MAGIC 0x52465843  // "CXFR"
+#define FLIGHT_FILE_VERSION 1
+
+/*
+ * File layout: FlightFileHeader, then recordCount FlightRecord slots used as a ring.
+ * Record n (1-based sequence) lives in slot (n - 1) % recordCount. A slot's sequence
+ * is cleared while it is rewritten, so a record torn by a crash reads as empty.
+ * Little endian, all times CLOCK_MONOTONIC.
+ * */
+enum FlightRecordKind
+{
+    FlightRecord_Frame = 1,
+    FlightRecord_Stats,
+    FlightRecord_Lifecycle,
+    FlightRecord_Tuning,
+};
+
+enum FlightFrameFlags
+{
+    FlightFrame_Valid = 1 << 0,         // latched this frame
+    FlightFrame_Concealed = 1 << 1,     // missed, last frame shown again
+};
+
+enum FlightTuningFlags
+{
+    FlightTuning_Text = 1 << 0,         // thread placement key, the values aren't recorded
+};
+
+struct FlightFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;        // sizeof(FlightRecord)
+    uint32_t recordCount;
+    int64_t startMonotonicNs;   // when the file was created
+    int64_t startRealtimeUs;    // wall clock at the same moment
+    uint8_t reserved[32];
+};
+
+struct FlightFrame
+{
+    uint32_t intervalUs;        // since the previous frame record
+    uint32_t latchUs;           // spent in cxrLatchFrame, 0 = not called
+    uint32_t poseAgeUs;         // age of the frame's pose when latched, 0 = unknown
+    int16_t latchResult;        // cxrError
+    uint16_t misses;            // consecutive latch misses
+};
+
+struct FlightStats
+{
+    float fps;
+    uint32_t bitrateKbps;
+    uint32_t jitterUs;
+    uint16_t roundTripMs;
+    uint8_t quality;            // cxrConnectionQuality
+    uint8_t qualityReasons;     // cxrConnectionQualityReason bits
+};
+
+struct FlightLifecycle
+{
+    int32_t from;               // cxrClientState
+    int32_t to;
+    int32_t error;              // cxrError
+    uint32_t actedAfterUs;      // callback to main loop
+};
+
+struct FlightTuning
+{
+    uint32_t from;
+    uint32_t to;
+};
+
+struct FlightRecord
+{
+    uint32_t sequence;          // 0 = empty or torn
+    uint8_t kind;               // FlightRecordKind
+    uint8_t flags;              // FlightFrameFlags of a frame, FlightTuningFlags of a tuning change
+    uint16_t aux;               // stats: packets lost since the previous stats record, tuning: key id
+    int64_t timeNs;
+    union {
+        FlightFrame frame;
+        FlightStats stats;
+        FlightLifecycle lifecycle;
+        FlightTuning tuning;
+        uint8_t payload[16];
+    };
+};
+
+static_assert(sizeof(FlightFileHeader) == 64, "FlightFileHeader layout");
+static_assert(sizeof(FlightRecord) == 32, "FlightRecord layout");
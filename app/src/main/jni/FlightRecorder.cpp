@@ -0,0 +1,165 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <string>
+
+#include "FlightRecorder.h"
+
+FlightRecorder::~FlightRecorder() {
+    stop();
+}
+
+int64_t FlightRecorder::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool FlightRecorder::start(const char* path, uint32_t recordCount) {
+    if (mBase) {
+        return true;
+    }
+
+    // The last session may be the one being investigated
+    std::string previous = std::string(path) + ".prev";
+    rename(path, previous.c_str());
+
+    uint64_t size = sizeof(FlightFileHeader) + (uint64_t)recordCount * sizeof(FlightRecord);
+    mFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0 || ftruncate(mFd, size) != 0) {
+        LOGE("[Flight] Can't create %s: %s", path, strerror(errno));
+        if (mFd >= 0) ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (base == MAP_FAILED) {
+        LOGE("[Flight] mmap %s failed: %s", path, strerror(errno));
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mBase = (uint8_t*)base;
+    mSize = size;
+    mRecords = (FlightRecord*)(mBase + sizeof(FlightFileHeader));
+    mRecordCount = recordCount;
+    mSequence = 0;
+    mLastFrameNs = 0;
+    mLastPacketsLost = 0;
+
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    FlightFileHeader* header = (FlightFileHeader*)mBase;
+    header->magic = FLIGHT_FILE_MAGIC;
+    header->version = FLIGHT_FILE_VERSION;
+    header->recordSize = sizeof(FlightRecord);
+    header->recordCount = recordCount;
+    header->startMonotonicNs = NowNs();
+    header->startRealtimeUs = realtime.tv_sec * 1000000LL + realtime.tv_nsec / 1000;
+
+    LOGI("[Flight] Recording the last %u records to %s", recordCount, path);
+    return true;
+}
+
+void FlightRecorder::stop() {
+    if (!mBase) {
+        return;
+    }
+    munmap(mBase, mSize);
+    ::close(mFd);
+    LOGI("[Flight] Stopped after %u records", mSequence);
+
+    mBase = nullptr;
+    mRecords = nullptr;
+    mFd = -1;
+}
+
+FlightRecord* FlightRecorder::begin(FlightRecordKind kind, int64_t now) {
+    FlightRecord* record = &mRecords[mSequence % mRecordCount];
+    record->sequence = 0;
+    // Nothing is reordered past the clear, a torn record never carries a sequence
+    std::atomic_signal_fence(std::memory_order_release);
+    record->kind = (uint8_t)kind;
+    record->flags = 0;
+    record->aux = 0;
+    record->timeNs = now;
+    return record;
+}
+
+void FlightRecorder::commit(FlightRecord* record) {
+    std::atomic_signal_fence(std::memory_order_release);
+    record->sequence = ++mSequence;
+}
+
+void FlightRecorder::recordFrame(const FlightFrame& frame, uint8_t flags) {
+    if (!mBase) {
+        return;
+    }
+    int64_t now = NowNs();
+    FlightRecord* record = begin(FlightRecord_Frame, now);
+    record->flags = flags;
+    record->frame = frame;
+    record->frame.intervalUs = mLastFrameNs ? (uint32_t)((now - mLastFrameNs) / 1000) : 0;
+    mLastFrameNs = now;
+    commit(record);
+}
+
+void FlightRecorder::beginSession() {
+    mLastPacketsLost = 0;
+}
+
+void FlightRecorder::recordStats(const cxrConnectionStats& stats) {
+    if (!mBase) {
+        return;
+    }
+    FlightRecord* record = begin(FlightRecord_Stats, NowNs());
+    // A total going back is a receiver beginSession() wasn't told about, it counts from 0
+    if (stats.totalPacketsLost < mLastPacketsLost) {
+        mLastPacketsLost = 0;
+    }
+    uint32_t lost = stats.totalPacketsLost - mLastPacketsLost;
+    mLastPacketsLost = stats.totalPacketsLost;
+    record->aux = lost > 0xffff ? 0xffff : (uint16_t)lost;
+    record->stats.fps = stats.framesPerSecond;
+    record->stats.bitrateKbps = stats.bandwidthUtilizationKbps;
+    record->stats.jitterUs = stats.jitterUs;
+    record->stats.roundTripMs = (uint16_t)stats.roundTripDelayMs;
+    record->stats.quality = (uint8_t)stats.quality;
+    record->stats.qualityReasons = (uint8_t)stats.qualityReasons;
+    commit(record);
+}
+
+void FlightRecorder::recordLifecycle(cxrClientState from, cxrClientState to, cxrError error, int64_t eventNs) {
+    if (!mBase) {
+        return;
+    }
+    int64_t now = NowNs();
+    FlightRecord* record = begin(FlightRecord_Lifecycle, now);
+    record->lifecycle.from = (int32_t)from;
+    record->lifecycle.to = (int32_t)to;
+    record->lifecycle.error = (int32_t)error;
+    record->lifecycle.actedAfterUs = (uint32_t)((now - eventNs) / 1000);
+    commit(record);
+}
+
+void FlightRecorder::recordTuning(uint16_t keyId, uint32_t from, uint32_t to, bool text) {
+    if (!mBase) {
+        return;
+    }
+    FlightRecord* record = begin(FlightRecord_Tuning, NowNs());
+    record->flags = text ? FlightTuning_Text : 0;
+    record->aux = keyId;
+    record->tuning.from = from;
+    record->tuning.to = to;
+    commit(record);
+}
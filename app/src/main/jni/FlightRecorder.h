@@ -0,0 +1,50 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <CloudXRClient.h>
+
+#include "FlightRecord.h"
+
+/*
+ * Always-on telemetry ring in a memory-mapped file, see FlightRecord.h for the
+ * layout. Records are plain stores into the mapping, the kernel writes the pages
+ * back on its own, so the last minutes survive the process being killed. The
+ * previous session's file is kept next to it with a .prev suffix.
+ * Main loop only. Record calls do nothing until start() succeeds.
+ * */
+class FlightRecorder
+{
+public:
+    static const uint32_t DEFAULT_RECORDS = 32768;     // 1 MB, ~5 minutes at 90 fps
+
+    ~FlightRecorder();
+
+    bool start(const char* path, uint32_t recordCount = DEFAULT_RECORDS);
+    void stop();
+
+    // A new receiver, its stats counters start over
+    void beginSession();
+
+    // intervalUs is filled in here
+    void recordFrame(const FlightFrame& frame, uint8_t flags);
+    void recordStats(const cxrConnectionStats& stats);
+    void recordLifecycle(cxrClientState from, cxrClientState to, cxrError error, int64_t eventNs);
+    // keyId is TuningChange::id, text keys have no values recorded
+    void recordTuning(uint16_t keyId, uint32_t from, uint32_t to, bool text);
+
+    static int64_t NowNs();
+
+private:
+    FlightRecord* begin(FlightRecordKind kind, int64_t now);
+    void commit(FlightRecord* record);
+
+    int mFd = -1;
+    uint8_t* mBase = nullptr;
+    uint64_t mSize = 0;
+    FlightRecord* mRecords = nullptr;
+    uint32_t mRecordCount = 0;
+    uint32_t mSequence = 0;
+    int64_t mLastFrameNs = 0;
+    uint32_t mLastPacketsLost = 0;
+};
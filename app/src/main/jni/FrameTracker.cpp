@@ -0,0 +1,151 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "FrameTracker.h"
+
+int64_t FrameTracker::NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameTracker::reset(float fps) {
+    mTypicalIntervalMs = (fps > 0.0f) ? 1000.0f / fps : 11.1f;
+    mServerIntervalCount = 0;
+    mServerIntervalHead = 0;
+    mRecordCount = 0;
+    mHead = 0;
+    mHasLast = false;
+    mWindow = FrameCounters();
+    mIntervalSumMs = 0.0;
+    mWindowBeginUs = NowUs();
+}
+
+void FrameTracker::onLatched(const cxrFramesLatched& latched) {
+    FrameRecord record = {};
+    record.latchUs = NowUs();
+    record.serverTimeNs = latched.frames[0].timeStamp;
+    record.width = (uint16_t)latched.frames[0].widthFinal;
+    record.height = (uint16_t)latched.frames[0].heightFinal;
+
+    if (mHasLast) {
+        record.intervalMs = (record.latchUs - mLast.latchUs) / 1000.0f;
+        record.serverIntervalMs = (int64_t)(record.serverTimeNs - mLast.serverTimeNs) / 1000000.0f;
+
+        // Without server timestamps a repeat is the same render pose twice, drops can't be told
+        bool hasServerTime = record.serverTimeNs != 0 && mLast.serverTimeNs != 0;
+        bool repeat = hasServerTime ? record.serverTimeNs == mLast.serverTimeNs
+                                    : memcmp(&latched.poseMatrix, &mLastPose, sizeof(mLastPose)) == 0;
+
+        if (repeat) {
+            record.flags |= FrameFlag_Repeat;
+            mWindow.repeats++;
+        } else if (!hasServerTime) {
+            record.serverIntervalMs = 0.0f;
+        } else if (record.serverIntervalMs <= 0.0f) {
+            // Server clock went back (restarted stream), nothing to learn from, start over
+            record.serverIntervalMs = 0.0f;
+            mServerIntervalCount = 0;
+            mServerIntervalHead = 0;
+        } else {
+            addServerInterval(record.serverIntervalMs);
+            if (mServerIntervalCount < MIN_INTERVALS) {
+                // Too few to tell a drop from the rate the server settled on
+            } else if (record.serverIntervalMs > 1.5f * mTypicalIntervalMs) {
+                record.flags |= FrameFlag_Drop;
+                mWindow.drops += (uint32_t)lroundf(record.serverIntervalMs / mTypicalIntervalMs) - 1;
+            } else if (record.intervalMs > 1.5f * mTypicalIntervalMs) {
+                record.flags |= FrameFlag_Late;
+                mWindow.late++;
+            }
+        }
+
+        if (record.width != mLast.width || record.height != mLast.height) {
+            record.flags |= FrameFlag_ResolutionChange;
+            mWindow.resolutionChanges++;
+        }
+
+        mIntervalSumMs += record.intervalMs;
+        if (record.intervalMs > mWindow.maxIntervalMs) mWindow.maxIntervalMs = record.intervalMs;
+    }
+    mWindow.frames++;
+
+    mRecords[mHead] = record;
+    mHead = (mHead + 1) % TIMELINE_SIZE;
+    if (mRecordCount < TIMELINE_SIZE) mRecordCount++;
+
+    mLast = record;
+    mLastPose = latched.poseMatrix;
+    mHasLast = true;
+}
+
+// The typical interval is the lower quartile of the recent ones, whatever rate the
+// server streams at. A drop stretches an interval, so it holds while most are dropped
+void FrameTracker::addServerInterval(float ms) {
+    mServerIntervals[mServerIntervalHead] = ms;
+    mServerIntervalHead = (mServerIntervalHead + 1) % INTERVAL_HISTORY;
+    if (mServerIntervalCount < INTERVAL_HISTORY) mServerIntervalCount++;
+
+    float sorted[INTERVAL_HISTORY];
+    memcpy(sorted, mServerIntervals, mServerIntervalCount * sizeof(float));
+    float* quartile = sorted + mServerIntervalCount / 4;
+    std::nth_element(sorted, quartile, sorted + mServerIntervalCount);
+    mTypicalIntervalMs = *quartile;
+}
+
+void FrameTracker::onMiss() {
+    mWindow.misses++;
+}
+
+void FrameTracker::onConcealed() {
+    mWindow.concealed++;
+}
+
+bool FrameTracker::poll(FrameCounters& out) {
+    int64_t now = NowUs();
+    if (now - mWindowBeginUs < 1000000) {
+        return false;
+    }
+
+    out = mWindow;
+    out.avgIntervalMs = (mWindow.frames > 1) ? (float)(mIntervalSumMs / (mWindow.frames - 1)) : 0.0f;
+
+    mWindow = FrameCounters();
+    mIntervalSumMs = 0.0;
+    mWindowBeginUs = now;
+    return true;
+}
+
+uint32_t FrameTracker::timeline(FrameRecord* out, uint32_t count) const {
+    if (count > mRecordCount) count = mRecordCount;
+    uint32_t first = (mHead + TIMELINE_SIZE - count) % TIMELINE_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = mRecords[(first + i) % TIMELINE_SIZE];
+    }
+    return count;
+}
+
+// One line, "interval[flags]" per frame: D drop, R repeat, L late, S size change
+void FrameTracker::logTimeline(uint32_t count) const {
+    FrameRecord records[32];
+    if (count > 32) count = 32;
+    count = timeline(records, count);
+
+    char line[512];
+    int len = 0;
+    for (uint32_t i = 0; i < count && len < (int)sizeof(line) - 16; i++) {
+        const FrameRecord& r = records[i];
+        len += snprintf(line + len, sizeof(line) - len, " %.1f%s%s%s%s", r.intervalMs,
+                        (r.flags & FrameFlag_Drop) ? "D" : "",
+                        (r.flags & FrameFlag_Repeat) ? "R" : "",
+                        (r.flags & FrameFlag_Late) ? "L" : "",
+                        (r.flags & FrameFlag_ResolutionChange) ? "S" : "");
+    }
+    line[len] = 0;
+    LOGI("[Frames] Timeline (ms):%s", line);
+}
@@ -0,0 +1,84 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <CloudXRClient.h>
+
+enum FrameFlags
+{
+    FrameFlag_Drop = 1 << 0,             // server timestamps skipped one or more frames
+    FrameFlag_Repeat = 1 << 1,           // same frame as the previous latch
+    FrameFlag_Late = 1 << 2,             // arrived late although the server sent it on time
+    FrameFlag_ResolutionChange = 1 << 3,
+};
+
+struct FrameRecord
+{
+    int64_t latchUs;            // client time of the latch
+    uint64_t serverTimeNs;      // cxrVideoFrame::timeStamp
+    float intervalMs;           // since the previous latch
+    float serverIntervalMs;     // since the previous frame on the server clock
+    uint16_t width;
+    uint16_t height;
+    uint32_t flags;
+};
+
+struct FrameCounters
+{
+    uint32_t frames = 0;
+    uint32_t drops = 0;             // frames missing from the server sequence
+    uint32_t repeats = 0;
+    uint32_t late = 0;
+    uint32_t misses = 0;            // latch timeouts
+    uint32_t concealed = 0;         // misses hidden by re-showing the last frame
+    uint32_t resolutionChanges = 0;
+    float avgIntervalMs = 0.0f;
+    float maxIntervalMs = 0.0f;
+};
+
+/*
+ * Tracks continuity of latched video frames from their metadata:
+ * inter-arrival intervals, drops, repeats, late frames and resolution changes.
+ * Render thread only.
+ * */
+class FrameTracker
+{
+public:
+    static const uint32_t TIMELINE_SIZE = 256;
+    static const uint32_t INTERVAL_HISTORY = 32;    // server intervals the typical one is taken from
+    static const uint32_t MIN_INTERVALS = 8;        // before frames are judged against it
+
+    // Requested stream rate, replaced by what the server sends once MIN_INTERVALS are in
+    void reset(float fps);
+
+    void onLatched(const cxrFramesLatched& latched);
+    void onMiss();
+    void onConcealed();
+
+    // Returns true about once per second with the counters of that window
+    bool poll(FrameCounters& out);
+
+    // Most recent frames, oldest first
+    uint32_t timeline(FrameRecord* out, uint32_t count) const;
+    void logTimeline(uint32_t count) const;
+
+private:
+    static int64_t NowUs();
+    void addServerInterval(float ms);
+
+    FrameRecord mRecords[TIMELINE_SIZE] = {};
+    uint32_t mRecordCount = 0;
+    uint32_t mHead = 0;
+
+    float mTypicalIntervalMs = 11.1f;
+    float mServerIntervals[INTERVAL_HISTORY] = {};
+    uint32_t mServerIntervalCount = 0;
+    uint32_t mServerIntervalHead = 0;
+    FrameRecord mLast = {};
+    cxrMatrix34 mLastPose = {};
+    bool mHasLast = false;
+
+    FrameCounters mWindow;
+    double mIntervalSumMs = 0.0;
+    int64_t mWindowBeginUs = 0;
+};
@@ -0,0 +1,364 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "HandTracker.h"
+#include "AllocTracker.h"
+
+// WVR_HandJoint order
+static const uint32_t kJointPalm = 0;
+static const uint32_t kJointWrist = 1;
+static const uint32_t kGripTips[] = { 15, 20, 25 };    // middle, ring and pinky tips
+
+// Tip to palm distance of an open and a closed hand, meters
+static const float kGripOpen = 0.085f;
+static const float kGripClosed = 0.035f;
+
+static const int64_t kTrackedHoldNs = 500000000;
+static const float kQuatScale = 511.0f * 1.41421356f;
+
+static inline uint32_t ZigZag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline uint8_t* PutVarint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint8_t* PutU32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+// Signed 10 bit component k (0 = bits 20-29) of a packed rotation
+static inline int32_t QuatComponent(uint32_t q, int k) {
+    int32_t v = (int32_t)((q >> (20 - 10 * k)) & 0x3ff);
+    return v >= 512 ? v - 1024 : v;
+}
+
+HandTracker::HandTracker() {
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        mLastValidNs[hand].store(0);
+        mInput[hand].store(0);
+    }
+}
+
+HandTracker::~HandTracker() {
+    stop();
+}
+
+int64_t HandTracker::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+uint32_t HandTracker::PackQuat(const WVR_Quatf_t& q) {
+    float c[4] = { q.w, q.x, q.y, q.z };
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; i++) {
+        if (fabsf(c[i]) > fabsf(c[largest])) largest = i;
+    }
+    // q and -q are the same rotation, make the dropped component positive
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+    uint32_t packed = largest << 30;
+    int shift = 20;
+    for (uint32_t i = 0; i < 4; i++) {
+        if (i == largest) continue;
+        int32_t v = (int32_t)lroundf(c[i] * sign * kQuatScale);
+        if (v > 511) v = 511;
+        if (v < -511) v = -511;
+        packed |= ((uint32_t)v & 0x3ff) << shift;
+        shift -= 10;
+    }
+    return packed;
+}
+
+float HandTracker::GripStrength(const WVR_HandJointData_t& hand) {
+    const WVR_Vector3f_t& palm = hand.joints[kJointPalm].position;
+    float sum = 0.0f;
+    for (uint32_t tip : kGripTips) {
+        const WVR_Vector3f_t& t = hand.joints[tip].position;
+        float dx = t.v[0] - palm.v[0], dy = t.v[1] - palm.v[1], dz = t.v[2] - palm.v[2];
+        sum += sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+    float grip = (kGripOpen - sum / 3.0f) / (kGripOpen - kGripClosed);
+    return grip < 0.0f ? 0.0f : (grip > 1.0f ? 1.0f : grip);
+}
+
+void HandTracker::quantize(const WVR_HandJointData_t& in, HandState& out) {
+    out.jointCount = in.jointCount < MAX_JOINTS ? in.jointCount : MAX_JOINTS;
+    out.palm = in.joints[kJointPalm];
+
+    const WVR_Vector3f_t& origin = in.joints[kJointWrist].position;
+    for (uint32_t j = 0; j < out.jointCount; j++) {
+        const WVR_Pose_t& pose = in.joints[j];
+        for (int k = 0; k < 3; k++) {
+            float v = j == kJointWrist ? pose.position.v[k] : pose.position.v[k] - origin.v[k];
+            out.joints[j].p[k] = (int32_t)lroundf(v * 10000.0f);
+        }
+        out.joints[j].q = PackQuat(pose.rotation);
+    }
+}
+
+uint8_t* HandTracker::encodeHand(uint8_t* p, const HandState& hand, const HandState* prev, uint8_t pinch, uint8_t grip) {
+    *p++ = (uint8_t)hand.jointCount;
+    *p++ = pinch;
+    *p++ = grip;
+
+    for (uint32_t j = 0; j < hand.jointCount; j++) {
+        const QuantJoint& joint = hand.joints[j];
+        if (prev == nullptr) {
+            for (int k = 0; k < 3; k++) p = PutVarint(p, ZigZag(joint.p[k]));
+            p = PutU32(p, joint.q);
+            continue;
+        }
+
+        const QuantJoint& ref = prev->joints[j];
+        for (int k = 0; k < 3; k++) p = PutVarint(p, ZigZag(joint.p[k] - ref.p[k]));
+        if ((joint.q >> 30) == (ref.q >> 30)) {
+            p = PutVarint(p, ZigZag(QuatComponent(joint.q, 0) - QuatComponent(ref.q, 0)) << 1);
+            p = PutVarint(p, ZigZag(QuatComponent(joint.q, 1) - QuatComponent(ref.q, 1)));
+            p = PutVarint(p, ZigZag(QuatComponent(joint.q, 2) - QuatComponent(ref.q, 2)));
+        } else {
+            p = PutVarint(p, 1);
+            p = PutU32(p, joint.q);
+        }
+    }
+    return p;
+}
+
+void HandTracker::update(uint32_t rateHz, UserDataChannel& channel) {
+    if (rateHz != mRateHz) {
+        mRateHz = rateHz;
+        mUnsupported = false;
+        if (rateHz == 0) {
+            stop();
+        }
+    }
+    if (mRateHz == 0 || mUnsupported) {
+        return;
+    }
+
+    if (!mStarted) {
+        WVR_Result result = WVR_StartHandTracking(WVR_HandTrackerType_Natural);
+        uint32_t jointCount = 0;
+        if (result == WVR_Success) {
+            result = WVR_GetHandJointCount(WVR_HandTrackerType_Natural, &jointCount);
+        }
+        if (result != WVR_Success || jointCount <= kGripTips[2]) {
+            LOGW("[Hands] Hand tracking not available (%d, %u joints)", result, jointCount);
+            if (result == WVR_Success) WVR_StopHandTracking(WVR_HandTrackerType_Natural);
+            mUnsupported = true;
+            return;
+        }
+        mJointCount = jointCount;
+        // Once per start, on the pose thread
+        AllocAllowedScope allowAlloc;
+        for (int hand = 0; hand < HAND_COUNT; hand++) {
+            mJoints[hand].assign(jointCount, WVR_Pose_t());
+            mSent[hand].valid = false;
+        }
+        mStarted = true;
+        mNextSampleNs = 0;
+        LOGI("[Hands] Hand tracking started, %u joints at %u Hz", jointCount, mRateHz);
+    }
+
+    int64_t now = NowNs();
+    if (now < mNextSampleNs) {
+        return;
+    }
+    int64_t period = 1000000000LL / mRateHz;
+    mNextSampleNs = (mNextSampleNs == 0 || now - mNextSampleNs > period) ? now + period : mNextSampleNs + period;
+    sample(channel);
+}
+
+void HandTracker::stop() {
+    if (!mStarted) {
+        return;
+    }
+    WVR_StopHandTracking(WVR_HandTrackerType_Natural);
+    mStarted = false;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        mHands[hand].valid = false;
+        mSent[hand].valid = false;
+        mLastValidNs[hand].store(0);
+        mInput[hand].store(0);
+    }
+    LOGI("[Hands] Hand tracking stopped");
+}
+
+void HandTracker::sample(UserDataChannel& channel) {
+    int64_t begin = NowNs();
+
+    WVR_HandTrackingData_t data = {};
+    data.left.jointCount = mJointCount;
+    data.left.joints = mJoints[0].data();
+    data.right.jointCount = mJointCount;
+    data.right.joints = mJoints[1].data();
+    WVR_HandPoseData_t gestures = {};
+    bool ok = WVR_GetHandTrackingData(WVR_HandTrackerType_Natural, WVR_HandModelType_WithoutController,
+                                      WVR_PoseOriginModel_OriginOnGround, &data, &gestures) == WVR_Success;
+    int64_t queried = NowNs();
+
+    const WVR_HandJointData_t* joints[HAND_COUNT] = { &data.left, &data.right };
+    const WVR_HandPoseState_t* poses[HAND_COUNT] = { &gestures.left, &gestures.right };
+
+    // Keyframe on schedule, or when a hand has no reference in the last message
+    bool keyframe = mSinceKeyframe + 1 >= KEYFRAME_INTERVAL;
+    uint8_t pinch[HAND_COUNT] = {};
+    uint8_t grip[HAND_COUNT] = {};
+    int64_t encodeNs[HAND_COUNT] = {};
+    uint8_t flags = 0;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        int64_t handBegin = NowNs();
+        HandState& state = mHands[hand];
+        state.valid = ok && joints[hand]->isValidPose && joints[hand]->jointCount == mJointCount;
+        if (state.valid) {
+            quantize(*joints[hand], state);
+            float p = poses[hand]->base.type == WVR_HandPoseType_Pinch ? poses[hand]->pinch.strength : 0.0f;
+            pinch[hand] = (uint8_t)lroundf((p < 0.0f ? 0.0f : (p > 1.0f ? 1.0f : p)) * 255.0f);
+            grip[hand] = (uint8_t)lroundf(GripStrength(*joints[hand]) * 255.0f);
+            flags |= hand == 0 ? HandMessage_LeftValid : HandMessage_RightValid;
+            if (!mSent[hand].valid || mSent[hand].jointCount != state.jointCount) {
+                keyframe = true;
+            }
+            mLastValidNs[hand].store(begin, std::memory_order_relaxed);
+            mInput[hand].store(1u | (uint32_t)pinch[hand] << 8 | (uint32_t)grip[hand] << 16, std::memory_order_relaxed);
+        } else {
+            mInput[hand].store(0, std::memory_order_relaxed);
+        }
+        encodeNs[hand] = NowNs() - handBegin;
+    }
+
+    // Nothing tracked and the server already knows
+    bool anySent = mSent[0].valid || mSent[1].valid;
+    uint32_t size = 0;
+    bool sendFailed = false;
+    if (flags != 0 || anySent) {
+        if (keyframe) flags |= HandMessage_Keyframe;
+
+        // Encoded in place in the outgoing packet
+        sendFailed = !channel.write(HAND_MESSAGE_TYPE, MAX_MESSAGE_SIZE, [&](uint8_t* out) {
+            uint8_t* p = out;
+            *p++ = flags;
+            *p++ = (uint8_t)mSequence;
+            *p++ = (uint8_t)(mSequence >> 8);
+            p = PutU32(p, (uint32_t)(begin / 1000000));
+            for (int hand = 0; hand < HAND_COUNT; hand++) {
+                if (!mHands[hand].valid) continue;
+                int64_t handBegin = NowNs();
+                p = encodeHand(p, mHands[hand], keyframe ? nullptr : &mSent[hand], pinch[hand], grip[hand]);
+                encodeNs[hand] += NowNs() - handBegin;
+            }
+            size = (uint32_t)(p - out);
+            return size;
+        });
+
+        // A message that never made it is no delta reference
+        if (!sendFailed) {
+            for (int hand = 0; hand < HAND_COUNT; hand++) {
+                mSent[hand] = mHands[hand];
+            }
+            mSequence++;
+            mSinceKeyframe = keyframe ? 0 : mSinceKeyframe + 1;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    mSamples++;
+    mQueryNs += queried - begin;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        if (mHands[hand].valid) mValidSamples[hand]++;
+        mEncodeNs[hand] += encodeNs[hand];
+    }
+    if (size > 0) {
+        mMessages++;
+        mBytes += size;
+        if (keyframe) mKeyframes++;
+        if (sendFailed) mSendErrors++;
+    }
+}
+
+bool HandTracker::tracked(int hand) const {
+    int64_t last = mLastValidNs[hand].load(std::memory_order_relaxed);
+    return last != 0 && NowNs() - last < kTrackedHoldNs;
+}
+
+HandInput HandTracker::input(int hand) const {
+    uint32_t packed = mInput[hand].load(std::memory_order_relaxed);
+    HandInput input;
+    input.valid = (packed & 1) != 0;
+    input.pinch = ((packed >> 8) & 0xff) / 255.0f;
+    input.grip = ((packed >> 16) & 0xff) / 255.0f;
+    return input;
+}
+
+bool HandTracker::palmPose(int hand, WVR_PoseState_t& out) const {
+    if (!mHands[hand].valid) {
+        return false;
+    }
+
+    const WVR_Pose_t& palm = mHands[hand].palm;
+    const WVR_Quatf_t& q = palm.rotation;
+    out = WVR_PoseState_t();
+    WVR_Matrix4f_t& m = out.poseMatrix;
+    m.m[0][0] = 1 - 2 * (q.y * q.y + q.z * q.z);
+    m.m[0][1] = 2 * (q.x * q.y - q.z * q.w);
+    m.m[0][2] = 2 * (q.x * q.z + q.y * q.w);
+    m.m[1][0] = 2 * (q.x * q.y + q.z * q.w);
+    m.m[1][1] = 1 - 2 * (q.x * q.x + q.z * q.z);
+    m.m[1][2] = 2 * (q.y * q.z - q.x * q.w);
+    m.m[2][0] = 2 * (q.x * q.z - q.y * q.w);
+    m.m[2][1] = 2 * (q.y * q.z + q.x * q.w);
+    m.m[2][2] = 1 - 2 * (q.x * q.x + q.y * q.y);
+    for (int r = 0; r < 3; r++) {
+        m.m[r][3] = palm.position.v[r];
+    }
+    m.m[3][3] = 1.0f;
+    out.rawPose = palm;
+    out.isValidPose = true;
+    out.is6DoFPose = true;
+    out.originModel = WVR_PoseOriginModel_OriginOnGround;
+    return true;
+}
+
+void HandTracker::logReport() {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    int64_t now = NowNs();
+    float seconds = mWindowBeginNs ? (now - mWindowBeginNs) / 1e9f : 0.0f;
+    mWindowBeginNs = now;
+
+    float encodeUs[HAND_COUNT];
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        encodeUs[hand] = mValidSamples[hand] ? mEncodeNs[hand] / 1000.0f / mValidSamples[hand] : 0.0f;
+    }
+    if (mSamples > 0 && seconds > 0.0f) LOGI("[Hands] %.1f msg/s, %.0f B/s, avg %.0f B, keyframes %u, send errors %u, tracked left %.0f%% right %.0f%%, "
+         "query %.1f us, encode left %.1f us right %.1f us per sample",
+         mMessages / seconds, mBytes / seconds, mMessages ? (float)mBytes / mMessages : 0.0f,
+         mKeyframes, mSendErrors, 100.0f * mValidSamples[0] / mSamples, 100.0f * mValidSamples[1] / mSamples,
+         mQueryNs / 1000.0f / mSamples, encodeUs[0], encodeUs[1]);
+
+    mMessages = 0;
+    mKeyframes = 0;
+    mBytes = 0;
+    mSendErrors = 0;
+    mSamples = 0;
+    mQueryNs = 0;
+    for (int hand = 0; hand < HAND_COUNT; hand++) {
+        mValidSamples[hand] = 0;
+        mEncodeNs[hand] = 0;
+    }
+}
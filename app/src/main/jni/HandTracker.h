@@ -0,0 +1,128 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <wvr/wvr_types.h>
+#include <wvr/wvr_hand.h>
+
+#include "UserDataChannel.h"
+
+#define HAND_MESSAGE_TYPE 0x01
+
+/*
+ * Hand joint message, HAND_MESSAGE_TYPE on the UserDataChannel. Little endian:
+ *   flags (HandMessageFlags), sequence (u16), sample time in ms (u32)
+ *   per hand with its valid flag, left first:
+ *     joint count, pinch strength, grip strength (1 byte each, strengths 0-255)
+ *     per joint: position x, y, z, then rotation
+ * Positions are in 0.1 mm, the wrist in tracking space and the other joints relative
+ * to the wrist. Rotations are smallest-three quaternions packed in 32 bits: index of
+ * the largest component in bits 30-31, the others as 10 bit signed values scaled
+ * by 511 * sqrt(2), in bits 20-29, 10-19 and 0-9.
+ * In a keyframe positions are zigzag LEB128 varints and rotations raw u32.
+ * Otherwise every value is a zigzag varint delta to the same hand in the previous
+ * message: a rotation keeping its largest component is (da << 1), db, dc, one whose
+ * largest component changed is 1 followed by the raw u32.
+ * A hand coming back after being lost forces a keyframe, and one is sent every
+ * KEYFRAME_INTERVAL messages so a receiver recovers from a gap in the sequence.
+ * */
+enum HandMessageFlags
+{
+    HandMessage_Keyframe = 1 << 0,
+    HandMessage_LeftValid = 1 << 1,
+    HandMessage_RightValid = 1 << 2,
+};
+
+// Latest gesture state of a hand, 0-1
+struct HandInput
+{
+    bool valid = false;
+    float pinch = 0.0f;
+    float grip = 0.0f;
+};
+
+/*
+ * Samples WVR natural hand tracking on the pose thread at its own rate and streams
+ * the joints to the server. Pinch and grip are published for the render thread,
+ * which turns them into controller inputs.
+ * */
+class HandTracker
+{
+public:
+    static const int HAND_COUNT = 2;            // index 0 left, 1 right like ControllerManager
+    static const uint32_t KEYFRAME_INTERVAL = 30;
+    static const uint32_t MAX_JOINTS = 26;
+    static const uint32_t MAX_MESSAGE_SIZE = 7 + HAND_COUNT * (3 + MAX_JOINTS * 20);
+
+    HandTracker();
+    ~HandTracker();
+
+    // Pose thread. Starts or stops WVR hand tracking to follow rateHz (0 = off),
+    // samples and sends a message when one is due
+    void update(uint32_t rateHz, UserDataChannel& channel);
+    void stop();
+
+    // Safe from any thread. Tracked holds for a moment after the hand is lost
+    // so a short dropout doesn't unregister its controller
+    bool tracked(int hand) const;
+    HandInput input(int hand) const;
+
+    // Pose thread, palm pose of the last sample, false if the hand is not valid
+    bool palmPose(int hand, WVR_PoseState_t& out) const;
+
+    // Logs message rate, bandwidth and sampling cost of the window and starts a new one
+    void logReport();
+
+private:
+    struct QuantJoint {
+        int32_t p[3];
+        uint32_t q;
+    };
+
+    struct HandState {
+        bool valid = false;
+        uint32_t jointCount = 0;
+        QuantJoint joints[MAX_JOINTS];
+        WVR_Pose_t palm;
+    };
+
+    static int64_t NowNs();
+    static uint32_t PackQuat(const WVR_Quatf_t& q);
+    static float GripStrength(const WVR_HandJointData_t& hand);
+    void quantize(const WVR_HandJointData_t& in, HandState& out);
+    uint8_t* encodeHand(uint8_t* p, const HandState& hand, const HandState* prev, uint8_t pinch, uint8_t grip);
+    void sample(UserDataChannel& channel);
+
+    bool mStarted = false;
+    bool mUnsupported = false;
+    uint32_t mRateHz = 0;
+    int64_t mNextSampleNs = 0;
+    uint32_t mJointCount = 0;
+    std::vector<WVR_Pose_t> mJoints[HAND_COUNT];
+
+    // Encoder, pose thread only
+    HandState mHands[HAND_COUNT];
+    HandState mSent[HAND_COUNT];        // as last sent, the delta reference
+    uint16_t mSequence = 0;
+    uint32_t mSinceKeyframe = 0;
+
+    // Published for other threads
+    std::atomic<int64_t> mLastValidNs[HAND_COUNT];
+    std::atomic<uint32_t> mInput[HAND_COUNT];   // valid | pinch << 8 | grip << 16
+
+    // Window stats
+    std::mutex mStatsMutex;
+    int64_t mWindowBeginNs = 0;
+    uint32_t mMessages = 0;
+    uint32_t mKeyframes = 0;
+    uint64_t mBytes = 0;
+    uint32_t mSendErrors = 0;
+    uint32_t mSamples = 0;
+    int64_t mQueryNs = 0;
+    uint32_t mValidSamples[HAND_COUNT] = {};
+    int64_t mEncodeNs[HAND_COUNT] = {};
+};
@@ -0,0 +1,59 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <time.h>
+
+#include "LifecycleEventQueue.h"
+
+LifecycleEventQueue::LifecycleEventQueue()
+        : mEnqueuePos(0)
+        , mDropped(0) {
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+int64_t LifecycleEventQueue::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool LifecycleEventQueue::push(cxrClientState state, cxrError error) {
+    uint32_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &mCells[pos & (CAPACITY - 1)];
+        uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int32_t diff = (int32_t)(sequence - pos);
+        if (diff == 0) {
+            // The cell is free for this position, claim it
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Still holding an event from the previous lap
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->event.state = state;
+    cell->event.error = error;
+    cell->event.timeNs = NowNs();
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LifecycleEventQueue::pop(LifecycleEvent& out) {
+    Cell* cell = &mCells[mDequeuePos & (CAPACITY - 1)];
+    uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if ((int32_t)(sequence - (mDequeuePos + 1)) < 0) {
+        return false;
+    }
+    out = cell->event;
+    cell->sequence.store(mDequeuePos + CAPACITY, std::memory_order_release);
+    mDequeuePos++;
+    return true;
+}
@@ -0,0 +1,48 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <CloudXRClient.h>
+
+struct LifecycleEvent
+{
+    cxrClientState state;
+    cxrError error;
+    int64_t timeNs;         // CLOCK_MONOTONIC when the callback fired
+};
+
+/*
+ * Bounded lock-free queue of client state changes, any number of CloudXR
+ * callback threads push, the main loop pops. Each cell carries a sequence
+ * number telling whose turn it is, so neither side ever blocks or allocates.
+ * */
+class LifecycleEventQueue
+{
+public:
+    static const uint32_t CAPACITY = 64;    // power of two
+
+    LifecycleEventQueue();
+
+    // Any thread, false if the queue is full
+    bool push(cxrClientState state, cxrError error);
+
+    // Main loop only
+    bool pop(LifecycleEvent& out);
+
+    // Events lost to a full queue since the last call
+    uint32_t takeDropped() { return mDropped.exchange(0, std::memory_order_relaxed); }
+
+    static int64_t NowNs();
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        LifecycleEvent event;
+    };
+
+    Cell mCells[CAPACITY];
+    std::atomic<uint32_t> mEnqueuePos;
+    uint32_t mDequeuePos = 0;
+    std::atomic<uint32_t> mDropped;
+};
@@ -0,0 +1,95 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "MicUplink.h"
+
+static int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void MicUplink::prepare(int32_t channelCount, int32_t maxFrames) {
+    mChannels = channelCount > 0 ? channelCount : 1;
+    mMaxFrames = maxFrames > 0 ? maxFrames : 1;
+    mMono.assign(mChannels > 1 ? mMaxFrames : 0, 0);
+    mOut.assign(CXR_AUDIO_CHANNEL_COUNT > 1 ? mMaxFrames * CXR_AUDIO_CHANNEL_COUNT : 0, 0);
+    mDetector.reset();
+    if (mChannels != 1) {
+        LOGW("[Mic] Recording came up with %d channels instead of mono, sending the first one", mChannels);
+    }
+}
+
+void MicUplink::send(cxrReceiverHandle receiver, const int16_t* data, int32_t numFrames) {
+    // A callback longer than the stream's capacity is cut into blocks that fit the buffers
+    while (numFrames > 0) {
+        int32_t frames = numFrames < mMaxFrames ? numFrames : mMaxFrames;
+        sendBlock(receiver, data, frames);
+        data += frames * mChannels;
+        numFrames -= frames;
+    }
+}
+
+void MicUplink::sendBlock(cxrReceiverHandle receiver, const int16_t* data, int32_t numFrames) {
+    int64_t begin = NowNs();
+
+    const int16_t* mono = data;
+    if (mChannels > 1) {
+        int16_t* out = mMono.data();
+        for (int32_t i = 0; i < numFrames; i++) {
+            out[i] = data[i * mChannels];
+        }
+        mono = out;
+    }
+
+    uint32_t bytes = numFrames * CXR_AUDIO_CHANNEL_COUNT * CXR_AUDIO_SAMPLE_SIZE;
+    if (!mDetector.process(mono, numFrames, CXR_AUDIO_SAMPLING_RATE)) {
+        mSuppressedBlocks++;
+        mSuppressedBytes += bytes;
+        mProcessNs += NowNs() - begin;
+        return;
+    }
+
+    const int16_t* frame = mono;
+    if (CXR_AUDIO_CHANNEL_COUNT > 1) {
+        int16_t* out = mOut.data();
+        for (int32_t i = 0; i < numFrames; i++) {
+            for (int32_t c = 0; c < CXR_AUDIO_CHANNEL_COUNT; c++) {
+                out[i * CXR_AUDIO_CHANNEL_COUNT + c] = mono[i];
+            }
+        }
+        frame = out;
+    }
+    mProcessNs += NowNs() - begin;
+
+    cxrAudioFrame recordedFrame{};
+    recordedFrame.streamBuffer = (int16_t*)frame;
+    recordedFrame.streamSizeBytes = bytes;
+    if (cxrSendAudio(receiver, &recordedFrame) != cxrError_Success) {
+        mSendErrors++;
+    }
+    mSentBlocks++;
+    mSentBytes += bytes;
+}
+
+void MicUplink::logReport() {
+    uint32_t sent = mSentBlocks.exchange(0);
+    uint32_t suppressed = mSuppressedBlocks.exchange(0);
+    uint64_t sentBytes = mSentBytes.exchange(0);
+    uint64_t suppressedBytes = mSuppressedBytes.exchange(0);
+    uint64_t processNs = mProcessNs.exchange(0);
+    uint32_t errors = mSendErrors.exchange(0);
+    uint32_t blocks = sent + suppressed;
+    if (blocks == 0) {
+        return;
+    }
+    char gate[24] = "off";
+    if (mDetector.gateDb()) snprintf(gate, sizeof(gate), "-%u dBFS", mDetector.gateDb());
+    LOGI("[Mic] voice in %.0f%% of %u blocks, sent %llu kB, suppressed %llu kB, gate %s, "
+         "%.1f us per block, send errors %u",
+         100.0f * sent / blocks, blocks, (unsigned long long)(sentBytes / 1024),
+         (unsigned long long)(suppressedBytes / 1024), gate, processNs / 1000.0f / blocks, errors);
+}
@@ -0,0 +1,46 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <CloudXRClient.h>
+
+#include "VoiceActivity.h"
+
+/*
+ * Mic path to the server. The stream is captured mono, gated by voice activity,
+ * and only duplicated to the CXR_AUDIO_CHANNEL_COUNT channels CloudXR takes when
+ * a block is sent. Silent blocks are not sent at all, CloudXR audio has no
+ * comfort noise frame and the server plays the gap as silence.
+ * send() runs in the record callback, buffers are sized by prepare() so it
+ * doesn't allocate. logReport() from the main loop.
+ * */
+class MicUplink
+{
+public:
+    // channelCount is what the stream was opened with, maxFrames the most one callback passes
+    void prepare(int32_t channelCount, int32_t maxFrames);
+    void setGateDb(uint32_t gateDb) { mDetector.setGateDb(gateDb); }
+
+    void send(cxrReceiverHandle receiver, const int16_t* data, int32_t numFrames);
+
+    void logReport();
+
+private:
+    void sendBlock(cxrReceiverHandle receiver, const int16_t* data, int32_t numFrames);
+
+    VoiceActivityDetector mDetector;
+    int32_t mChannels = 1;
+    int32_t mMaxFrames = 0;
+    std::vector<int16_t> mMono;     // first channel when the stream came up with more than one
+    std::vector<int16_t> mOut;      // interleaved for cxrSendAudio
+
+    // Since the last report
+    std::atomic<uint32_t> mSentBlocks{0};
+    std::atomic<uint32_t> mSuppressedBlocks{0};
+    std::atomic<uint64_t> mSentBytes{0};
+    std::atomic<uint64_t> mSuppressedBytes{0};
+    std::atomic<uint64_t> mProcessNs{0};
+    std::atomic<uint32_t> mSendErrors{0};
+};
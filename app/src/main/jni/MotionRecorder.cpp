@@ -0,0 +1,334 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+#include "MotionRecorder.h"
+
+#define MOTION_FILE_MAGIC 0x4d525843  // "CXRM"
+#define MOTION_FILE_VERSION 2
+
+static const uint32_t kPosePayload = 1 + 18 * sizeof(float);
+static const uint32_t kEventPayload = 5 + 2;
+static const uint32_t kAgePayload = 5;
+// Timestamps older than this, or ahead of the clock, are from another clock
+static const int64_t kMaxAgeUs = 1000000;
+
+static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t* PutVarint(uint8_t* p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+// WVR timestamps are CLOCK_MONOTONIC ns, as steady_clock
+static uint64_t EncodeAge(int64_t nowUs, int64_t timestampNs) {
+    int64_t age = nowUs - timestampNs / 1000;
+    return (timestampNs > 0 && age >= 0 && age <= kMaxAgeUs) ? (uint64_t)age + 1 : 0;
+}
+
+static const uint8_t* GetVarint(const uint8_t* p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+MotionRecorder::~MotionRecorder() {
+    stop();
+}
+
+bool MotionRecorder::start(const char* path, uint64_t capacity) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mBase) {
+        return true;
+    }
+
+    mFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (mFd < 0 || ftruncate(mFd, capacity) != 0) {
+        LOGE("[Motion] Can't create %s: %s", path, strerror(errno));
+        if (mFd >= 0) ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (base == MAP_FAILED) {
+        LOGE("[Motion] mmap %s failed: %s", path, strerror(errno));
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mBase = (uint8_t*)base;
+    mCapacity = capacity;
+    mOffset = sizeof(MotionFileHeader);
+    mLastUs = 0;
+    mRecords = 0;
+
+    MotionFileHeader* header = (MotionFileHeader*)mBase;
+    header->magic = MOTION_FILE_MAGIC;
+    header->version = MOTION_FILE_VERSION;
+    header->startRealtimeUs = 0;
+    header->used = 0;
+
+    mActive = true;
+    LOGI("[Motion] Recording to %s", path);
+    return true;
+}
+
+void MotionRecorder::stop() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mActive = false;
+    if (!mBase) {
+        return;
+    }
+
+    munmap(mBase, mCapacity);
+    if (ftruncate(mFd, mOffset) != 0) {
+        LOGW("[Motion] Can't trim recording: %s", strerror(errno));
+    }
+    ::close(mFd);
+    LOGI("[Motion] Recorded %u records, %llu bytes", mRecords, (unsigned long long)mOffset);
+
+    mBase = nullptr;
+    mFd = -1;
+}
+
+// Called with mMutex held, returns where the payload goes
+uint8_t* MotionRecorder::reserve(MotionRecordKind kind, uint32_t maxPayload, int64_t now) {
+    if (!mBase) {
+        return nullptr;
+    }
+    if (mOffset + 1 + 10 + maxPayload > mCapacity) {
+        LOGW("[Motion] Recording full after %u records", mRecords);
+        mActive = false;
+        return nullptr;
+    }
+
+    MotionFileHeader* header = (MotionFileHeader*)mBase;
+    if (mRecords == 0) {
+        header->startRealtimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        mLastUs = now;
+    }
+
+    uint8_t* p = mBase + mOffset;
+    *p++ = (uint8_t)kind;
+    p = PutVarint(p, (uint64_t)(now - mLastUs));
+    mLastUs = now;
+    mRecords++;
+    return p;
+}
+
+void MotionRecorder::recordPose(WVR_DeviceType device, const WVR_PoseState_t& pose) {
+    if (!mActive) {
+        return;
+    }
+
+    MotionRecordKind kind = device == WVR_DeviceType_Controller_Left ? MotionRecord_PoseLeft :
+                            device == WVR_DeviceType_Controller_Right ? MotionRecord_PoseRight :
+                            MotionRecord_PoseHMD;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t now = NowUs();
+    uint8_t* p = reserve(kind, kPosePayload + kAgePayload, now);
+    if (!p) {
+        return;
+    }
+
+    *p++ = (pose.isValidPose ? 1 : 0) | (pose.is6DoFPose ? 2 : 0);
+    float values[18];
+    memcpy(values, pose.poseMatrix.m, 12 * sizeof(float));
+    memcpy(values + 12, &pose.velocity, 3 * sizeof(float));
+    memcpy(values + 15, &pose.angularVelocity, 3 * sizeof(float));
+    memcpy(p, values, sizeof(values));
+    p += sizeof(values);
+    p = PutVarint(p, EncodeAge(now, pose.timestamp));
+
+    mOffset = p - mBase;
+    ((MotionFileHeader*)mBase)->used = mOffset - sizeof(MotionFileHeader);
+}
+
+void MotionRecorder::recordEvent(const WVR_Event_t& event) {
+    if (!mActive) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    int64_t now = NowUs();
+    uint8_t* p = reserve(MotionRecord_Event, kEventPayload + kAgePayload, now);
+    if (!p) {
+        return;
+    }
+
+    p = PutVarint(p, (uint32_t)event.common.type);
+    *p++ = (uint8_t)event.device.deviceType;
+    *p++ = (uint8_t)event.input.inputId;
+    p = PutVarint(p, EncodeAge(now, event.common.timestamp));
+
+    mOffset = p - mBase;
+    ((MotionFileHeader*)mBase)->used = mOffset - sizeof(MotionFileHeader);
+}
+
+MotionReplayer::~MotionReplayer() {
+    close();
+}
+
+bool MotionReplayer::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(MotionFileHeader)) {
+        LOGE("[Motion] Can't open recording %s", path);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOGE("[Motion] mmap %s failed: %s", path, strerror(errno));
+        return false;
+    }
+
+    const MotionFileHeader* header = (const MotionFileHeader*)base;
+    // Version 1 has no timestamp ages
+    if (header->magic != MOTION_FILE_MAGIC || header->version < 1 || header->version > MOTION_FILE_VERSION) {
+        LOGE("[Motion] %s is not a motion recording", path);
+        munmap(base, st.st_size);
+        return false;
+    }
+
+    mBase = (const uint8_t*)base;
+    mSize = st.st_size;
+    mVersion = header->version;
+    mEnd = sizeof(MotionFileHeader) + header->used;
+    if (mEnd > mSize) mEnd = mSize;
+    rewind();
+    mStop = false;
+    return true;
+}
+
+void MotionReplayer::close() {
+    if (mBase) {
+        munmap((void*)mBase, mSize);
+        mBase = nullptr;
+    }
+}
+
+void MotionReplayer::rewind() {
+    mOffset = sizeof(MotionFileHeader);
+    mTimeUs = 0;
+}
+
+bool MotionReplayer::next(MotionSample& out) {
+    if (!mBase || mOffset >= mEnd) {
+        return false;
+    }
+
+    const uint8_t* p = mBase + mOffset;
+    const uint8_t* end = mBase + mEnd;
+    uint8_t kind = *p++;
+    uint64_t delta = 0;
+    p = GetVarint(p, end, delta);
+    if (!p || kind > MotionRecord_Event) {
+        mOffset = mEnd;
+        return false;
+    }
+    mTimeUs += (int64_t)delta;
+
+    out.kind = (MotionRecordKind)kind;
+    out.timeUs = mTimeUs;
+    out.ageUs = -1;
+
+    if (kind == MotionRecord_Event) {
+        uint64_t type = 0;
+        p = GetVarint(p, end, type);
+        if (!p || end - p < 2) {
+            mOffset = mEnd;
+            return false;
+        }
+        memset(&out.event, 0, sizeof(out.event));
+        out.event.common.type = (WVR_EventType)type;
+        out.event.device.deviceType = (WVR_DeviceType)p[0];
+        out.event.input.inputId = (WVR_InputId)p[1];
+        p += 2;
+    } else {
+        if (end - p < (int64_t)kPosePayload) {
+            mOffset = mEnd;
+            return false;
+        }
+        memset(&out.pose, 0, sizeof(out.pose));
+        uint8_t flags = *p++;
+        out.pose.isValidPose = (flags & 1) != 0;
+        out.pose.is6DoFPose = (flags & 2) != 0;
+        float values[18];
+        memcpy(values, p, sizeof(values));
+        p += sizeof(values);
+        memcpy(out.pose.poseMatrix.m, values, 12 * sizeof(float));
+        out.pose.poseMatrix.m[3][3] = 1.0f;
+        memcpy(&out.pose.velocity, values + 12, 3 * sizeof(float));
+        memcpy(&out.pose.angularVelocity, values + 15, 3 * sizeof(float));
+    }
+
+    if (mVersion >= 2) {
+        uint64_t age = 0;
+        p = GetVarint(p, end, age);
+        if (!p) {
+            mOffset = mEnd;
+            return false;
+        }
+        if (age > 0) out.ageUs = (int64_t)age - 1;
+    }
+
+    mOffset = p - mBase;
+    return true;
+}
+
+uint32_t MotionReplayer::run(float speed,
+                             const std::function<void(WVR_DeviceType, const WVR_PoseState_t&)>& onPose,
+                             const std::function<void(const WVR_Event_t&)>& onEvent) {
+    static const WVR_DeviceType devices[] = {
+            WVR_DeviceType_HMD, WVR_DeviceType_Controller_Left, WVR_DeviceType_Controller_Right };
+
+    auto begin = std::chrono::steady_clock::now();
+    uint32_t count = 0;
+    MotionSample sample;
+    while (!mStop && next(sample)) {
+        if (speed > 0.0f) {
+            std::this_thread::sleep_until(begin + std::chrono::microseconds((int64_t)(sample.timeUs / speed)));
+        }
+
+        // Recordings without ages get the replay time, like a sample taken just now
+        int64_t timestampNs = (NowUs() - (sample.ageUs > 0 ? sample.ageUs : 0)) * 1000;
+        sample.pose.timestamp = timestampNs;
+        sample.event.common.timestamp = timestampNs;
+
+        if (sample.kind == MotionRecord_Event) {
+            if (onEvent) onEvent(sample.event);
+        } else {
+            if (onPose) onPose(devices[sample.kind], sample.pose);
+        }
+        count++;
+    }
+    return count;
+}
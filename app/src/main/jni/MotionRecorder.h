@@ -0,0 +1,106 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include <wvr/wvr_types.h>
+#include <wvr/wvr_events.h>
+
+#define MOTION_RECORDING_PATH "/sdcard/CloudXRMotion.bin"
+
+/*
+ * File layout: MotionFileHeader, then records of
+ *   kind (1 byte), time delta to the previous record in us (LEB128),
+ *   pose: flags (1 byte), poseMatrix rows 0-2, velocity, angularVelocity (18 floats)
+ *   event: type (LEB128), device (1 byte), input id (1 byte)
+ *   version 2 and up, both: age of the WVR timestamp when recorded in us + 1 (LEB128), 0 = unknown
+ * */
+enum MotionRecordKind
+{
+    MotionRecord_PoseHMD = 0,
+    MotionRecord_PoseLeft,
+    MotionRecord_PoseRight,
+    MotionRecord_Event,
+};
+
+struct MotionFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t startRealtimeUs;    // wall clock of the first record
+    uint64_t used;              // bytes of records, kept current so a killed session stays readable
+};
+
+/*
+ * Appends pose samples and input events to a memory-mapped file.
+ * Recording calls are a flag check when inactive.
+ * */
+class MotionRecorder
+{
+public:
+    ~MotionRecorder();
+
+    bool start(const char* path, uint64_t capacity = 32 * 1024 * 1024);
+    void stop();
+    bool active() const { return mActive; }
+
+    // The WVR timestamps are kept as their age, replay stamps them on its own clock
+    void recordPose(WVR_DeviceType device, const WVR_PoseState_t& pose);
+    void recordEvent(const WVR_Event_t& event);
+
+private:
+    uint8_t* reserve(MotionRecordKind kind, uint32_t maxPayload, int64_t now);
+
+    std::atomic<bool> mActive{false};
+    std::mutex mMutex;
+    int mFd = -1;
+    uint8_t* mBase = nullptr;
+    uint64_t mCapacity = 0;
+    uint64_t mOffset = 0;
+    int64_t mLastUs = 0;
+    uint32_t mRecords = 0;
+};
+
+struct MotionSample
+{
+    MotionRecordKind kind;
+    int64_t timeUs;             // since the first record
+    int64_t ageUs;              // of the WVR timestamp when recorded, -1 = unknown
+    WVR_PoseState_t pose;       // kind is a pose
+    WVR_Event_t event;          // kind is MotionRecord_Event
+};
+
+/*
+ * Reads a recording back, either record by record or paced by run().
+ * */
+class MotionReplayer
+{
+public:
+    ~MotionReplayer();
+
+    bool open(const char* path);
+    void close();
+    void rewind();
+
+    bool next(MotionSample& out);
+
+    // Feeds every record at its original timing divided by speed, speed <= 0
+    // replays as fast as possible. stop() ends it early. Returns the record count.
+    // Pose and event timestamps are restamped to the replay time minus their recorded age
+    uint32_t run(float speed,
+                 const std::function<void(WVR_DeviceType, const WVR_PoseState_t&)>& onPose,
+                 const std::function<void(const WVR_Event_t&)>& onEvent);
+    void stop() { mStop = true; }
+
+private:
+    std::atomic<bool> mStop{false};
+    const uint8_t* mBase = nullptr;
+    uint64_t mSize = 0;
+    uint64_t mEnd = 0;
+    uint64_t mOffset = 0;
+    uint32_t mVersion = 0;
+    int64_t mTimeUs = 0;
+};
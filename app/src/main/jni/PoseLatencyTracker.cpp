@@ -0,0 +1,170 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+#include <chrono>
+
+#include "PoseLatencyTracker.h"
+
+// Head motion over the match window below this (metres, about radians for the
+// rotation part) can't tell samples apart
+#define POSE_MIN_MOTION 1e-3f
+// A match must be closer than this share of the window's motion to be unambiguous
+#define POSE_MATCH_SHARE 0.5f
+// Sample timestamps older than this are not from the live tracker
+#define POSE_MAX_SAMPLE_AGE_US 1000000
+
+void LatencyHistogram::add(float ms) {
+    uint32_t bucket = ms > 0.0f ? (uint32_t)ms : 0;
+    if (bucket >= BUCKETS) bucket = BUCKETS - 1;
+    buckets[bucket]++;
+    count++;
+    sumMs += ms;
+    if (ms > maxMs) maxMs = ms;
+}
+
+// Upper edge of the bucket holding the p-th sample
+float LatencyHistogram::percentile(float p) const {
+    if (count == 0) return 0.0f;
+    uint32_t rank = (uint32_t)ceilf(p * count);
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) return (float)(i + 1);
+    }
+    return (float)BUCKETS;
+}
+
+int64_t PoseLatencyTracker::NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PoseLatencyTracker::ToMatrix(const cxrTrackedDevicePose& pose, cxrMatrix34& out) {
+    const cxrQuaternion& q = pose.rotation;
+    out.m[0][0] = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+    out.m[0][1] = 2.0f * (q.x * q.y - q.z * q.w);
+    out.m[0][2] = 2.0f * (q.x * q.z + q.y * q.w);
+    out.m[1][0] = 2.0f * (q.x * q.y + q.z * q.w);
+    out.m[1][1] = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
+    out.m[1][2] = 2.0f * (q.y * q.z - q.x * q.w);
+    out.m[2][0] = 2.0f * (q.x * q.z - q.y * q.w);
+    out.m[2][1] = 2.0f * (q.y * q.z + q.x * q.w);
+    out.m[2][2] = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+    out.m[0][3] = pose.position.v[0];
+    out.m[1][3] = pose.position.v[1];
+    out.m[2][3] = pose.position.v[2];
+}
+
+// Largest element difference, covers rotation and translation (metres)
+float PoseLatencyTracker::Distance(const cxrMatrix34& a, const cxrMatrix34& b) {
+    float maxDiff = 0.0f;
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            float diff = fabsf(a.m[r][c] - b.m[r][c]);
+            if (diff > maxDiff) maxDiff = diff;
+        }
+    }
+    return maxDiff;
+}
+
+void PoseLatencyTracker::reset() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mHistoryCount = 0;
+    mHead = 0;
+    mLatchedSampleUs = 0;
+    mMatched = 0;
+    mUnmatched = 0;
+    mStill = 0;
+    mToLatch = LatencyHistogram();
+    mToSubmit = LatencyHistogram();
+}
+
+void PoseLatencyTracker::onPoseSent(const cxrTrackedDevicePose& hmd, int64_t sampleTimeNs) {
+    int64_t now = NowUs();
+    Sample sample;
+    sample.timeUs = sampleTimeNs / 1000;
+    if (sample.timeUs <= 0 || sample.timeUs > now || now - sample.timeUs > POSE_MAX_SAMPLE_AGE_US) {
+        sample.timeUs = now;
+    }
+    ToMatrix(hmd, sample.pose);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    // CloudXR polls faster than poses are sampled, keep each sample once
+    if (mHistoryCount > 0 && mHistory[(mHead + HISTORY_SIZE - 1) % HISTORY_SIZE].timeUs == sample.timeUs) {
+        return;
+    }
+    mHistory[mHead] = sample;
+    mHead = (mHead + 1) % HISTORY_SIZE;
+    if (mHistoryCount < HISTORY_SIZE) mHistoryCount++;
+}
+
+bool PoseLatencyTracker::onLatched(const cxrMatrix34& framePose) {
+    int64_t now = NowUs();
+    int64_t sampleUs = 0;
+    bool still = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Newest first, ties go to the most recent sample
+        const Sample* newest = nullptr;
+        float best = 0.0f;
+        float spread = 0.0f;
+        for (uint32_t i = 0; i < mHistoryCount; i++) {
+            const Sample& s = mHistory[(mHead + HISTORY_SIZE - 1 - i) % HISTORY_SIZE];
+            if (now - s.timeUs > MATCH_WINDOW_US) {
+                continue;
+            }
+            if (newest == nullptr) newest = &s;
+            spread = fmaxf(spread, Distance(s.pose, newest->pose));
+            float d = Distance(s.pose, framePose);
+            if (sampleUs == 0 || d < best) {
+                best = d;
+                sampleUs = s.timeUs;
+            }
+        }
+        if (newest && spread < POSE_MIN_MOTION) {
+            still = true;
+            sampleUs = 0;
+        } else if (best > spread * POSE_MATCH_SHARE) {
+            sampleUs = 0;
+        }
+    }
+
+    mLatchedSampleUs = sampleUs;
+    mLatchedAgeUs = sampleUs ? (uint32_t)(now - sampleUs) : 0;
+    if (sampleUs == 0) {
+        if (still) mStill++;
+        else mUnmatched++;
+        return false;
+    }
+
+    mMatched++;
+    mToLatch.add((now - sampleUs) / 1000.0f);
+    return true;
+}
+
+void PoseLatencyTracker::onSubmitted() {
+    if (mLatchedSampleUs == 0) {
+        return;
+    }
+    mToSubmit.add((NowUs() - mLatchedSampleUs) / 1000.0f);
+    mLatchedSampleUs = 0;
+}
+
+void PoseLatencyTracker::logReport() {
+    if (mMatched + mUnmatched + mStill == 0) {
+        return;
+    }
+
+    LOGI("[MTP] matched %u/%u frames (%u still), sample->latch avg %.1f p50 %.0f p95 %.0f max %.1f ms, "
+         "sample->submit avg %.1f p50 %.0f p95 %.0f max %.1f ms",
+         mMatched, mMatched + mUnmatched + mStill, mStill,
+         mToLatch.average(), mToLatch.percentile(0.5f), mToLatch.percentile(0.95f), mToLatch.maxMs,
+         mToSubmit.average(), mToSubmit.percentile(0.5f), mToSubmit.percentile(0.95f), mToSubmit.maxMs);
+
+    mMatched = 0;
+    mUnmatched = 0;
+    mStill = 0;
+    mToLatch = LatencyHistogram();
+    mToSubmit = LatencyHistogram();
+}
@@ -0,0 +1,75 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <mutex>
+#include <CloudXRCommon.h>
+
+struct LatencyHistogram
+{
+    static const uint32_t BUCKETS = 200;   // 1 ms each, last bucket collects the rest
+
+    uint32_t buckets[BUCKETS] = {};
+    uint32_t count = 0;
+    double sumMs = 0.0;
+    float maxMs = 0.0f;
+
+    void add(float ms);
+    float percentile(float p) const;
+    float average() const { return count ? (float)(sumMs / count) : 0.0f; }
+};
+
+/*
+ * Estimates motion-to-photon per frame. Every HMD pose handed to CloudXR in
+ * GetTrackingState is kept in a ring with its WVR sample time. The pose a latched
+ * frame was rendered with is server-predicted, so it is matched to the nearest
+ * sample of the last MATCH_WINDOW_US rather than an exact one. The sample time of
+ * that pose is the motion the frame shows, which gives its age when the frame is
+ * latched and when it is submitted. While the head is still every sample is
+ * nearest, those frames are counted as still and not measured.
+ * */
+class PoseLatencyTracker
+{
+public:
+    static const uint32_t HISTORY_SIZE = 128;   // ~0.5 s at 250 Hz
+    static const int64_t MATCH_WINDOW_US = 200000;
+
+    void reset();
+
+    // CloudXR tracking thread. sampleTimeNs is the WVR pose timestamp (CLOCK_MONOTONIC),
+    // when it is not recent, e.g. for replayed poses, the send time is used instead
+    void onPoseSent(const cxrTrackedDevicePose& hmd, int64_t sampleTimeNs);
+
+    // Render thread. Returns false if no sample clearly matches, or the head was still
+    bool onLatched(const cxrMatrix34& framePose);
+    void onSubmitted();
+
+    // Age of the motion sample of the last latched frame when it was latched, 0 = unmatched
+    uint32_t latchedAgeUs() const { return mLatchedAgeUs; }
+
+    // Logs the histograms of the window and starts a new one
+    void logReport();
+
+private:
+    struct Sample {
+        int64_t timeUs;
+        cxrMatrix34 pose;
+    };
+
+    static int64_t NowUs();
+    static void ToMatrix(const cxrTrackedDevicePose& pose, cxrMatrix34& out);
+    static float Distance(const cxrMatrix34& a, const cxrMatrix34& b);
+
+    std::mutex mMutex;
+    Sample mHistory[HISTORY_SIZE] = {};
+    uint32_t mHistoryCount = 0;
+    uint32_t mHead = 0;
+
+    int64_t mLatchedSampleUs = 0;   // 0 = last latch unmatched
+    uint32_t mLatchedAgeUs = 0;
+    uint32_t mMatched = 0;
+    uint32_t mUnmatched = 0;
+    uint32_t mStill = 0;
+    LatencyHistogram mToLatch;
+    LatencyHistogram mToSubmit;
+};
@@ -0,0 +1,162 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+#include <time.h>
+
+#include "PoseSampler.h"
+
+// Movement allowed between samples, about what 6DoF tracking jitters by when still
+static const float kMaxPositionError = 0.0002f;     // m
+static const float kMaxRotationError = 0.0002f;     // rad
+// Acceleration that starts a burst, well above tracking noise of a still device
+static const float kBurstLinearAccel = 2.0f;        // m/s^2
+static const float kBurstAngularAccel = 8.0f;       // rad/s^2
+// Velocity smoothing, and the shortest span its change is taken as acceleration over.
+// Differencing raw velocities 4 ms apart turns a few mm/s of noise into m/s^2
+static const float kVelocitySmoothing = 0.5f;
+static const int64_t kMinAccelSpanNs = 20000000;
+
+static float Length(const WVR_Vector3f_t& v) {
+    return sqrtf(v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]);
+}
+
+static float Distance(const WVR_Vector3f_t& a, const WVR_Vector3f_t& b) {
+    float x = a.v[0] - b.v[0], y = a.v[1] - b.v[1], z = a.v[2] - b.v[2];
+    return sqrtf(x * x + y * y + z * z);
+}
+
+static void Smooth(WVR_Vector3f_t& smoothed, const WVR_Vector3f_t& sample) {
+    for (int i = 0; i < 3; i++) {
+        smoothed.v[i] += kVelocitySmoothing * (sample.v[i] - smoothed.v[i]);
+    }
+}
+
+int64_t PoseSampler::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+const char* PoseSampler::SourceToString(PoseSource source) {
+    switch (source) {
+        case PoseSource_HMD: return "hmd";
+        case PoseSource_Left: return "left";
+        case PoseSource_Right: return "right";
+        default: return "unknown";
+    }
+}
+
+void PoseSampler::configure(uint32_t minHz, uint32_t maxHz) {
+    mMaxHz = maxHz > 0 ? maxHz : 1;
+    mMinHz = minHz;
+}
+
+uint32_t PoseSampler::floorHz() const {
+    uint32_t displayHz = mDisplayHz, minHz = mMinHz, maxHz = mMaxHz;
+    uint32_t floor = displayHz > minHz ? displayHz : minHz;
+    if (floor < IDLE_HZ) floor = IDLE_HZ;   // neither may be set, the rates divide by it
+    return floor < maxHz ? floor : maxHz;
+}
+
+void PoseSampler::reset(int64_t now) {
+    for (int i = 0; i < PoseSource_Count; i++) {
+        mDevices[i] = Device();
+        mDevices[i].nextNs = now;
+    }
+}
+
+int64_t PoseSampler::nextDueNs() const {
+    int64_t next = mDevices[0].nextNs;
+    for (int i = 1; i < PoseSource_Count; i++) {
+        if (mDevices[i].nextNs < next) next = mDevices[i].nextNs;
+    }
+    return next;
+}
+
+void PoseSampler::onSample(PoseSource source, const WVR_PoseState_t& pose, int64_t now, int64_t costNs) {
+    Device& device = mDevices[source];
+    uint32_t floor = floorHz();
+    uint32_t maxHz = mMaxHz;
+
+    uint32_t rateHz;
+    if (!pose.isValidPose) {
+        // Not used for prediction, just notice when it comes back
+        rateHz = source == PoseSource_HMD ? floor : (IDLE_HZ < floor ? IDLE_HZ : floor);
+        device.tracked = false;
+    } else {
+        if (!device.tracked) {
+            device.tracked = true;
+            device.velocity = pose.velocity;
+            device.angularVelocity = pose.angularVelocity;
+            device.referenceNs = now;
+            device.referenceVelocity = pose.velocity;
+            device.referenceAngularVelocity = pose.angularVelocity;
+        } else {
+            Smooth(device.velocity, pose.velocity);
+            Smooth(device.angularVelocity, pose.angularVelocity);
+        }
+
+        // Acceleration as reported, or as the smoothed velocity changed over at least kMinAccelSpanNs
+        float linearAccel = Length(pose.acceleration);
+        float angularAccel = Length(pose.angularAcceleration);
+        if (now - device.referenceNs >= kMinAccelSpanNs) {
+            float span = (now - device.referenceNs) / 1e9f;
+            linearAccel = fmaxf(linearAccel, Distance(device.velocity, device.referenceVelocity) / span);
+            angularAccel = fmaxf(angularAccel, Distance(device.angularVelocity, device.referenceAngularVelocity) / span);
+            device.referenceNs = now;
+            device.referenceVelocity = device.velocity;
+            device.referenceAngularVelocity = device.angularVelocity;
+        }
+        if (linearAccel > kBurstLinearAccel || angularAccel > kBurstAngularAccel) {
+            if (now >= device.burstUntilNs) {
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                mBursts[source]++;
+            }
+            device.burstUntilNs = now + BURST_MS * 1000000LL;
+        }
+
+        if (now < device.burstUntilNs) {
+            rateHz = maxHz;
+        } else {
+            // Fast enough that one interval at this speed stays within the error budget
+            float needHz = fmaxf(Length(pose.velocity) / kMaxPositionError,
+                                 Length(pose.angularVelocity) / kMaxRotationError);
+            rateHz = needHz >= maxHz ? maxHz : (needHz > floor ? (uint32_t)needHz : floor);
+        }
+    }
+
+    device.nextNs = now + 1000000000LL / rateHz;
+
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    mSamples[source]++;
+    mCostNs += costNs;
+}
+
+void PoseSampler::logReport() {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    int64_t now = NowNs();
+    float seconds = mWindowBeginNs ? (now - mWindowBeginNs) / 1e9f : 0.0f;
+    mWindowBeginNs = now;
+
+    uint32_t total = mSamples[0] + mSamples[1] + mSamples[2];
+    if (total > 0 && seconds > 0.0f) {
+        // What sampling all devices at maxHz would have cost at the measured cost per sample
+        float costUs = mCostNs / 1000.0f / total;
+        uint32_t maxHz = mMaxHz;
+        float fixedPerSec = (float)maxHz * PoseSource_Count;
+        float actualPerSec = total / seconds;
+        float savedUsPerSec = (fixedPerSec - actualPerSec) * costUs;
+        LOGI("[PoseRate] hmd %.0f left %.0f right %.0f samples/s (floor %u Hz, bursts %u/%u/%u), %.1f us per sample, "
+             "%.0f%% of the %u Hz fixed rate, %.2f ms CPU saved per second",
+             mSamples[0] / seconds, mSamples[1] / seconds, mSamples[2] / seconds, floorHz(),
+             mBursts[0], mBursts[1], mBursts[2], costUs, 100.0f * actualPerSec / fixedPerSec, maxHz,
+             savedUsPerSec > 0.0f ? savedUsPerSec / 1000.0f : 0.0f);
+    }
+
+    for (int i = 0; i < PoseSource_Count; i++) {
+        mSamples[i] = 0;
+        mBursts[i] = 0;
+    }
+    mCostNs = 0;
+}
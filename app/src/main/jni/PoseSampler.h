@@ -0,0 +1,79 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <wvr/wvr_types.h>
+
+enum PoseSource
+{
+    PoseSource_HMD,
+    PoseSource_Left,
+    PoseSource_Right,
+    PoseSource_Count,
+};
+
+/*
+ * Per device pose sampling rate that follows the device's motion. CloudXR sends
+ * the last sampled pose as the current one, so a pose is as stale as the time
+ * since its sample. The rate keeps how far a device moves in that time within
+ * about the tracking noise, from its speed, between a floor and maxHz.
+ * The floor is the display rate, or minHz when higher, so no device is sampled
+ * less often than frames are predicted, and never below IDLE_HZ. Acceleration,
+ * reported by WVR or seen in the smoothed velocity, bursts a device to maxHz for
+ * BURST_MS. Controllers without a valid pose drop to IDLE_HZ.
+ * Pose thread, except setDisplayHz() and logReport().
+ * */
+class PoseSampler
+{
+public:
+    static const uint32_t BURST_MS = 250;
+    static const uint32_t IDLE_HZ = 10;
+
+    // floor >= maxHz samples everything at maxHz
+    void configure(uint32_t minHz, uint32_t maxHz);
+    // Any thread, the display rate raises the floor
+    void setDisplayHz(float displayHz) { mDisplayHz = (uint32_t)(displayHz + 0.5f); }
+    // Every device due now
+    void reset(int64_t now);
+
+    bool due(PoseSource source, int64_t now) const { return now >= mDevices[source].nextNs; }
+    int64_t nextDueNs() const;
+    uint32_t floorHz() const;
+
+    // After a sample, picks the device's next one from its motion. costNs is what the sample took
+    void onSample(PoseSource source, const WVR_PoseState_t& pose, int64_t now, int64_t costNs);
+
+    // Samples per second of each device and the CPU time saved against sampling all at maxHz
+    void logReport();
+
+    static int64_t NowNs();
+    static const char* SourceToString(PoseSource source);
+
+private:
+    struct Device {
+        int64_t nextNs = 0;
+        int64_t burstUntilNs = 0;
+        // Smoothed velocities, and the ones acceleration is measured against
+        bool tracked = false;
+        WVR_Vector3f_t velocity = {};
+        WVR_Vector3f_t angularVelocity = {};
+        int64_t referenceNs = 0;
+        WVR_Vector3f_t referenceVelocity = {};
+        WVR_Vector3f_t referenceAngularVelocity = {};
+    };
+
+    // Written by the pose thread, read by logReport() too
+    std::atomic<uint32_t> mMinHz{0};
+    std::atomic<uint32_t> mMaxHz{250};
+    std::atomic<uint32_t> mDisplayHz{0};
+    Device mDevices[PoseSource_Count];
+
+    // Since the last report
+    std::mutex mStatsMutex;
+    int64_t mWindowBeginNs = 0;
+    uint32_t mSamples[PoseSource_Count] = {};
+    uint32_t mBursts[PoseSource_Count] = {};
+    int64_t mCostNs = 0;
+};
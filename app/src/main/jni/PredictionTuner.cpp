@@ -0,0 +1,145 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "PredictionTuner.h"
+
+static int64_t NowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+PredictionTuner::Entry* PredictionTuner::find(const std::string& server) {
+    for (uint32_t i = 0; i < mEntryCount; i++) {
+        if (mEntries[i].server == server) return &mEntries[i];
+    }
+    return nullptr;
+}
+
+void PredictionTuner::load() {
+    mLoaded = true;
+    mEntryCount = 0;
+    FILE* file = fopen(PREDICTION_HISTORY_PATH, "r");
+    if (file == nullptr) {
+        return;
+    }
+    char server[128];
+    float offsetMs;
+    uint32_t sessions;
+    while (mEntryCount < MAX_SERVERS && fscanf(file, "%127s %f %u", server, &offsetMs, &sessions) == 3) {
+        if (offsetMs < MIN_MS || offsetMs > MAX_MS) continue;
+        Entry& entry = mEntries[mEntryCount++];
+        entry.server = server;
+        entry.offsetMs = offsetMs;
+        entry.sessions = sessions;
+    }
+    fclose(file);
+}
+
+void PredictionTuner::save() {
+    FILE* file = fopen(PREDICTION_HISTORY_PATH, "w");
+    if (file == nullptr) {
+        LOGW("[Prediction] Can't write %s", PREDICTION_HISTORY_PATH);
+        return;
+    }
+    for (uint32_t i = 0; i < mEntryCount; i++) {
+        fprintf(file, "%s %.1f %u\n", mEntries[i].server.c_str(), mEntries[i].offsetMs, mEntries[i].sessions);
+    }
+    fclose(file);
+}
+
+uint32_t PredictionTuner::offsetMsFor(const std::string& server, uint32_t fallbackMs) {
+    if (!mLoaded) load();
+    const Entry* entry = find(server);
+    if (entry == nullptr || entry->sessions == 0) {
+        LOGI("[Prediction] No history for %s, predOffset %u ms", server.c_str(), fallbackMs);
+        return fallbackMs;
+    }
+    uint32_t offsetMs = (uint32_t)lroundf(entry->offsetMs);
+    LOGI("[Prediction] %s: predOffset %u ms, learned over %u sessions", server.c_str(), offsetMs, entry->sessions);
+    return offsetMs;
+}
+
+void PredictionTuner::beginSession(const std::string& server, uint32_t appliedMs) {
+    mInSession = true;
+    mServer = server;
+    mAppliedMs = appliedMs;
+    mSession = LatencyHistogram();
+    mRoundTripSumMs = 0.0;
+    mLatchUs = 0;
+    mLatchToSubmitSumMs = 0.0;
+    mLatchToSubmitCount = 0;
+}
+
+void PredictionTuner::onLatched() {
+    mLatchUs = NowUs();
+}
+
+void PredictionTuner::onSubmitted() {
+    if (mLatchUs == 0) {
+        return;
+    }
+    mLatchToSubmitSumMs += (NowUs() - mLatchUs) / 1000.0;
+    mLatchToSubmitCount++;
+    mLatchUs = 0;
+}
+
+void PredictionTuner::addSample(float roundTripMs, float jitterMs, float displayHz) {
+    if (!mInSession || mLatchToSubmitCount == 0 || displayHz <= 0.0f) {
+        return;
+    }
+    float clientMs = (float)(mLatchToSubmitSumMs / mLatchToSubmitCount);
+    mSession.add(roundTripMs + jitterMs + clientMs + 1000.0f / displayHz);
+    mRoundTripSumMs += roundTripMs;
+    mLatchToSubmitSumMs = 0.0;
+    mLatchToSubmitCount = 0;
+}
+
+void PredictionTuner::endSession() {
+    if (!mInSession) {
+        return;
+    }
+    mInSession = false;
+    if (mSession.count < MIN_SAMPLES) {
+        LOGI("[Prediction] %s: %u s of samples, too short to learn from", mServer.c_str(), mSession.count);
+        return;
+    }
+    if (!mLoaded) load();
+
+    Entry* entry = find(mServer);
+    if (entry == nullptr) {
+        if (mEntryCount == MAX_SERVERS) {
+            // Forget the server seen in the fewest sessions
+            uint32_t fewest = 0;
+            for (uint32_t i = 1; i < mEntryCount; i++) {
+                if (mEntries[i].sessions < mEntries[fewest].sessions) fewest = i;
+            }
+            mEntries[fewest] = mEntries[--mEntryCount];
+        }
+        entry = &mEntries[mEntryCount++];
+        entry->server = mServer;
+        entry->offsetMs = (float)mAppliedMs;
+        entry->sessions = 0;
+    }
+
+    // A running average over the first sessions, then an exponential one that keeps following the network
+    float measuredMs = mSession.percentile(0.5f);
+    float weight = 1.0f / (entry->sessions + 1);
+    if (weight < 0.25f) weight = 0.25f;
+    float step = (measuredMs - entry->offsetMs) * weight;
+    if (step > MAX_STEP_MS) step = MAX_STEP_MS;
+    if (step < -(float)MAX_STEP_MS) step = -(float)MAX_STEP_MS;
+    float before = entry->offsetMs;
+    entry->offsetMs = fminf(fmaxf(entry->offsetMs + step, (float)MIN_MS), (float)MAX_MS);
+    entry->sessions++;
+
+    LOGI("[Prediction] %s: pose-to-display p50 %.0f p95 %.0f ms over %u s (round trip avg %.1f ms), "
+         "predOffset %.1f -> %.1f ms after %u sessions",
+         mServer.c_str(), measuredMs, mSession.percentile(0.95f), mSession.count,
+         mRoundTripSumMs / mSession.count, before, entry->offsetMs, entry->sessions);
+    save();
+}
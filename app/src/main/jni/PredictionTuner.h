@@ -0,0 +1,65 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <string>
+
+#include "PoseLatencyTracker.h"
+
+#define PREDICTION_HISTORY_PATH "/sdcard/CloudXRPrediction.txt"
+
+/*
+ * Learns cxrDeviceDesc::predOffset per server across sessions. While streaming,
+ * the effective pose-to-display latency is estimated once per second as round
+ * trip + jitter + latch to submit + one display refresh. When the receiver goes
+ * down the session median is blended into the server's stored offset, which the
+ * next receiver created for that server starts from. One session moves the
+ * offset by MAX_STEP_MS at most, sessions shorter than MIN_SAMPLES seconds are
+ * ignored. Stored as "server offsetMs sessions" lines in PREDICTION_HISTORY_PATH.
+ * Main loop only.
+ * */
+class PredictionTuner
+{
+public:
+    static const uint32_t MIN_MS = 0;
+    static const uint32_t MAX_MS = 60;
+    static const uint32_t MAX_STEP_MS = 10;
+    static const uint32_t MIN_SAMPLES = 30;
+    static const uint32_t MAX_SERVERS = 16;
+
+    // Learned offset of a server, fallbackMs while it has no history. Reads the file on first use
+    uint32_t offsetMsFor(const std::string& server, uint32_t fallbackMs);
+
+    void beginSession(const std::string& server, uint32_t appliedMs);
+    void onLatched();
+    void onSubmitted();
+    // Once per second with the connection stats
+    void addSample(float roundTripMs, float jitterMs, float displayHz);
+    // Blends the session into the server's offset and writes the file
+    void endSession();
+
+private:
+    struct Entry {
+        std::string server;
+        float offsetMs = 0.0f;
+        uint32_t sessions = 0;
+    };
+
+    Entry* find(const std::string& server);
+    void load();
+    void save();
+
+    Entry mEntries[MAX_SERVERS];
+    uint32_t mEntryCount = 0;
+    bool mLoaded = false;
+
+    bool mInSession = false;
+    std::string mServer;
+    uint32_t mAppliedMs = 0;
+    LatencyHistogram mSession;
+    double mRoundTripSumMs = 0.0;
+
+    int64_t mLatchUs = 0;
+    double mLatchToSubmitSumMs = 0.0;   // since the last sample
+    uint32_t mLatchToSubmitCount = 0;
+};
@@ -0,0 +1,159 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+
+#include "RefreshRateNegotiator.h"
+
+// Short of the current rate below this share of it, sustaining a rate above this one
+static const float kShortRatio = 0.95f;
+static const float kSustainRatio = 0.98f;
+// Display rate taken when neither WVR nor the display modes report one
+static const float kFallbackHz = 90.0f;
+
+void RefreshRateNegotiator::init(const float* rates, uint32_t count, float currentHz) {
+    mRateCount = 0;
+    for (uint32_t i = 0; i < count && mRateCount < DisplayRefresh::MAX_RATES; i++) {
+        if (rates[i] > 0.0f) mRates[mRateCount++] = rates[i];
+    }
+    if (currentHz <= 0.0f) {
+        // Unknown, assume the highest mode
+        currentHz = kFallbackHz;
+        for (uint32_t i = 0; i < mRateCount; i++) {
+            if (i == 0 || mRates[i] > currentHz) currentHz = mRates[i];
+        }
+        LOGW("[Refresh] Display rate not reported, assuming %.0f Hz", currentHz);
+    }
+    bool hasCurrent = false;
+    for (uint32_t i = 0; i < mRateCount; i++) {
+        if (fabsf(mRates[i] - currentHz) < 0.5f) hasCurrent = true;
+    }
+    if (!hasCurrent) mRates[mRateCount++] = currentHz;
+
+    // Highest first, a handful of entries
+    for (uint32_t i = 1; i < mRateCount; i++) {
+        for (uint32_t j = i; j > 0 && mRates[j] > mRates[j - 1]; j--) {
+            float t = mRates[j];
+            mRates[j] = mRates[j - 1];
+            mRates[j - 1] = t;
+        }
+    }
+    for (uint32_t i = 0; i < mRateCount; i++) {
+        if (fabsf(mRates[i] - currentHz) < 0.5f) mCurrent = i;
+    }
+
+    mShortWindows = mFullWindows = 0;
+    mHoldWindows = HOLD_WINDOWS;
+    mSinceSwitch = 0;
+    mUpPending = false;
+    mProbing = false;
+    mJudderCount = 0;
+    mJudderBefore = -1.0f;
+
+    if (mRateCount > 1) {
+        LOGI("[Refresh] Display at %.0f Hz, %u rates supported from %.0f to %.0f Hz",
+             currentHz, mRateCount, mRates[mRateCount - 1], mRates[0]);
+    } else {
+        LOGI("[Refresh] Display fixed at %.0f Hz, judder is reported only", currentHz);
+    }
+}
+
+float RefreshRateNegotiator::Judder(const FrameCounters& counters) {
+    uint32_t displayed = counters.frames + counters.misses;
+    if (displayed == 0) {
+        return 0.0f;
+    }
+    uint32_t offCadence = counters.repeats + counters.misses + counters.drops;
+    return offCadence > displayed ? 1.0f : (float)offCadence / displayed;
+}
+
+float RefreshRateNegotiator::recentJudder() const {
+    uint32_t count = mJudderCount < JUDDER_WINDOWS ? mJudderCount : JUDDER_WINDOWS;
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += mJudder[i];
+    }
+    return count ? sum / count : 0.0f;
+}
+
+void RefreshRateNegotiator::switchTo(uint32_t index, const char* reason, float serverFps) {
+    float from = mRates[mCurrent];
+    mJudderBefore = recentJudder();
+    mRateBefore = from;
+    mJudderAfterSum = 0.0f;
+    LOGI("[Refresh] %s, server at %.1f fps: display and stream %.0f -> %.0f Hz, judder %.1f%% over the last %u s",
+         reason, serverFps, from, mRates[index], mJudderBefore * 100.0f,
+         mJudderCount < JUDDER_WINDOWS ? mJudderCount : JUDDER_WINDOWS);
+
+    mCurrent = index;
+    mShortWindows = mFullWindows = 0;
+    mSinceSwitch = 0;
+    mJudderCount = 0;
+}
+
+bool RefreshRateNegotiator::update(const FrameCounters& counters, float serverFps) {
+    if (serverFps <= 0.0f || counters.frames + counters.misses == 0) {
+        return false;
+    }
+
+    mServerFps = serverFps;
+    float judder = Judder(counters);
+    mJudder[mJudderCount % JUDDER_WINDOWS] = judder;
+    mJudderCount++;
+    mSinceSwitch++;
+
+    // Judder after the last switch once the display settled
+    if (mJudderBefore >= 0.0f && mSinceSwitch > SETTLE_WINDOWS) {
+        mJudderAfterSum += judder;
+        if (mSinceSwitch == SETTLE_WINDOWS + JUDDER_WINDOWS) {
+            LOGI("[Refresh] Judder at %.0f Hz %.1f%%, was %.1f%% at %.0f Hz",
+                 mRates[mCurrent], mJudderAfterSum / JUDDER_WINDOWS * 100.0f, mJudderBefore * 100.0f, mRateBefore);
+            mJudderBefore = -1.0f;
+        }
+    }
+
+    float current = mRates[mCurrent];
+    mShortWindows = serverFps < current * kShortRatio ? mShortWindows + 1 : 0;
+    mFullWindows = serverFps >= current * kSustainRatio ? mFullWindows + 1 : 0;
+
+    if (mProbing && mSinceSwitch >= HOLD_WINDOWS) {
+        // The higher rate held, the next probe waits the base time again
+        mProbing = false;
+        mHoldWindows = HOLD_WINDOWS;
+    }
+    if (mRateCount < 2 || mSinceSwitch < MIN_DWELL_WINDOWS) {
+        return false;
+    }
+
+    if (mShortWindows >= DOWN_WINDOWS && mCurrent + 1 < mRateCount) {
+        // Highest rate the server keeps up with, or the lowest there is
+        uint32_t target = mCurrent + 1;
+        while (target + 1 < mRateCount && mRates[target] * kShortRatio > serverFps) {
+            target++;
+        }
+        if (mProbing) {
+            mHoldWindows = mHoldWindows * 2 < MAX_HOLD_WINDOWS ? mHoldWindows * 2 : MAX_HOLD_WINDOWS;
+            mProbing = false;
+            LOGI("[Refresh] Probe of %.0f Hz failed, next one after %u s", current, mHoldWindows);
+        }
+        mUpPending = false;
+        switchTo(target, "Server short of the display rate", serverFps);
+        return true;
+    }
+    if (mCurrent > 0 && mFullWindows >= mHoldWindows && !mUpPending) {
+        LOGI("[Refresh] Server sustained %.0f Hz for %u s, the next connection asks for %.0f Hz",
+             current, mFullWindows, mRates[mCurrent - 1]);
+        mUpPending = true;
+    }
+    return false;
+}
+
+bool RefreshRateNegotiator::beginSession() {
+    if (!mUpPending) {
+        return false;
+    }
+    mUpPending = false;
+    switchTo(mCurrent - 1, "Probing a higher rate", mServerFps);
+    mProbing = true;
+    return true;
+}
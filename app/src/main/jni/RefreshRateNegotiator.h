@@ -0,0 +1,70 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+
+#include "DisplayRefresh.h"
+#include "FrameTracker.h"
+
+/*
+ * Keeps the display on the supported refresh rate the server actually sustains,
+ * so stream frames aren't held for an uneven number of vsyncs. The requested
+ * stream rate follows the display, CloudXR takes it when the receiver is created.
+ * Stepping down takes DOWN_WINDOWS short windows in a row. The server never
+ * streams above the rate it was asked for, so after mHoldWindows at full rate
+ * the next receiver asks for the next higher rate and the display follows it
+ * there, a probe. A probe taken back doubles the hold. No switch within
+ * MIN_DWELL_WINDOWS of the last one.
+ * Judder is the share of display frames off the expected cadence: repeated or
+ * missed latches, and frames the server sequence skipped.
+ * Main loop only, one update per FrameTracker window (about a second).
+ * */
+class RefreshRateNegotiator
+{
+public:
+    static const uint32_t DOWN_WINDOWS = 5;
+    static const uint32_t MIN_DWELL_WINDOWS = 10;
+    static const uint32_t HOLD_WINDOWS = 30;
+    static const uint32_t MAX_HOLD_WINDOWS = 480;
+    static const uint32_t SETTLE_WINDOWS = 2;       // skipped before judder after a switch is measured
+    static const uint32_t JUDDER_WINDOWS = 5;       // averaged for the before and after report
+
+    // Rates the display supports, currentHz is the one it runs at and is always a candidate
+    void init(const float* rates, uint32_t count, float currentHz);
+    bool initialized() const { return mRateCount > 0; }
+
+    // serverFps from the connection stats, 0 while not streaming.
+    // Returns true when the display should switch to displayHz()
+    bool update(const FrameCounters& counters, float serverFps);
+
+    // A receiver is about to be created with streamFps(). Returns true when a
+    // step up was waiting for it and the display should switch to displayHz()
+    bool beginSession();
+
+    float displayHz() const { return mRates[mCurrent]; }
+    float streamFps() const { return mUpPending ? mRates[mCurrent - 1] : mRates[mCurrent]; }
+
+    static float Judder(const FrameCounters& counters);
+
+private:
+    void switchTo(uint32_t index, const char* reason, float serverFps);
+    float recentJudder() const;
+
+    float mRates[DisplayRefresh::MAX_RATES + 1] = {};   // highest first
+    uint32_t mRateCount = 0;
+    uint32_t mCurrent = 0;
+
+    uint32_t mShortWindows = 0;         // server below the current rate
+    uint32_t mFullWindows = 0;          // server at the current rate
+    uint32_t mHoldWindows = HOLD_WINDOWS;
+    uint32_t mSinceSwitch = 0;
+    bool mUpPending = false;            // the next receiver asks for the higher rate
+    bool mProbing = false;
+    float mServerFps = 0.0f;
+
+    float mJudder[JUDDER_WINDOWS] = {};
+    uint32_t mJudderCount = 0;
+    float mJudderBefore = -1.0f;        // >= 0 while the after report is pending
+    float mRateBefore = 0.0f;
+    float mJudderAfterSum = 0.0f;
+};
@@ -0,0 +1,206 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <thread>
+
+#include "ServerProbe.h"
+#include "ThreadManager.h"
+
+ServerProbe::~ServerProbe() {
+    join();
+}
+
+std::vector<std::string> ServerProbe::SplitServerList(const std::string& list) {
+    std::vector<std::string> out;
+    size_t begin = 0;
+    while (begin <= list.size()) {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+
+        std::string item = list.substr(begin, end - begin);
+        size_t first = item.find_first_not_of(" \t");
+        size_t last = item.find_last_not_of(" \t");
+        if (first != std::string::npos) {
+            out.push_back(item.substr(first, last - first + 1));
+        }
+        begin = end + 1;
+    }
+    return out;
+}
+
+void ServerProbe::setCandidates(const std::vector<std::string>& addresses) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    std::vector<ServerProbeResult> results;
+    for (const std::string& address : addresses) {
+        ServerProbeResult result;
+        result.address = address;
+        for (const ServerProbeResult& cached : mResults) {
+            if (cached.address == address) {
+                result = cached;
+                break;
+            }
+        }
+        results.push_back(result);
+    }
+    mResults = results;
+}
+
+size_t ServerProbe::candidateCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mResults.size();
+}
+
+// Non-blocking connect, the handshake time is one network round trip
+bool ServerProbe::ProbeOnce(const std::string& address, uint16_t port, uint32_t timeoutMs, float& rttMs) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* info = nullptr;
+    char portStr[8];
+    snprintf(portStr, sizeof(portStr), "%u", port);
+    if (getaddrinfo(address.c_str(), portStr, &hints, &info) != 0 || info == nullptr) {
+        return false;
+    }
+
+    bool ok = false;
+    int fd = socket(info->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        auto start = std::chrono::steady_clock::now();
+        int ret = connect(fd, info->ai_addr, info->ai_addrlen);
+        if (ret == 0) {
+            ok = true;
+        } else if (errno == EINPROGRESS) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, timeoutMs) == 1) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                ok = (err == 0);
+            }
+        }
+        rttMs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count() / 1000.0f;
+        close(fd);
+    }
+
+    freeaddrinfo(info);
+    return ok;
+}
+
+void ServerProbe::probe(uint32_t timeoutMs, uint32_t attempts) {
+    std::vector<std::string> addresses;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const ServerProbeResult& result : mResults) {
+            addresses.push_back(result.address);
+        }
+    }
+
+    std::vector<ServerProbeResult> probed(addresses.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        threads.push_back(std::thread([&, i]() {
+            ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-probe");
+            ServerProbeResult& result = probed[i];
+            for (uint32_t n = 0; n < attempts; n++) {
+                float rtt = 0.0f;
+                if (!ProbeOnce(addresses[i], mPort, timeoutMs, rtt)) {
+                    continue;
+                }
+                if (!result.reachable || rtt < result.rttMs) {
+                    result.rttMs = rtt;
+                }
+                result.reachable = true;
+            }
+            ThreadManager::Instance().unregisterCurrent();
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < addresses.size(); i++) {
+        for (ServerProbeResult& result : mResults) {
+            if (result.address != addresses[i]) continue;
+            result.reachable = probed[i].reachable;
+            result.rttMs = probed[i].rttMs;
+            LOGI("[ServerProbe] %s: %s, RTT %.2f ms, %u failed connections",
+                 result.address.c_str(), result.reachable ? "reachable" : "unreachable",
+                 result.rttMs, result.connectFailures);
+        }
+    }
+}
+
+void ServerProbe::startProbe(uint32_t timeoutMs, uint32_t attempts) {
+    if (mProbing) {
+        return;
+    }
+    join();
+
+    mProbing = true;
+    mThread = new std::thread([this, timeoutMs, attempts]() {
+        ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-reprobe");
+        probe(timeoutMs, attempts);
+        ThreadManager::Instance().unregisterCurrent();
+        mProbing = false;
+    });
+}
+
+void ServerProbe::join() {
+    if (mThread) {
+        mThread->join();
+        delete mThread;
+        mThread = nullptr;
+    }
+}
+
+std::string ServerProbe::best() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mResults.empty()) {
+        return std::string();
+    }
+
+    const ServerProbeResult* best = &mResults[0];
+    for (const ServerProbeResult& result : mResults) {
+        if (result.reachable != best->reachable) {
+            if (result.reachable) best = &result;
+            continue;
+        }
+        if (result.connectFailures != best->connectFailures) {
+            if (result.connectFailures < best->connectFailures) best = &result;
+            continue;
+        }
+        if (result.reachable && result.rttMs < best->rttMs) {
+            best = &result;
+        }
+    }
+    return best->address;
+}
+
+std::string ServerProbe::pick() {
+    std::string address = best();
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPicked = address;
+    return address;
+}
+
+void ServerProbe::reportConnectFailure() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (ServerProbeResult& result : mResults) {
+        if (result.address == mPicked) {
+            result.connectFailures++;
+            LOGW("[ServerProbe] %s: connection failed, %u so far", result.address.c_str(), result.connectFailures);
+        }
+    }
+}
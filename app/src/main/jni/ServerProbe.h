@@ -0,0 +1,67 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CloudXR server RTSP port, the first thing a client connects to
+#define CLOUDXR_SERVER_PROBE_PORT 48010
+
+struct ServerProbeResult
+{
+    std::string address;
+    bool reachable = false;
+    float rttMs = 0.0f;             // best TCP connect time of the last probe
+    uint32_t connectFailures = 0;   // failed CloudXR connections this session
+};
+
+/*
+ * Picks the server to connect to from a list of candidates.
+ * Each candidate is probed concurrently with a few TCP connects to the CloudXR
+ * port, results are kept for the whole session together with the number of
+ * failed connections to it.
+ * */
+class ServerProbe
+{
+public:
+    explicit ServerProbe(uint16_t port = CLOUDXR_SERVER_PROBE_PORT) : mPort(port) {}
+    ~ServerProbe();
+
+    // "-s 10.0.0.2,10.0.0.3" in the launch options
+    static std::vector<std::string> SplitServerList(const std::string& list);
+
+    // Keeps cached results of candidates already known
+    void setCandidates(const std::vector<std::string>& addresses);
+    size_t candidateCount() const;
+
+    // Blocks until all candidates answered or timed out
+    void probe(uint32_t timeoutMs = 300, uint32_t attempts = 3);
+    // Same on a worker thread, for callers that can't wait. probing() turns false
+    // when the results are in, a call while one is running does nothing
+    void startProbe(uint32_t timeoutMs = 300, uint32_t attempts = 3);
+    bool probing() const { return mProbing; }
+
+    // Reachable candidate with the fewest failures then the lowest RTT
+    std::string best() const;
+    // best(), remembered as the candidate being connected to
+    std::string pick();
+
+    // Counts against the last pick(), safe from the CloudXR callback thread
+    void reportConnectFailure();
+
+private:
+    static bool ProbeOnce(const std::string& address, uint16_t port, uint32_t timeoutMs, float& rttMs);
+    void join();
+
+    const uint16_t mPort;
+    mutable std::mutex mMutex;
+    std::vector<ServerProbeResult> mResults;
+    std::string mPicked;
+
+    std::atomic<bool> mProbing{false};
+    std::thread* mThread = nullptr;
+};
@@ -0,0 +1,150 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+
+#include "StallWatchdog.h"
+#include "ThreadManager.h"
+
+StallWatchdog::~StallWatchdog() {
+    stop();
+}
+
+int64_t StallWatchdog::NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+const char* StallWatchdog::ThreadToString(WatchedThread thread) {
+    switch (thread) {
+        case Watched_Main: return "main";
+        case Watched_Pose: return "pose";
+        case Watched_Mic: return "mic";
+        case Watched_Speaker: return "speaker";
+        default: return "?";
+    }
+}
+
+void StallWatchdog::start() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mThread) {
+        return;
+    }
+    mExit = false;
+    mThread = new std::thread(&StallWatchdog::watchLoop, this);
+}
+
+void StallWatchdog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mThread) {
+            return;
+        }
+        mExit = true;
+    }
+    mCond.notify_all();
+    if (mThread->joinable()) {
+        mThread->join();
+    }
+    delete mThread;
+    mThread = nullptr;
+}
+
+void StallWatchdog::beat(WatchedThread thread) {
+    mThreads[thread].beatNs.store(NowNs(), std::memory_order_relaxed);
+}
+
+void StallWatchdog::park(WatchedThread thread) {
+    mThreads[thread].beatNs.store(0, std::memory_order_relaxed);
+}
+
+void StallWatchdog::setMetrics(const StallMetrics& metrics) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    mMetrics = metrics;
+}
+
+const char* StallWatchdog::phase(WatchedThread thread, int64_t& sinceNs) const {
+    sinceNs = mThreads[thread].phaseNs.load(std::memory_order_relaxed);
+    return mThreads[thread].phase.load(std::memory_order_relaxed);
+}
+
+void StallWatchdog::setPhase(WatchedThread thread, const char* phase, int64_t sinceNs) {
+    mThreads[thread].phaseNs.store(sinceNs, std::memory_order_relaxed);
+    mThreads[thread].phase.store(phase, std::memory_order_relaxed);
+}
+
+void StallWatchdog::watchLoop() {
+    ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-watchdog");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mExit) {
+        uint32_t budgetMs = mBudgetMs.load(std::memory_order_relaxed);
+        // A stall is seen within a quarter of the budget past it
+        uint32_t periodMs = budgetMs ? std::max(budgetMs / 4, 10u) : 500;
+        mCond.wait_for(lock, std::chrono::milliseconds(periodMs), [this]() { return mExit; });
+        if (mExit) {
+            break;
+        }
+        lock.unlock();
+        check(NowNs(), budgetMs * 1000000LL);
+        lock.lock();
+    }
+    lock.unlock();
+
+    ThreadManager::Instance().unregisterCurrent();
+}
+
+void StallWatchdog::check(int64_t now, int64_t budgetNs) {
+    for (int i = 0; i < Watched_Count; i++) {
+        Watched& w = mThreads[i];
+        int64_t beatNs = w.beatNs.load(std::memory_order_relaxed);
+
+        if (w.stallBeatNs != 0 && beatNs != w.stallBeatNs) {
+            // Beat again or parked, either way the stall is over
+            int64_t endNs = beatNs != 0 ? beatNs : now;
+            LOGW("[Stall] %s %s after %.0f ms in %s", ThreadToString((WatchedThread)i),
+                 beatNs != 0 ? "recovered" : "parked", (endNs - w.stallBeatNs) / 1e6,
+                 w.stallPhase ? w.stallPhase : "(no phase)");
+            w.stallBeatNs = 0;
+            w.stallPhase = nullptr;
+        }
+
+        if (budgetNs > 0 && beatNs != 0 && w.stallBeatNs == 0 && now - beatNs > budgetNs) {
+            w.stallBeatNs = beatNs;
+            w.stallPhase = w.phase.load(std::memory_order_relaxed);
+            logStall((WatchedThread)i, now);
+        }
+    }
+}
+
+void StallWatchdog::logStall(WatchedThread thread, int64_t now) {
+    mStalls++;
+    const Watched& stalled = mThreads[thread];
+    LOGE("[Stall] #%u %s thread has not beaten for %.0f ms (budget %u ms)", mStalls, ThreadToString(thread),
+         (now - stalled.stallBeatNs) / 1e6, mBudgetMs.load(std::memory_order_relaxed));
+
+    // Where everyone was at that moment, a stuck thread is often waiting on another one
+    for (int i = 0; i < Watched_Count; i++) {
+        const Watched& w = mThreads[i];
+        int64_t beatNs = w.beatNs.load(std::memory_order_relaxed);
+        const char* phase = w.phase.load(std::memory_order_relaxed);
+        int64_t phaseNs = w.phaseNs.load(std::memory_order_relaxed);
+        if (beatNs == 0) {
+            LOGE("[Stall]   %s: parked", ThreadToString((WatchedThread)i));
+            continue;
+        }
+        LOGE("[Stall]   %s: in %s for %.0f ms, last beat %.0f ms ago", ThreadToString((WatchedThread)i),
+             phase ? phase : "(no phase)", phase && phaseNs ? (now - phaseNs) / 1e6 : 0.0, (now - beatNs) / 1e6);
+    }
+
+    StallMetrics metrics;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        metrics = mMetrics;
+    }
+    LOGE("[Stall]   state %s, %.1f fps, RTT %u ms, %u kbps, %u consecutive latch misses",
+         metrics.clientState, metrics.fps, metrics.roundTripMs, metrics.bitrateKbps, metrics.consecutiveMisses);
+}
@@ -0,0 +1,105 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum WatchedThread
+{
+    Watched_Main = 0,
+    Watched_Pose,
+    Watched_Mic,        // Oboe recording callback
+    Watched_Speaker,    // CloudXR RenderAudio callback
+    Watched_Count
+};
+
+// Latest values the main loop publishes for stall reports
+struct StallMetrics
+{
+    float fps = 0.0f;
+    uint32_t roundTripMs = 0;
+    uint32_t bitrateKbps = 0;
+    uint32_t consecutiveMisses = 0;
+    const char* clientState = "";   // string literal
+};
+
+/*
+ * Watches heartbeats of the main loop, pose thread and audio callbacks from its
+ * own thread. A thread is armed by its first beat() and parked when it has nothing
+ * to do, only armed threads are checked. When one goes a budget without a beat the
+ * watchdog logs the phase every thread is in, how long it has been there and the
+ * recent metrics, then the stall duration once the thread beats again.
+ * Phases are string literals set by StallPhase, a clock read and two atomic stores.
+ * */
+class StallWatchdog
+{
+public:
+    ~StallWatchdog();
+
+    void start();
+    void stop();
+
+    // 0 turns checking off
+    void setBudgetMs(uint32_t budgetMs) { mBudgetMs.store(budgetMs, std::memory_order_relaxed); }
+
+    void beat(WatchedThread thread);
+    void park(WatchedThread thread);
+    void setMetrics(const StallMetrics& metrics);
+
+    // Owner thread, see StallPhase
+    const char* phase(WatchedThread thread, int64_t& sinceNs) const;
+    void setPhase(WatchedThread thread, const char* phase, int64_t sinceNs);
+
+    static int64_t NowNs();
+    static const char* ThreadToString(WatchedThread thread);
+
+private:
+    struct Watched {
+        std::atomic<int64_t> beatNs;            // 0 = parked
+        std::atomic<const char*> phase;
+        std::atomic<int64_t> phaseNs;
+        // Watchdog thread only
+        int64_t stallBeatNs = 0;                // beat the current stall started after, 0 = none
+        const char* stallPhase = nullptr;
+        Watched() : beatNs(0), phase(nullptr), phaseNs(0) {}
+    };
+
+    void watchLoop();
+    void check(int64_t now, int64_t budgetNs);
+    void logStall(WatchedThread thread, int64_t now);
+
+    Watched mThreads[Watched_Count];
+    std::atomic<uint32_t> mBudgetMs{250};
+
+    std::mutex mMetricsMutex;
+    StallMetrics mMetrics;
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::thread* mThread = nullptr;
+    bool mExit = false;
+    uint32_t mStalls = 0;
+};
+
+// Marks what a watched thread is doing until the end of the scope, then restores the outer phase
+class StallPhase
+{
+public:
+    StallPhase(StallWatchdog& watchdog, WatchedThread thread, const char* phase)
+            : mWatchdog(watchdog), mThread(thread) {
+        mOuter = watchdog.phase(thread, mOuterSinceNs);
+        watchdog.setPhase(thread, phase, StallWatchdog::NowNs());
+    }
+    ~StallPhase() { mWatchdog.setPhase(mThread, mOuter, mOuterSinceNs); }
+    StallPhase(const StallPhase&) = delete;
+    StallPhase& operator=(const StallPhase&) = delete;
+
+private:
+    StallWatchdog& mWatchdog;
+    WatchedThread mThread;
+    const char* mOuter;
+    int64_t mOuterSinceNs = 0;
+};
@@ -0,0 +1,135 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <thread>
+
+#include "StartupOrchestrator.h"
+#include "ThreadManager.h"
+
+static const char* StateToString(int state)
+{
+    static const char* names[] = { "pending", "running", "done", "FAILED", "skipped" };
+    return names[state];
+}
+
+StartupOrchestrator::StartupOrchestrator()
+        : mStart(std::chrono::steady_clock::now())
+        {}
+
+StartupOrchestrator::StepId StartupOrchestrator::addStep(const char* name, std::function<bool()> fn,
+                                                         bool mainThread, std::initializer_list<StepId> deps) {
+    Step step;
+    step.name = name;
+    step.fn = fn;
+    step.mainThread = mainThread;
+    step.deps = deps;
+    step.state = Pending;
+    step.beginUs = 0;
+    step.endUs = 0;
+    mSteps.push_back(step);
+    return (StepId)mSteps.size() - 1;
+}
+
+int64_t StartupOrchestrator::elapsedUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - mStart).count();
+}
+
+void StartupOrchestrator::execute(Step& step) {
+    step.beginUs = elapsedUs();
+    bool ok = step.fn();
+    int64_t end = elapsedUs();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    step.endUs = end;
+    step.state = ok ? Done : Failed;
+    mCond.notify_all();
+}
+
+bool StartupOrchestrator::run() {
+    std::vector<std::thread> workers;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true) {
+        bool finished = true;
+        bool changed = false;
+        Step* mainStep = nullptr;
+
+        for (size_t i = 0; i < mSteps.size(); i++) {
+            Step& step = mSteps[i];
+            if (step.state == Running) finished = false;
+            if (step.state != Pending) continue;
+            finished = false;
+
+            bool ready = true;
+            bool blocked = false;
+            for (StepId dep : step.deps) {
+                State depState = mSteps[dep].state;
+                if (depState == Failed || depState == Skipped) blocked = true;
+                if (depState != Done) ready = false;
+            }
+
+            if (blocked) {
+                step.state = Skipped;
+                changed = true;
+            } else if (ready) {
+                if (step.mainThread) {
+                    if (mainStep == nullptr) mainStep = &step;
+                } else {
+                    step.state = Running;
+                    workers.push_back(std::thread([this, &step]() {
+                        std::string name = "cxr-" + step.name;
+                        ThreadManager::Instance().registerCurrent(ThreadRole_Worker, name.substr(0, 15).c_str());
+                        execute(step);
+                        ThreadManager::Instance().unregisterCurrent();
+                    }));
+                }
+            }
+        }
+
+        if (finished) break;
+
+        if (mainStep != nullptr) {
+            // Worker steps are already spawned, overlap them with this one
+            mainStep->state = Running;
+            lock.unlock();
+            execute(*mainStep);
+            lock.lock();
+        } else if (!changed) {
+            // Re-scan right away when a step got skipped, its dependents may be skipped too
+            mCond.wait(lock);
+        }
+    }
+    lock.unlock();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    bool ret = true;
+    for (const Step& step : mSteps) {
+        if (step.state != Done) ret = false;
+    }
+    return ret;
+}
+
+void StartupOrchestrator::logTimeline() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    int64_t total = 0;
+    for (const Step& step : mSteps) {
+        if (step.endUs > total) total = step.endUs;
+    }
+
+    LOGI("Startup timeline, %zu steps, %.1f ms total", mSteps.size(), total / 1000.0f);
+    for (const Step& step : mSteps) {
+        if (step.state == Skipped) {
+            LOGI("  %-18s %-6s skipped", step.name.c_str(), step.mainThread ? "main" : "worker");
+            continue;
+        }
+        LOGI("  %-18s %-6s %7.1f -> %7.1f ms (%6.1f ms) %s",
+             step.name.c_str(), step.mainThread ? "main" : "worker",
+             step.beginUs / 1000.0f, step.endUs / 1000.0f,
+             (step.endUs - step.beginUs) / 1000.0f, StateToString(step.state));
+    }
+}
@@ -0,0 +1,55 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Runs init steps as a small dependency graph.
+ * Worker steps are spawned on their own thread as soon as their dependencies
+ * are done, main thread steps (anything touching the EGL context) run on the
+ * calling thread. A failed step skips everything that depends on it.
+ * */
+class StartupOrchestrator
+{
+public:
+    typedef int StepId;
+
+    StartupOrchestrator();
+
+    StepId addStep(const char* name, std::function<bool()> fn, bool mainThread,
+                   std::initializer_list<StepId> deps = {});
+
+    // Returns false if any step failed or was skipped
+    bool run();
+
+    // Micro seconds since the orchestrator was created
+    int64_t elapsedUs() const;
+
+    void logTimeline() const;
+
+private:
+    enum State { Pending, Running, Done, Failed, Skipped };
+
+    struct Step {
+        std::string name;
+        std::function<bool()> fn;
+        bool mainThread;
+        std::vector<StepId> deps;
+        State state;
+        int64_t beginUs;
+        int64_t endUs;
+    };
+
+    void execute(Step& step);
+
+    std::chrono::steady_clock::time_point mStart;
+    std::vector<Step> mSteps;
+    mutable std::mutex mMutex;
+    std::condition_variable mCond;
+};
@@ -0,0 +1,253 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <chrono>
+
+#include "StatsServer.h"
+#include "ThreadManager.h"
+
+static const char* kStatsHeader =
+        "# t_ms fps kbps avail_kbps rtt_ms jitter_us rx lost dropped quality"
+        " render_fps frames drops repeats late misses concealed\n";
+
+StatsServer::~StatsServer() {
+    stop();
+}
+
+bool StatsServer::start(const char* socketName) {
+    if (mThread) {
+        return true;
+    }
+
+    mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mListenFd < 0) {
+        LOGE("[Stats] socket failed: %s", strerror(errno));
+        return false;
+    }
+
+    // Abstract namespace, leading 0 and no file to clean up
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    size_t nameLen = strnlen(socketName, sizeof(addr.sun_path) - 2);
+    memcpy(addr.sun_path + 1, socketName, nameLen);
+    socklen_t addrLen = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + nameLen);
+
+    if (bind(mListenFd, (struct sockaddr*)&addr, addrLen) != 0 || listen(mListenFd, MAX_CLIENTS) != 0) {
+        LOGE("[Stats] Can't listen on @%s: %s", socketName, strerror(errno));
+        close(mListenFd);
+        mListenFd = -1;
+        return false;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) mClients[i] = Client();
+    mHistoryCount = 0;
+    mHead = 0;
+    mExit = false;
+    mThread = new std::thread(&StatsServer::serveLoop, this);
+    LOGI("[Stats] Serving on @%s at %u Hz", socketName, SAMPLE_HZ);
+    return true;
+}
+
+void StatsServer::stop() {
+    if (!mThread) {
+        return;
+    }
+    mExit = true;
+    if (mThread->joinable()) {
+        mThread->join();
+    }
+    delete mThread;
+    mThread = nullptr;
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (mClients[i].fd >= 0) close(mClients[i].fd);
+        mClients[i] = Client();
+    }
+    close(mListenFd);
+    mListenFd = -1;
+}
+
+void StatsServer::setReceiver(cxrReceiverHandle receiver) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mReceiver = receiver;
+}
+
+void StatsServer::setClientMetrics(const ClientMetrics& metrics) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClient = metrics;
+}
+
+void StatsServer::addEvent(const char* text) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t room = sizeof(mEvents) - mEventsSize;
+    int n = snprintf(mEvents + mEventsSize, room, "# %s\n", text);
+    if (n > 0 && (size_t)n < room) {
+        mEventsSize += n;
+    } else {
+        mEvents[mEventsSize] = 0;
+    }
+}
+
+int StatsServer::FormatSample(const StatsSample& s, char* out, size_t size) {
+    const cxrConnectionStats& c = s.stats;
+    const FrameCounters& f = s.client.frames;
+    int events = snprintf(out, size, "%s", s.events);
+    out += events;
+    size -= events;
+    int n = snprintf(out, size, "%u %.1f %u %u %u %u %u %u %u %d %.1f %u %u %u %u %u %u\n",
+                     s.timeMs, c.framesPerSecond, c.bandwidthUtilizationKbps, c.bandwidthAvailableKbps,
+                     c.roundTripDelayMs, c.jitterUs, c.totalPacketsReceived, c.totalPacketsLost,
+                     c.totalPacketsDropped, (int)c.quality, s.client.renderFps,
+                     f.frames, f.drops, f.repeats, f.late, f.misses, f.concealed);
+    return events + (n < (int)size ? n : (int)size - 1);
+}
+
+void StatsServer::sample(uint32_t timeMs) {
+    StatsSample s = {};
+    s.timeMs = timeMs;
+    {
+        // Held across the call so the receiver can't be destroyed under it
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mReceiver || cxrGetConnectionStats(mReceiver, &s.stats) != cxrError_Success) {
+            return;
+        }
+        s.client = mClient;
+        memcpy(s.events, mEvents, mEventsSize + 1);
+        mEventsSize = 0;
+        mEvents[0] = 0;
+    }
+
+    mHistory[mHead] = s;
+    mHead = (mHead + 1) % HISTORY_SIZE;
+    if (mHistoryCount < HISTORY_SIZE) mHistoryCount++;
+
+    // A client a whole history behind skips the sample just overwritten
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Client& client = mClients[i];
+        if (client.fd < 0) continue;
+        if (client.backlog < mHistoryCount) client.backlog++;
+        if (++client.stalled > STALL_SAMPLES) {
+            closeClient(client, "not reading");
+        } else if (!flushClient(client)) {
+            closeClient(client, "disconnected");
+        }
+    }
+}
+
+// As much as the socket takes without blocking. False when the client is gone
+bool StatsServer::flushClient(Client& client) {
+    while (true) {
+        if (client.lineSent < client.lineSize) {
+            ssize_t n = send(client.fd, client.line + client.lineSent, client.lineSize - client.lineSent,
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            client.lineSent += (uint32_t)n;
+            client.stalled = 0;
+            continue;
+        }
+        if (client.backlog == 0) {
+            return true;
+        }
+        uint32_t index = (mHead + HISTORY_SIZE - client.backlog) % HISTORY_SIZE;
+        client.lineSize = (uint32_t)FormatSample(mHistory[index], client.line, sizeof(client.line));
+        client.lineSent = 0;
+        client.backlog--;
+    }
+}
+
+void StatsServer::closeClient(Client& client, const char* reason) {
+    LOGI("[Stats] Client %s", reason);
+    close(client.fd);
+    client = Client();
+}
+
+void StatsServer::acceptClient() {
+    int fd = accept4(mListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < MAX_CLIENTS && slot < 0; i++) {
+        if (mClients[i].fd < 0) slot = i;
+    }
+    if (slot < 0) {
+        LOGW("[Stats] Too many clients, connection refused");
+        close(fd);
+        return;
+    }
+
+    // The header, then the history from the oldest sample
+    Client& client = mClients[slot];
+    client.fd = fd;
+    client.lineSize = (uint32_t)snprintf(client.line, sizeof(client.line), "%s", kStatsHeader);
+    client.backlog = mHistoryCount;
+    LOGI("[Stats] Client connected, %u samples of history queued", mHistoryCount);
+    if (!flushClient(client)) {
+        closeClient(client, "disconnected");
+    }
+}
+
+void StatsServer::serveLoop() {
+    ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-stats");
+
+    auto begin = std::chrono::steady_clock::now();
+    auto period = std::chrono::microseconds(1000000 / SAMPLE_HZ);
+    auto nextSample = begin + period;
+
+    while (!mExit) {
+        struct pollfd fds[1 + MAX_CLIENTS];
+        Client* polled[1 + MAX_CLIENTS];
+        int count = 0;
+        fds[count].fd = mListenFd;
+        fds[count++].events = POLLIN;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            Client& client = mClients[i];
+            if (client.fd < 0) continue;
+            polled[count] = &client;
+            fds[count].fd = client.fd;
+            fds[count++].events = POLLIN |
+                    (client.backlog > 0 || client.lineSent < client.lineSize ? POLLOUT : 0);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        int timeoutMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(nextSample - now).count();
+        if (timeoutMs > 0 && poll(fds, count, timeoutMs) > 0) {
+            if (fds[0].revents & POLLIN) {
+                acceptClient();
+            }
+            for (int n = 1; n < count; n++) {
+                Client& client = *polled[n];
+                if (fds[n].revents & POLLOUT && !flushClient(client)) {
+                    closeClient(client, "disconnected");
+                    continue;
+                }
+                // Clients don't send anything, readable means closed
+                if (!(fds[n].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                char buf[64];
+                if (recv(client.fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) continue;
+                closeClient(client, "disconnected");
+            }
+            continue;
+        }
+
+        now = std::chrono::steady_clock::now();
+        if (now >= nextSample) {
+            sample((uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - begin).count());
+            nextSample += period;
+            if (nextSample < now) nextSample = now + period;
+        }
+    }
+
+    ThreadManager::Instance().unregisterCurrent();
+}
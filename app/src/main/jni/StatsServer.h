@@ -0,0 +1,89 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <CloudXRClient.h>
+
+#include "FrameTracker.h"
+
+// Abstract unix socket, from the host: adb forward tcp:48130 localabstract:cloudxr_stats
+#define STATS_SOCKET_NAME "cloudxr_stats"
+
+// Client side metrics published by the render loop
+struct ClientMetrics
+{
+    float renderFps = 0.0f;
+    FrameCounters frames;       // last FrameTracker window
+};
+
+struct StatsSample
+{
+    uint32_t timeMs;            // since start()
+    cxrConnectionStats stats;
+    ClientMetrics client;
+    char events[96];            // "# " lines of events since the previous sample
+};
+
+/*
+ * Samples cxrGetConnectionStats at a fixed rate into a time series ring and
+ * serves it as text, one line per sample. A new connection gets a header
+ * line and the whole history, then every new sample as it is taken. Events,
+ * like a tuning change, are "# " lines ahead of the first sample taken after them.
+ * Sockets never block the sampler: each client keeps its place in the ring and
+ * is written as far as its socket takes, the rest waits for POLLOUT.
+ * */
+class StatsServer
+{
+public:
+    static const uint32_t SAMPLE_HZ = 10;
+    static const uint32_t HISTORY_SIZE = 600;   // one minute
+    static const int MAX_CLIENTS = 4;
+    static const uint32_t STALL_SAMPLES = 10 * SAMPLE_HZ;  // client dropped after taking nothing this long
+
+    ~StatsServer();
+
+    bool start(const char* socketName);
+    void stop();
+
+    // Receiver to sample, nullptr before it is destroyed
+    void setReceiver(cxrReceiverHandle receiver);
+    void setClientMetrics(const ClientMetrics& metrics);
+    // Any thread, dropped when the events waiting for the next sample fill it up
+    void addEvent(const char* text);
+
+private:
+    struct Client {
+        int fd = -1;
+        uint32_t backlog = 0;       // samples at the end of mHistory not sent yet
+        uint32_t stalled = 0;       // samples taken since the socket last took a byte
+        char line[384];             // being sent, the socket may take part of it
+        uint32_t lineSize = 0;
+        uint32_t lineSent = 0;
+    };
+
+    void serveLoop();
+    void sample(uint32_t timeMs);
+    void acceptClient();
+    bool flushClient(Client& client);
+    void closeClient(Client& client, const char* reason);
+    static int FormatSample(const StatsSample& s, char* out, size_t size);
+
+    std::thread* mThread = nullptr;
+    std::atomic<bool> mExit{false};
+    int mListenFd = -1;
+    Client mClients[MAX_CLIENTS];   // serve thread only
+
+    std::mutex mMutex;              // mReceiver, mClient and mEvents
+    cxrReceiverHandle mReceiver = nullptr;
+    ClientMetrics mClient;
+    char mEvents[sizeof(StatsSample::events)] = {};
+    uint32_t mEventsSize = 0;
+
+    // serve thread only
+    StatsSample mHistory[HISTORY_SIZE];
+    uint32_t mHistoryCount = 0;
+    uint32_t mHead = 0;
+};
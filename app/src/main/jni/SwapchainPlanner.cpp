@@ -0,0 +1,76 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <math.h>
+
+#include "SwapchainPlanner.h"
+
+uint32_t SwapchainPlanner::BytesPerPixel(EyeFormat format) {
+    return format == EyeFormat_RGB565 ? 2 : 4;
+}
+
+bool SwapchainPlanner::Obtainable(EyeFormat format) {
+    // WVR_ObtainTextureQueue takes WVR_TextureFormat_RGBA with WVR_TextureType_UnsignedByte only
+    return format == EyeFormat_RGBA8;
+}
+
+const char* SwapchainPlanner::FormatToString(EyeFormat format) {
+    switch (format) {
+        case EyeFormat_RGBA8: return "RGBA8";
+        case EyeFormat_RGB10A2: return "RGB10A2";
+        case EyeFormat_RGB565: return "RGB565";
+        default: return "unknown";
+    }
+}
+
+void SwapchainPlanner::Price(SwapchainPlan& plan) {
+    uint64_t eyeBytes = (uint64_t)plan.width * plan.height * BytesPerPixel(plan.format);
+    plan.memoryBytes = 2 * eyeBytes * plan.queueLength;
+    plan.bytesPerFrame = 2 * 2 * eyeBytes;
+}
+
+SwapchainPlan SwapchainPlanner::Plan(uint32_t streamWidth, uint32_t streamHeight, float maxResFactor,
+                                     uint32_t budgetMB, int32_t queueLength) {
+    SwapchainPlan plan;
+    plan.queueLength = queueLength > 0 ? queueLength : EXPECTED_QUEUE_LENGTH;
+    plan.width = (uint32_t)(streamWidth * maxResFactor);
+    plan.height = (uint32_t)(streamHeight * maxResFactor);
+
+    // Cheapest obtainable format first, then fewer pixels
+    uint64_t budget = (uint64_t)budgetMB * 1024 * 1024;
+    SwapchainPlan best;
+    for (int f = 0; f < EyeFormat_Count; f++) {
+        EyeFormat format = (EyeFormat)f;
+        if (!Obtainable(format)) continue;
+        SwapchainPlan candidate = plan;
+        candidate.format = format;
+        Price(candidate);
+        if (best.memoryBytes == 0 || candidate.memoryBytes < best.memoryBytes) best = candidate;
+    }
+    plan = best;
+
+    if (plan.memoryBytes > budget) {
+        float scale = sqrtf((float)budget / plan.memoryBytes);
+        uint32_t shortSide = plan.width < plan.height ? plan.width : plan.height;
+        if (shortSide * scale < MIN_SIZE) scale = (float)MIN_SIZE / shortSide;
+        // Multiples of 16 keep the decoder's macroblocks on whole texels
+        plan.width = ((uint32_t)(plan.width * scale)) & ~15u;
+        plan.height = ((uint32_t)(plan.height * scale)) & ~15u;
+        Price(plan);
+    }
+    return plan;
+}
+
+void SwapchainPlanner::LogChoices(const SwapchainPlan& chosen, uint32_t budgetMB, float fps) {
+    LOGI("[Swapchain] Eye buffers %ux%u %s x%d, %.1f of %u MB", chosen.width, chosen.height,
+         FormatToString(chosen.format), chosen.queueLength, chosen.memoryBytes / 1048576.0, budgetMB);
+    for (int f = 0; f < EyeFormat_Count; f++) {
+        SwapchainPlan plan = chosen;
+        plan.format = (EyeFormat)f;
+        Price(plan);
+        LOGI("[Swapchain]   %-7s %7.1f MB, %5.1f MB per frame, %5.2f GB/s at %.0f Hz%s",
+             FormatToString(plan.format), plan.memoryBytes / 1048576.0, plan.bytesPerFrame / 1048576.0,
+             plan.bytesPerFrame * fps / 1e9, fps,
+             plan.format == chosen.format ? ", chosen" : Obtainable(plan.format) ? "" : ", not offered by WVR");
+    }
+}
@@ -0,0 +1,51 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+
+enum EyeFormat
+{
+    EyeFormat_RGBA8,
+    EyeFormat_RGB10A2,
+    EyeFormat_RGB565,
+    EyeFormat_Count,
+};
+
+struct SwapchainPlan
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    EyeFormat format = EyeFormat_RGBA8;
+    int32_t queueLength = 0;
+    uint64_t memoryBytes = 0;       // both eyes, every texture of the queue
+    uint64_t bytesPerFrame = 0;     // both eyes, written by the blit and read by the compositor
+};
+
+/*
+ * Sizes the eye texture queues from the stream requested in cxrDeviceDesc and a
+ * memory budget. Eye buffers match the largest frame the server may send
+ * (stream size times maxResFactor) and shrink, keeping the aspect, until all
+ * textures of both queues fit. Only formats WVR texture queues can be obtained
+ * with are picked, the others are priced in the report for comparison.
+ * The queue length is WVR's, plan with the expected one and again with the
+ * length the queue came back with.
+ * */
+class SwapchainPlanner
+{
+public:
+    static const int32_t EXPECTED_QUEUE_LENGTH = 3;
+    static const uint32_t MIN_SIZE = 1024;          // never below, even over budget
+
+    static SwapchainPlan Plan(uint32_t streamWidth, uint32_t streamHeight, float maxResFactor,
+                              uint32_t budgetMB, int32_t queueLength);
+
+    // Memory and bandwidth of every format at the plan's size, one line each
+    static void LogChoices(const SwapchainPlan& chosen, uint32_t budgetMB, float fps);
+
+    static uint32_t BytesPerPixel(EyeFormat format);
+    static bool Obtainable(EyeFormat format);
+    static const char* FormatToString(EyeFormat format);
+
+private:
+    static void Price(SwapchainPlan& plan);
+};
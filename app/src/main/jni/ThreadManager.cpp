@@ -0,0 +1,212 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "ThreadManager.h"
+
+static thread_local int tSlot = -1;
+
+static pid_t CurrentTid() {
+    return (pid_t)syscall(SYS_gettid);
+}
+
+ThreadManager& ThreadManager::Instance() {
+    static ThreadManager instance;
+    return instance;
+}
+
+const char* ThreadManager::RoleToString(ThreadRole role) {
+    switch (role) {
+        case ThreadRole_Render: return "render";
+        case ThreadRole_Pose: return "pose";
+        case ThreadRole_Audio: return "audio";
+        case ThreadRole_Worker: return "worker";
+        default: return "";
+    }
+}
+
+bool ThreadManager::ParsePolicy(const std::string& spec, Policy& out) {
+    Policy policy;
+    char buf[128];
+    strncpy(buf, spec.c_str(), sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+
+    char* save = nullptr;
+    for (char* tok = strtok_r(buf, " ;", &save); tok; tok = strtok_r(nullptr, " ;", &save)) {
+        if (strncmp(tok, "cpus=", 5) == 0) {
+            // "4-7,2"
+            char* save2 = nullptr;
+            for (char* range = strtok_r(tok + 5, ",", &save2); range; range = strtok_r(nullptr, ",", &save2)) {
+                int first = 0, last = 0;
+                int n = sscanf(range, "%d-%d", &first, &last);
+                if (n == 1) last = first;
+                if (n < 1 || first < 0 || last > 63 || first > last) return false;
+                for (int cpu = first; cpu <= last; cpu++) policy.cpuMask |= 1ULL << cpu;
+            }
+        } else if (strncmp(tok, "nice=", 5) == 0) {
+            policy.hasNice = true;
+            policy.nice = atoi(tok + 5);
+            if (policy.nice < -20 || policy.nice > 19) return false;
+        } else if (strncmp(tok, "fifo=", 5) == 0) {
+            policy.fifoPriority = atoi(tok + 5);
+            if (policy.fifoPriority < 1 || policy.fifoPriority > 99) return false;
+        } else {
+            return false;
+        }
+    }
+
+    out = policy;
+    return true;
+}
+
+void ThreadManager::ApplyPolicy(pid_t tid, const char* name, const Policy& policy) {
+    if (policy.cpuMask != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (policy.cpuMask & (1ULL << cpu)) CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+            LOGW("[Threads] %s: sched_setaffinity failed: %s", name, strerror(errno));
+        }
+    }
+
+    if (policy.fifoPriority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = policy.fifoPriority;
+        // Usually not permitted for apps, nice is the fallback
+        if (sched_setscheduler(tid, SCHED_FIFO, &param) != 0) {
+            LOGW("[Threads] %s: SCHED_FIFO %d failed: %s", name, policy.fifoPriority, strerror(errno));
+        }
+    }
+
+    if (policy.hasNice) {
+        if (setpriority(PRIO_PROCESS, tid, policy.nice) != 0) {
+            LOGW("[Threads] %s: nice %d failed: %s", name, policy.nice, strerror(errno));
+        }
+    }
+}
+
+void ThreadManager::registerCurrent(ThreadRole role, const char* name) {
+    pthread_setname_np(pthread_self(), name);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    int slot = tSlot;
+    for (int i = 0; i < kMaxThreads && slot < 0; i++) {
+        if (mSlots[i].tid == 0) slot = i;
+    }
+    if (slot < 0) {
+        LOGW("[Threads] Too many threads, %s is not tracked", name);
+        return;
+    }
+
+    Slot& s = mSlots[slot];
+    s.tid = CurrentTid();
+    s.role = role;
+    strncpy(s.name, name, sizeof(s.name) - 1);
+    s.lastCpu = sched_getcpu();
+    s.migrations = 0;
+    tSlot = slot;
+
+    ApplyPolicy(s.tid, s.name, mPolicies[role]);
+}
+
+void ThreadManager::unregisterCurrent() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (tSlot >= 0) {
+        mSlots[tSlot].tid = 0;
+        tSlot = -1;
+    }
+}
+
+// For threads we don't own and can't unregister themselves, e.g. Oboe callbacks
+void ThreadManager::unregisterRole(ThreadRole role) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (int i = 0; i < kMaxThreads; i++) {
+        if (mSlots[i].tid != 0 && mSlots[i].role == role) mSlots[i].tid = 0;
+    }
+}
+
+void ThreadManager::setPolicy(ThreadRole role, const std::string& spec) {
+    Policy policy;
+    if (!ParsePolicy(spec, policy)) {
+        LOGW("[Threads] Invalid %s policy \"%s\"", RoleToString(role), spec.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPolicies[role] = policy;
+    for (int i = 0; i < kMaxThreads; i++) {
+        if (mSlots[i].tid != 0 && mSlots[i].role == role) {
+            ApplyPolicy(mSlots[i].tid, mSlots[i].name, policy);
+        }
+    }
+    LOGI("[Threads] %s policy \"%s\"", RoleToString(role), spec.c_str());
+}
+
+void ThreadManager::tick() {
+    if (tSlot < 0) return;
+
+    Slot& s = mSlots[tSlot];
+    int cpu = sched_getcpu();
+    int last = s.lastCpu.exchange(cpu);
+    if (last >= 0 && last != cpu) {
+        s.migrations++;
+    }
+}
+
+void ThreadManager::logReport() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (int i = 0; i < kMaxThreads; i++) {
+        Slot& s = mSlots[i];
+        if (s.tid == 0) continue;
+
+        // Field 39 of /proc/<tid>/stat is the CPU the thread last ran on
+        char path[64];
+        char buf[512];
+        int cpu = -1;
+        snprintf(path, sizeof(path), "/proc/self/task/%d/stat", s.tid);
+        FILE* file = fopen(path, "r");
+        if (file) {
+            size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+            buf[len] = 0;
+            fclose(file);
+            char* p = strrchr(buf, ')');
+            for (int field = 2; p && field < 39; field++) {
+                p = strchr(p + 1, ' ');
+            }
+            if (p) cpu = atoi(p + 1);
+        }
+
+        long nvcsw = -1;
+        snprintf(path, sizeof(path), "/proc/self/task/%d/status", s.tid);
+        file = fopen(path, "r");
+        if (file) {
+            while (fgets(buf, sizeof(buf), file)) {
+                if (sscanf(buf, "nonvoluntary_ctxt_switches: %ld", &nvcsw) == 1) break;
+            }
+            fclose(file);
+        }
+
+        cpu_set_t set;
+        uint64_t allowed = 0;
+        if (sched_getaffinity(s.tid, sizeof(set), &set) == 0) {
+            for (int c = 0; c < 64; c++) {
+                if (CPU_ISSET(c, &set)) allowed |= 1ULL << c;
+            }
+        }
+
+        LOGI("[Threads] %-15s %-6s tid %5d cpu %2d allowed 0x%02llx nice %3d migrations %u preempted %ld",
+             s.name, RoleToString(s.role), s.tid, cpu, (unsigned long long)allowed,
+             getpriority(PRIO_PROCESS, s.tid), s.migrations.exchange(0), nvcsw);
+    }
+}
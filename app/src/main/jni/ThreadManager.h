@@ -0,0 +1,71 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+enum ThreadRole
+{
+    ThreadRole_Render = 0,
+    ThreadRole_Pose,
+    ThreadRole_Audio,   // Oboe recording callback, mic uplink
+    ThreadRole_Worker,
+    ThreadRole_Count
+};
+
+/*
+ * Names every thread the client owns and applies a per role placement policy.
+ * Policy spec, space or ';' separated: "cpus=4-7,2 nice=-4" or "cpus=6 fifo=2".
+ * Empty spec leaves the system default.
+ * */
+class ThreadManager
+{
+public:
+    static ThreadManager& Instance();
+
+    // Name the calling thread and apply the policy of its role
+    void registerCurrent(ThreadRole role, const char* name);
+    void unregisterCurrent();
+    void unregisterRole(ThreadRole role);
+
+    // Re-applied to the live threads of that role
+    void setPolicy(ThreadRole role, const std::string& spec);
+
+    // Called once per iteration by looping threads to count CPU migrations
+    void tick();
+
+    // One line per thread: current CPU, allowed CPUs, migrations and context switches
+    void logReport();
+
+    static const char* RoleToString(ThreadRole role);
+
+private:
+    struct Policy {
+        uint64_t cpuMask = 0;   // 0 = not pinned
+        bool hasNice = false;
+        int nice = 0;
+        int fifoPriority = 0;   // > 0 = SCHED_FIFO
+    };
+
+    struct Slot {
+        pid_t tid = 0;
+        ThreadRole role = ThreadRole_Worker;
+        char name[16] = {};
+        std::atomic<int> lastCpu;
+        std::atomic<uint32_t> migrations;
+        Slot() : lastCpu(-1), migrations(0) {}
+    };
+
+    static const int kMaxThreads = 32;
+
+    ThreadManager() = default;
+    static bool ParsePolicy(const std::string& spec, Policy& out);
+    static void ApplyPolicy(pid_t tid, const char* name, const Policy& policy);
+
+    std::mutex mMutex;
+    Policy mPolicies[ThreadRole_Count];
+    Slot mSlots[kMaxThreads];
+};
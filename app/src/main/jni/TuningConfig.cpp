@@ -0,0 +1,257 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "TuningConfig.h"
+#include "ThreadManager.h"
+
+struct TuningKey {
+    const char* name;
+    uint32_t TuningParams::* field;
+    uint32_t min;
+    uint32_t max;
+};
+
+// The order gives the TuningChange ids in flight records, new keys go last
+static const TuningKey kTuningKeys[] = {
+        { "latchTimeoutMs",    &TuningParams::latchTimeoutMs,    1,  1000 },
+        { "posePollHz",        &TuningParams::posePollHz,        30, 1000 },
+        { "poseMinHz",         &TuningParams::poseMinHz,         0,  1000 },
+        { "posePredictionMs",  &TuningParams::posePredictionMs,  0,  100 },
+        { "audioBufferBursts", &TuningParams::audioBufferBursts, 1,  16 },
+        { "statsIntervalSec",  &TuningParams::statsIntervalSec,  1,  60 },
+        { "idleFps",           &TuningParams::idleFps,           1,  90 },
+        { "concealMisses",     &TuningParams::concealMisses,     0,  90 },
+        { "recordMotion",      &TuningParams::recordMotion,      0,  1 },
+        { "replayMotionPct",   &TuningParams::replayMotionPct,   0,  1000 },
+        { "handRateHz",        &TuningParams::handRateHz,        0,  90 },
+        { "stallBudgetMs",     &TuningParams::stallBudgetMs,     0,  10000 },
+        { "micGateDb",         &TuningParams::micGateDb,         0,  90 },
+};
+static const size_t kTuningKeyCount = sizeof(kTuningKeys) / sizeof(*kTuningKeys);
+
+struct TuningStringKey {
+    const char* name;
+    std::string TuningParams::* field;
+};
+
+static const TuningStringKey kTuningStringKeys[] = {
+        { "threadRender", &TuningParams::threadRender },
+        { "threadPose",   &TuningParams::threadPose },
+        { "threadAudio",  &TuningParams::threadAudio },
+        { "threadWorker", &TuningParams::threadWorker },
+};
+static const size_t kTuningStringKeyCount = sizeof(kTuningStringKeys) / sizeof(*kTuningStringKeys);
+
+static char* Trim(char* str) {
+    while (*str == ' ' || *str == '\t') str++;
+    char* end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+    *end = 0;
+    return str;
+}
+
+bool TuningParams::ParseFile(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char* key = Trim(line);
+        if (*key == 0 || *key == '#') continue;
+
+        char* sep = strchr(key, '=');
+        if (sep == nullptr) {
+            LOGW("[Tuning] Ignore malformed line: %s", key);
+            continue;
+        }
+        *sep = 0;
+        key = Trim(key);
+        char* value = Trim(sep + 1);
+
+        bool isString = false;
+        for (size_t i = 0; i < kTuningStringKeyCount; i++) {
+            if (strcmp(kTuningStringKeys[i].name, key) == 0) {
+                this->*(kTuningStringKeys[i].field) = value;
+                isString = true;
+                break;
+            }
+        }
+        if (isString) continue;
+
+        const TuningKey* match = nullptr;
+        for (size_t i = 0; i < kTuningKeyCount; i++) {
+            if (strcmp(kTuningKeys[i].name, key) == 0) {
+                match = &kTuningKeys[i];
+                break;
+            }
+        }
+        if (match == nullptr) {
+            LOGW("[Tuning] Unknown key %s", key);
+            continue;
+        }
+
+        char* end = nullptr;
+        unsigned long v = strtoul(value, &end, 10);
+        if (end == value || *end != 0 || v < match->min || v > match->max) {
+            LOGW("[Tuning] Invalid %s=%s, expected %u..%u", key, value, match->min, match->max);
+            continue;
+        }
+        this->*(match->field) = (uint32_t)v;
+    }
+
+    fclose(file);
+    return true;
+}
+
+void TuningParams::LogChanges(const TuningParams& from, const TuningParams& to,
+                              const std::function<void(const TuningChange&)>& onChange) {
+    for (size_t i = 0; i < kTuningKeyCount; i++) {
+        uint32_t before = from.*(kTuningKeys[i].field);
+        uint32_t after = to.*(kTuningKeys[i].field);
+        if (before != after) {
+            LOGI("[Tuning] %s %u -> %u", kTuningKeys[i].name, before, after);
+            if (onChange) onChange({ (uint16_t)i, kTuningKeys[i].name, before, after, nullptr, nullptr });
+        }
+    }
+    for (size_t i = 0; i < kTuningStringKeyCount; i++) {
+        const std::string& before = from.*(kTuningStringKeys[i].field);
+        const std::string& after = to.*(kTuningStringKeys[i].field);
+        if (before != after) {
+            LOGI("[Tuning] %s \"%s\" -> \"%s\"", kTuningStringKeys[i].name, before.c_str(), after.c_str());
+            if (onChange) {
+                onChange({ (uint16_t)(kTuningKeyCount + i), kTuningStringKeys[i].name, 0, 0,
+                           before.c_str(), after.c_str() });
+            }
+        }
+    }
+}
+
+TuningWatcher::TuningWatcher()
+        : mPending(false)
+        , mExit(false)
+        {}
+
+TuningWatcher::~TuningWatcher() {
+    stop();
+}
+
+bool TuningWatcher::start(const char* path, const TuningParams& defaults) {
+    if (mThread != nullptr) {
+        return true;
+    }
+
+    mPath = path;
+    mDefaults = defaults;
+    reload();
+
+    // Watch the directory, editors and adb push may replace the file instead of writing it
+    std::string dir = mPath.substr(0, mPath.find_last_of('/'));
+    mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mFd < 0 || inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE) < 0) {
+        LOGW("[Tuning] inotify unavailable on %s (%s), polling instead", dir.c_str(), strerror(errno));
+    }
+
+    mExit = false;
+    mThread = new std::thread(&TuningWatcher::watchLoop, this);
+    return true;
+}
+
+void TuningWatcher::stop() {
+    if (mThread != nullptr) {
+        mExit = true;
+        if (mThread->joinable()) {
+            mThread->join();
+        }
+        delete mThread;
+        mThread = nullptr;
+    }
+
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+bool TuningWatcher::fetch(TuningParams& params) {
+    if (!mPending.exchange(false)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    params = mLatest;
+    return true;
+}
+
+void TuningWatcher::reload() {
+    // Overlay on the defaults so that removing a key reverts it
+    TuningParams params = mDefaults;
+    if (!params.ParseFile(mPath.c_str())) {
+        LOGI("[Tuning] %s not found, using defaults", mPath.c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLatest = params;
+        mVersion++;
+    }
+    mPending = true;
+    LOGI("[Tuning] Loaded %s, version %u", mPath.c_str(), mVersion);
+}
+
+void TuningWatcher::watchLoop() {
+    ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-tuning");
+
+    const char* name = strrchr(mPath.c_str(), '/');
+    name = name ? name + 1 : mPath.c_str();
+
+    struct stat st;
+    time_t lastMtime = (stat(mPath.c_str(), &st) == 0) ? st.st_mtime : 0;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!mExit) {
+        bool changed = false;
+
+        if (mFd >= 0) {
+            struct pollfd pfd = { mFd, POLLIN, 0 };
+            if (poll(&pfd, 1, 500) > 0) {
+                ssize_t len;
+                while ((len = read(mFd, buf, sizeof(buf))) > 0) {
+                    for (char* p = buf; p < buf + len; ) {
+                        struct inotify_event* event = (struct inotify_event*)p;
+                        if (event->len > 0 && strcmp(event->name, name) == 0) {
+                            changed = true;
+                        }
+                        p += sizeof(struct inotify_event) + event->len;
+                    }
+                }
+            }
+        } else {
+            usleep(500 * 1000);
+        }
+
+        // FUSE backed /sdcard doesn't always deliver events, fall back on the mtime
+        time_t mtime = (stat(mPath.c_str(), &st) == 0) ? st.st_mtime : 0;
+        if (mtime != lastMtime) {
+            changed = true;
+            lastMtime = mtime;
+        }
+
+        if (changed) {
+            reload();
+        }
+    }
+
+    ThreadManager::Instance().unregisterCurrent();
+}
@@ -0,0 +1,88 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define TUNING_CONFIG_PATH "/sdcard/CloudXRClientTuning.txt"
+
+// A key whose value changed, see TuningParams::LogChanges
+struct TuningChange
+{
+    uint16_t id;                // numeric keys in table order, then the thread keys. Recorded, append only
+    const char* name;
+    uint32_t from;              // numeric keys
+    uint32_t to;
+    const char* fromText;       // thread keys, nullptr for numeric ones
+    const char* toText;
+};
+
+/*
+ * Client side parameters that can change in the middle of a session.
+ * Read from a key=value overlay file, keys not present keep their default.
+ * */
+struct TuningParams
+{
+    uint32_t latchTimeoutMs = 100;      // cxrLatchFrame timeout
+    uint32_t posePollHz = 250;          // updatePose sampling rate of a moving device
+    uint32_t poseMinHz = 0;             // sampling rate of a still device if above the display rate, >= posePollHz = fixed rate
+    uint32_t posePredictionMs = 0;      // passed to WVR_GetPoseState
+    uint32_t audioBufferBursts = 2;     // playback buffer size in bursts
+    uint32_t statsIntervalSec = 3;      // connection stats logging interval
+    uint32_t idleFps = 10;              // loading screen rate while not streaming
+    uint32_t concealMisses = 3;         // latch misses re-showing the last frame before going grey, 0 = off
+    uint32_t recordMotion = 0;          // 1 = record poses and input to MOTION_RECORDING_PATH
+    uint32_t replayMotionPct = 0;       // replay that recording at this % of real time, 0 = off
+    uint32_t handRateHz = 0;            // hand joint messages per second, 0 = hand tracking off
+    uint32_t stallBudgetMs = 250;       // heartbeat gap reported as a stall, 0 = off
+    uint32_t micGateDb = 50;            // mic blocks quieter than -micGateDb dBFS are not sent, 0 = send all
+
+    // Thread placement per role, see ThreadManager for the format
+    std::string threadRender;
+    std::string threadPose;
+    std::string threadAudio;
+    std::string threadWorker;
+
+    // Parse "key=value" lines on top of the current values, returns false if the file can't be read
+    bool ParseFile(const char* path);
+
+    // Log one event per changed key and pass it on to onChange
+    static void LogChanges(const TuningParams& from, const TuningParams& to,
+                           const std::function<void(const TuningChange&)>& onChange = nullptr);
+};
+
+/*
+ * Watches the overlay file with inotify and keeps the latest parsed version.
+ * The render loop picks it up with fetch() at a frame boundary.
+ * */
+class TuningWatcher
+{
+public:
+    TuningWatcher();
+    ~TuningWatcher();
+
+    // Loads the file once and starts watching it. defaults are used for keys missing in the file
+    bool start(const char* path, const TuningParams& defaults);
+    void stop();
+
+    // Returns true with the new params if the file changed since the last call
+    bool fetch(TuningParams& params);
+
+private:
+    void watchLoop();
+    void reload();
+
+    std::string mPath;
+    TuningParams mDefaults;
+    TuningParams mLatest;
+    std::mutex mMutex;
+    std::atomic<bool> mPending;
+    std::atomic<bool> mExit;
+    std::thread* mThread = nullptr;
+    int mFd = -1;
+    uint32_t mVersion = 0;
+};
@@ -0,0 +1,300 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <log.h>
+#include <time.h>
+
+#include "UserDataChannel.h"
+#include "ThreadManager.h"
+
+static int64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void UpdateMax(std::atomic<uint32_t>& max, uint32_t value) {
+    uint32_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void CloudXRUserDataTransport::setReceiver(cxrReceiverHandle receiver) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mReceiver = receiver;
+}
+
+bool CloudXRUserDataTransport::send(const uint8_t* data, uint32_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mReceiver != nullptr && cxrSendUserData(mReceiver, data, size) == cxrError_Success;
+}
+
+bool LoopbackTransport::send(const uint8_t* data, uint32_t size) {
+    mPeer.receive(data, size);
+    return true;
+}
+
+void UserDataChannel::PacketQueue::push(Packet* packet) {
+    packet->next = nullptr;
+    if (tail) tail->next = packet;
+    else head = packet;
+    tail = packet;
+    depth++;
+}
+
+UserDataChannel::Packet* UserDataChannel::PacketQueue::pop() {
+    Packet* packet = head;
+    if (packet) {
+        head = packet->next;
+        if (head == nullptr) tail = nullptr;
+        depth--;
+    }
+    return packet;
+}
+
+UserDataChannel::UserDataChannel() {
+    for (uint32_t i = 0; i < POOL_SIZE; i++) {
+        mPool[i].next = mFree;
+        mFree = &mPool[i];
+    }
+    mFreeCount = POOL_SIZE;
+}
+
+UserDataChannel::~UserDataChannel() {
+    stop();
+}
+
+void UserDataChannel::setHandler(uint8_t type, const Handler& handler) {
+    mHandlers[type] = handler;
+}
+
+UserDataChannel::Packet* UserDataChannel::acquire() {
+    std::lock_guard<std::mutex> lock(mPoolMutex);
+    Packet* packet = mFree;
+    if (packet) {
+        mFree = packet->next;
+        packet->next = nullptr;
+        packet->size = 0;
+        mFreeCount--;
+        if (mFreeCount < mFreeLow) mFreeLow = mFreeCount;
+    }
+    return packet;
+}
+
+void UserDataChannel::release(Packet* packet) {
+    std::lock_guard<std::mutex> lock(mPoolMutex);
+    packet->next = mFree;
+    mFree = packet;
+    mFreeCount++;
+}
+
+bool UserDataChannel::start(UserDataTransport* transport) {
+    if (mThread) {
+        return true;
+    }
+    mTransport = transport;
+    {
+        std::lock_guard<std::mutex> lock(mReceiveMutex);
+        mExit = false;
+    }
+    mRunning = true;
+    mThread = new std::thread(&UserDataChannel::dispatchLoop, this);
+    mWindowBeginNs = NowNs();
+    LOGI("[UserData] Channel started, %u packets of %u bytes", POOL_SIZE, MAX_PACKET);
+    return true;
+}
+
+void UserDataChannel::stop() {
+    if (!mThread) {
+        return;
+    }
+    mRunning = false;
+    {
+        std::lock_guard<std::mutex> lock(mReceiveMutex);
+        mExit = true;
+    }
+    mReceiveCond.notify_all();
+    if (mThread->joinable()) {
+        mThread->join();
+    }
+    delete mThread;
+    mThread = nullptr;
+
+    // Unsent and undispatched packets go back to the pool
+    {
+        std::lock_guard<std::mutex> lock(mSendMutex);
+        if (mBatch) {
+            release(mBatch);
+            mBatch = nullptr;
+        }
+        while (Packet* packet = mOutgoing.pop()) release(packet);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mReceiveMutex);
+        while (Packet* packet = mIncoming.pop()) release(packet);
+    }
+    mTransport = nullptr;
+}
+
+// mSendMutex held. Returns where the frame header goes, nullptr if it can't be sent
+uint8_t* UserDataChannel::beginFrame(uint32_t maxSize) {
+    if (maxSize > MAX_PAYLOAD) {
+        mSendDropped++;
+        return nullptr;
+    }
+    if (mBatch && mBatch->size + FRAME_HEADER + maxSize > MAX_PACKET) {
+        mOutgoing.push(mBatch);
+        UpdateMax(mOutgoingMax, mOutgoing.depth);
+        mBatch = nullptr;
+    }
+    if (mBatch == nullptr) {
+        mBatch = acquire();
+        if (mBatch == nullptr) {
+            mSendDropped++;
+            return nullptr;
+        }
+    }
+    return mBatch->data + mBatch->size;
+}
+
+void UserDataChannel::endFrame(uint8_t* frame, uint8_t type, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    frame[0] = (uint8_t)size;
+    frame[1] = (uint8_t)(size >> 8);
+    frame[2] = type;
+    mBatch->size += FRAME_HEADER + size;
+    mSentMessages++;
+}
+
+void UserDataChannel::flush() {
+    PacketQueue ready;
+    {
+        std::lock_guard<std::mutex> lock(mSendMutex);
+        if (mBatch) {
+            mOutgoing.push(mBatch);
+            mBatch = nullptr;
+        }
+        std::swap(ready, mOutgoing);
+    }
+
+    while (Packet* packet = ready.pop()) {
+        if (mTransport && mTransport->send(packet->data, packet->size)) {
+            mSentPackets++;
+            mSentBytes += packet->size;
+        } else {
+            mSendDropped++;
+        }
+        release(packet);
+    }
+}
+
+void UserDataChannel::receive(const void* data, uint32_t size) {
+    if (!mRunning) {
+        return;
+    }
+    if (size == 0 || size > MAX_PACKET) {
+        mMalformed++;
+        return;
+    }
+    Packet* packet = acquire();
+    if (packet == nullptr) {
+        mReceiveDropped++;
+        return;
+    }
+    memcpy(packet->data, data, size);
+    packet->size = size;
+
+    {
+        // stop() may have drained the queue since the check above, the packet
+        // would otherwise be dispatched by the next session
+        std::lock_guard<std::mutex> lock(mReceiveMutex);
+        if (mExit) {
+            release(packet);
+            return;
+        }
+        mIncoming.push(packet);
+        UpdateMax(mIncomingMax, mIncoming.depth);
+    }
+    mReceivedPackets++;
+    mReceivedBytes += size;
+    mReceiveCond.notify_one();
+}
+
+void UserDataChannel::dispatch(const Packet& packet) {
+    const uint8_t* p = packet.data;
+    const uint8_t* end = packet.data + packet.size;
+    while (p < end) {
+        if (end - p < (ptrdiff_t)FRAME_HEADER) {
+            mMalformed++;
+            return;
+        }
+        uint32_t size = p[0] | (uint32_t)p[1] << 8;
+        uint8_t type = p[2];
+        p += FRAME_HEADER;
+        if (size > (uint32_t)(end - p)) {
+            mMalformed++;
+            return;
+        }
+
+        mReceivedMessages++;
+        if (mHandlers[type]) {
+            mHandlers[type](p, size);
+        } else {
+            mUnhandled++;
+        }
+        p += size;
+    }
+}
+
+void UserDataChannel::dispatchLoop() {
+    ThreadManager::Instance().registerCurrent(ThreadRole_Worker, "cxr-userdata");
+
+    std::unique_lock<std::mutex> lock(mReceiveMutex);
+    while (true) {
+        mReceiveCond.wait(lock, [this]() { return mExit || mIncoming.head != nullptr; });
+        if (mExit) {
+            break;
+        }
+        Packet* packet = mIncoming.pop();
+        lock.unlock();
+        dispatch(*packet);
+        release(packet);
+        lock.lock();
+    }
+
+    ThreadManager::Instance().unregisterCurrent();
+}
+
+void UserDataChannel::logReport() {
+    int64_t now = NowNs();
+    float seconds = (now - mWindowBeginNs) / 1e9f;
+    mWindowBeginNs = now;
+
+    uint32_t sentMessages = mSentMessages.exchange(0);
+    uint32_t sentPackets = mSentPackets.exchange(0);
+    uint64_t sentBytes = mSentBytes.exchange(0);
+    uint32_t sendDropped = mSendDropped.exchange(0);
+    uint32_t receivedMessages = mReceivedMessages.exchange(0);
+    uint32_t receivedPackets = mReceivedPackets.exchange(0);
+    uint64_t receivedBytes = mReceivedBytes.exchange(0);
+    uint32_t receiveDropped = mReceiveDropped.exchange(0);
+    uint32_t malformed = mMalformed.exchange(0);
+    uint32_t unhandled = mUnhandled.exchange(0);
+    uint32_t outgoingMax = mOutgoingMax.exchange(0);
+    uint32_t incomingMax = mIncomingMax.exchange(0);
+    uint32_t freeLow;
+    {
+        std::lock_guard<std::mutex> lock(mPoolMutex);
+        freeLow = mFreeLow;
+        mFreeLow = mFreeCount;
+    }
+
+    if (seconds <= 0.0f || (sentPackets + receivedPackets + sendDropped + receiveDropped + malformed) == 0) {
+        return;
+    }
+    LOGI("[UserData] sent %.1f msg/s in %.1f pkt/s, %.0f B/s, dropped %u; received %.1f msg/s in %.1f pkt/s, %.0f B/s, "
+         "dropped %u, malformed %u, unhandled %u; max queued out %u in %u, pool low %u/%u",
+         sentMessages / seconds, sentPackets / seconds, sentBytes / seconds, sendDropped,
+         receivedMessages / seconds, receivedPackets / seconds, receivedBytes / seconds,
+         receiveDropped, malformed, unhandled, outgoingMax, incomingMax, freeLow, POOL_SIZE);
+}
@@ -0,0 +1,179 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <CloudXRClient.h>
+
+/*
+ * Where a packet goes. CloudXRUserDataTransport is the real one, LoopbackTransport
+ * hands packets straight to another channel to exercise both ends without a server.
+ * */
+class UserDataTransport
+{
+public:
+    virtual ~UserDataTransport() {}
+    virtual bool send(const uint8_t* data, uint32_t size) = 0;
+};
+
+class CloudXRUserDataTransport : public UserDataTransport
+{
+public:
+    // nullptr before the receiver is destroyed
+    void setReceiver(cxrReceiverHandle receiver);
+    bool send(const uint8_t* data, uint32_t size) override;
+
+private:
+    std::mutex mMutex;
+    cxrReceiverHandle mReceiver = nullptr;
+};
+
+class UserDataChannel;
+class LoopbackTransport : public UserDataTransport
+{
+public:
+    explicit LoopbackTransport(UserDataChannel& peer) : mPeer(peer) {}
+    bool send(const uint8_t* data, uint32_t size) override;
+
+private:
+    UserDataChannel& mPeer;
+};
+
+/*
+ * Message channel over CloudXR user data, both directions.
+ * A packet is a run of frames: payload length (u16 LE), type (1 byte), payload.
+ * Messages written during a frame are batched into as few packets as fit and
+ * sent by flush(), once per rendered frame.
+ * Packets live in a fixed pool: write() builds the frame in place, a received
+ * packet is copied once into the pool and handlers read it there. Handlers run
+ * on the channel's own thread, never on the CloudXR callback thread.
+ * */
+class UserDataChannel
+{
+public:
+    static const uint32_t MAX_PACKET = 1200;
+    static const uint32_t FRAME_HEADER = 3;
+    static const uint32_t MAX_PAYLOAD = MAX_PACKET - FRAME_HEADER;
+    static const uint32_t POOL_SIZE = 32;
+
+    typedef std::function<void(const uint8_t* payload, uint32_t size)> Handler;
+
+    UserDataChannel();
+    ~UserDataChannel();
+
+    // Handlers are set before start()
+    void setHandler(uint8_t type, const Handler& handler);
+
+    // Fixed size message, payloads of another size are counted as malformed
+    template<typename T>
+    void setHandler(uint8_t type, const std::function<void(const T&)>& handler) {
+        setHandler(type, [this, handler](const uint8_t* payload, uint32_t size) {
+            if (size != sizeof(T)) {
+                mMalformed++;
+                return;
+            }
+            T message;
+            memcpy(&message, payload, sizeof(T));
+            handler(message);
+        });
+    }
+
+    bool start(UserDataTransport* transport);
+    // Joins the dispatch thread, a receive() racing it is dropped
+    void stop();
+
+    // Any thread. fill(uint8_t* out) writes up to maxSize bytes straight into the
+    // outgoing packet and returns the size used, 0 to cancel
+    template<typename Fill>
+    bool write(uint8_t type, uint32_t maxSize, Fill fill) {
+        std::lock_guard<std::mutex> lock(mSendMutex);
+        uint8_t* out = beginFrame(maxSize);
+        if (out == nullptr) {
+            return false;
+        }
+        uint32_t size = fill(out + FRAME_HEADER);
+        endFrame(out, type, size <= maxSize ? size : 0);
+        return size > 0 && size <= maxSize;
+    }
+
+    bool send(uint8_t type, const void* payload, uint32_t size) {
+        return write(type, size, [payload, size](uint8_t* out) {
+            memcpy(out, payload, size);
+            return size;
+        });
+    }
+
+    // Render thread, once per frame: sends everything written since the last call
+    void flush();
+
+    // CloudXR callback thread, queues the packet for the dispatch thread
+    void receive(const void* data, uint32_t size);
+
+    // Logs throughput, queue depths and drops of the window and starts a new one
+    void logReport();
+
+private:
+    struct Packet {
+        uint32_t size = 0;
+        Packet* next = nullptr;
+        uint8_t data[MAX_PACKET];
+    };
+
+    // Intrusive FIFO, no allocation
+    struct PacketQueue {
+        Packet* head = nullptr;
+        Packet* tail = nullptr;
+        uint32_t depth = 0;
+        void push(Packet* packet);
+        Packet* pop();
+    };
+
+    Packet* acquire();
+    void release(Packet* packet);
+    uint8_t* beginFrame(uint32_t maxSize);
+    void endFrame(uint8_t* frame, uint8_t type, uint32_t size);
+    void dispatchLoop();
+    void dispatch(const Packet& packet);
+
+    Handler mHandlers[256];
+    UserDataTransport* mTransport = nullptr;
+
+    Packet mPool[POOL_SIZE];
+    std::mutex mPoolMutex;
+    Packet* mFree = nullptr;
+    uint32_t mFreeCount = 0;
+    uint32_t mFreeLow = POOL_SIZE;
+
+    // Outgoing, the batch being filled and full ones waiting for flush()
+    std::mutex mSendMutex;
+    Packet* mBatch = nullptr;
+    PacketQueue mOutgoing;
+
+    // Incoming
+    std::mutex mReceiveMutex;
+    std::condition_variable mReceiveCond;
+    PacketQueue mIncoming;
+    std::thread* mThread = nullptr;
+    bool mExit = false;
+    std::atomic<bool> mRunning{false};
+
+    // Window stats
+    std::atomic<uint32_t> mSentMessages{0};
+    std::atomic<uint32_t> mSentPackets{0};
+    std::atomic<uint64_t> mSentBytes{0};
+    std::atomic<uint32_t> mSendDropped{0};      // pool empty, too large or transport failed
+    std::atomic<uint32_t> mReceivedMessages{0};
+    std::atomic<uint32_t> mReceivedPackets{0};
+    std::atomic<uint64_t> mReceivedBytes{0};
+    std::atomic<uint32_t> mReceiveDropped{0};   // pool empty
+    std::atomic<uint32_t> mMalformed{0};
+    std::atomic<uint32_t> mUnhandled{0};
+    std::atomic<uint32_t> mOutgoingMax{0};
+    std::atomic<uint32_t> mIncomingMax{0};
+    int64_t mWindowBeginNs = 0;
+};
@@ -0,0 +1,106 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#include <math.h>
+
+#include "VoiceActivity.h"
+
+// Voice sits between rumble (a few crossings per block) and hiss (about every other sample)
+static const float kMinZeroCrossingRate = 0.004f;
+static const float kMaxZeroCrossingRate = 0.35f;
+// Above the noise floor by this much to count, and how fast the floor follows a louder room
+static const float kNoiseMarginDb = 4.0f;
+static const float kNoiseRiseDbPerSec = 3.0f;
+// A 5 ms block of fan noise or mains hum swings by more than the margin, the level
+// and the floor are averaged over longer than a block to see past that
+static const float kLevelSeconds = 0.01f;
+static const float kFloorSeconds = 0.15f;
+
+static float Average(float& average, float value, float seconds, float timeConstant) {
+    average += fminf(1.0f, seconds / timeConstant) * (value - average);
+    return average;
+}
+
+static float ToDb(float meanSquare) {
+    return meanSquare > 0.0f ? fmaxf(-96.0f, 10.0f * log10f(meanSquare)) : -96.0f;
+}
+
+VoiceBlockStats VoiceActivityDetector::Analyze(const int16_t* samples, uint32_t count) {
+    VoiceBlockStats stats = { -96.0f, 0.0f };
+    if (count == 0) {
+        return stats;
+    }
+
+    // Squares are summed in 32 bits over chunks short enough not to overflow, which
+    // keeps the inner loop in 16x16->32 multiplies the compiler turns into NEON
+    const uint32_t kChunk = 256;
+    uint64_t energy = 0;
+    uint32_t crossings = 0;
+    for (uint32_t begin = 0; begin < count; begin += kChunk) {
+        uint32_t end = count - begin < kChunk ? count : begin + kChunk;
+        uint32_t chunkEnergy = 0;
+        uint32_t chunkCrossings = 0;
+        for (uint32_t i = begin; i < end; i++) {
+            int32_t s = samples[i];
+            chunkEnergy += (uint32_t)(s * s) >> 8;
+        }
+        for (uint32_t i = begin == 0 ? 1 : begin; i < end; i++) {
+            chunkCrossings += (uint16_t)(samples[i] ^ samples[i - 1]) >> 15;
+        }
+        energy += chunkEnergy;
+        crossings += chunkCrossings;
+    }
+
+    double meanSquare = (double)energy * 256.0 / count;
+    if (meanSquare > 0) {
+        stats.levelDb = (float)(10.0 * log10(meanSquare / (32768.0 * 32768.0)));
+        if (stats.levelDb < -96.0f) stats.levelDb = -96.0f;
+    }
+    stats.zeroCrossingRate = count > 1 ? (float)crossings / (count - 1) : 0.0f;
+    return stats;
+}
+
+void VoiceActivityDetector::reset() {
+    mNoiseDb = 0.0f;
+    mNoiseKnown = false;
+    mLevelEnergy = 0.0f;
+    mFloorEnergy = 0.0f;
+    mHangoverFrames = 0;
+    mLast = { -96.0f, 0.0f };
+}
+
+bool VoiceActivityDetector::process(const int16_t* samples, uint32_t count, uint32_t sampleRate) {
+    mLast = Analyze(samples, count);
+    uint32_t gateDb = mGateDb.load(std::memory_order_relaxed);
+    if (gateDb == 0) {
+        return true;
+    }
+
+    // Energies relative to full scale
+    float seconds = (float)count / sampleRate;
+    float energy = powf(10.0f, mLast.levelDb / 10.0f);
+    if (!mNoiseKnown) {
+        mNoiseDb = -(float)gateDb;
+        mLevelEnergy = mFloorEnergy = energy;
+        mNoiseKnown = true;
+    }
+    // Never above the block itself, so the average doesn't carry a loud block into a quiet one
+    float levelDb = fminf(mLast.levelDb, ToDb(Average(mLevelEnergy, energy, seconds, kLevelSeconds)));
+
+    // Falls to any quieter average at once, rises slowly so speech doesn't become the floor
+    float floorDb = ToDb(Average(mFloorEnergy, energy, seconds, kFloorSeconds));
+    mNoiseDb = fminf(floorDb, mNoiseDb + kNoiseRiseDbPerSec * seconds);
+
+    bool voiced = levelDb > -(float)gateDb &&
+                  levelDb > mNoiseDb + kNoiseMarginDb &&
+                  mLast.zeroCrossingRate >= kMinZeroCrossingRate &&
+                  mLast.zeroCrossingRate <= kMaxZeroCrossingRate;
+    if (voiced) {
+        mHangoverFrames = sampleRate / 1000 * DEFAULT_HANGOVER_MS;
+        return true;
+    }
+    if (mHangoverFrames > 0) {
+        mHangoverFrames = count < mHangoverFrames ? mHangoverFrames - count : 0;
+        return true;
+    }
+    return false;
+}
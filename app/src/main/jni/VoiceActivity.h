@@ -0,0 +1,52 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// No SDK types here, tools/VadCheck.cpp runs the detector over recorded clips
+
+struct VoiceBlockStats
+{
+    float levelDb;              // RMS in dB below full scale, -96 for digital silence
+    float zeroCrossingRate;     // sign changes per sample, 0..1
+};
+
+/*
+ * Energy and zero-crossing voice activity detection for the mic uplink.
+ * A block is voiced when its level is above the gate, clears the tracked noise
+ * floor and has a zero crossing rate in the speech range, which rejects rumble
+ * and hiss as loud as a voice. Level and floor are short averages of the block
+ * energy, steady noise doesn't trip the gate by swinging between blocks. Voice
+ * is held for a hangover after the last voiced block so word endings and short
+ * pauses still go out.
+ * process() is for one thread, the audio callback. setGateDb() from any thread.
+ * */
+class VoiceActivityDetector
+{
+public:
+    static const uint32_t DEFAULT_GATE_DB = 50;        // -50 dBFS
+    static const uint32_t DEFAULT_HANGOVER_MS = 300;
+
+    // Blocks below -gateDb dBFS are silence, 0 passes everything as voice
+    void setGateDb(uint32_t gateDb) { mGateDb = gateDb; }
+    uint32_t gateDb() const { return mGateDb; }
+
+    // Mono samples of one block, returns whether it should be sent
+    bool process(const int16_t* samples, uint32_t count, uint32_t sampleRate);
+    void reset();
+
+    const VoiceBlockStats& lastStats() const { return mLast; }
+
+    // Branch free over the samples so it vectorizes
+    static VoiceBlockStats Analyze(const int16_t* samples, uint32_t count);
+
+private:
+    std::atomic<uint32_t> mGateDb{DEFAULT_GATE_DB};
+    float mNoiseDb = 0.0f;
+    bool mNoiseKnown = false;           // starts at the gate, a clip may open with voice
+    float mLevelEnergy = 0.0f;          // mean squares relative to full scale
+    float mFloorEnergy = 0.0f;
+    uint32_t mHangoverFrames = 0;       // left before silence
+    VoiceBlockStats mLast = { -96.0f, 0.0f };
+};
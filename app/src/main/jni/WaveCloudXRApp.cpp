@@ -1,8 +1,11 @@
 //========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
 
 #include <log.h>
+#include <math.h>
 #include <string.h>
+#include <time.h>
 #include <sys/time.h>
+#include <algorithm>
 
 #include <egl/egl.h>
 #include <GLES3/gl31.h>
@@ -26,8 +29,8 @@
     ((now.tv_sec - last.tv_sec) * 1000000LL + now.tv_usec - last.tv_usec)
 
 #define VR_MAX_CLOCKS 200
-#define LATCHFRAME_TIMEOUT_MS 100 // timeout to fetch a frame from CloudXR server
 #define FRAME_TIMEOUT_SECOND 10.0f // retry connection if no valid frame or connection timeout
+#define FALLBACK_STREAM_SIZE 2448 // Focus 3 panel, if WVR recommends no render target size
 
 #define VERSION_CODE "v1.7"
 
@@ -103,8 +106,6 @@ cxrInputValueType inputValuesTouchLegacy[inputTouchLegacyCount] =
         };
 WaveCloudXRApp::WaveCloudXRApp()
         : mTimeDiff(0.0f)
-        , mLeftEyeQ(nullptr)
-        , mRightEyeQ(nullptr)
         , mReceiver(nullptr)
         , mPlaybackStream(nullptr)
         , mRecordStream(nullptr)
@@ -114,9 +115,68 @@ WaveCloudXRApp::WaveCloudXRApp()
         , mConnected(false)
         , mInited(false)
         , mPaused(true)
-        , mStateDirty(true)
         {}
 
+bool WaveCloudXRApp::startup() {
+    ThreadManager::Instance().registerCurrent(ThreadRole_Render, "cxr-render");
+
+    StartupOrchestrator& s = mStartup;
+
+    // Config parsing and audio setup don't depend on WVR or the EGL context
+    auto config = s.addStep("LoadConfig", [this]() { return LoadConfig(); }, false);
+    auto tuning = s.addStep("LoadTuning", [this]() {
+        // The launch profile sets the defaults, the tuning file can still override them
+        mTuning.latchTimeoutMs = mProfile.latchTimeoutMs;
+        mTuning.posePollHz = mProfile.posePollHz;
+        mTuning.audioBufferBursts = mProfile.audioBufferBursts;
+        return mTuningWatcher.start(TUNING_CONFIG_PATH, mTuning);
+    }, false, {config});
+    s.addStep("StartFlightRecorder", [this]() {
+        mFlightRecorder.start(FLIGHT_RECORDER_PATH);
+        return true; // optional as well
+    }, false);
+    s.addStep("StartStats", [this]() {
+        mStatsServer.start(STATS_SOCKET_NAME);
+        return true; // optional, streaming works without it
+    }, false);
+    auto vr = s.addStep("initVR", [this]() { return initVR(); }, true);
+    auto props = s.addStep("QueryDeviceProps", [this]() { return QueryDeviceProps(); }, false, {vr});
+    // Eye buffers are sized from the recommended render target size, the launch profile and the display rate
+    auto gl = s.addStep("initGL", [this]() { return initGL(); }, true, {vr, config, props});
+    // The playback buffer size comes from the profile or the tuning file
+    auto audio = s.addStep("OpenAudio", [this]() { return OpenAudio(); }, false, {config, tuning});
+    auto probe = s.addStep("ProbeServers", [this]() {
+        if (mServerProbe.candidateCount() > 1) mServerProbe.probe();
+        return true;
+    }, false, {config});
+    // The prediction offset is learned per server, so the server is picked first
+    auto desc = s.addStep("InitDeviceDesc", [this]() {
+        return InitCallbacks() && InitDeviceDesc();
+    }, true, {config, props, gl, probe});
+    auto receiver = s.addStep("InitReceiver", [this]() { return InitReceiver(); }, true, {desc});
+
+    // Connect before the audio streams are started, the request is async anyway.
+    // A refused request is retried from the main loop like a dropped connection,
+    // without a server to pick there is nothing to retry
+    auto connect = s.addStep("Connect", [this]() {
+        mInited = true;
+        if (!Connect()) {
+            return !mServerAddress.empty() && ScheduleReconnect();
+        }
+        return true;
+    }, true, {receiver, probe});
+    s.addStep("StartAudio", [this]() { return StartAudio(); }, true, {connect, audio});
+
+    bool ret = s.run();
+    s.logTimeline();
+    if (ret) {
+        LOGW("CloudXR initialization success");
+        mWatchdog.setBudgetMs(mTuning.stallBudgetMs);
+        mWatchdog.start();
+    }
+    return ret;
+}
+
 bool WaveCloudXRApp::initVR() {
     LOGI("Wave CloudXR Sample %s", VERSION_CODE);
 
@@ -172,6 +232,15 @@ bool WaveCloudXRApp::initVR() {
     WVR_SetInputRequest(WVR_DeviceType_Controller_Left, inputIdAndTypes, numAttribs);
     WVR_SetInputRequest(WVR_DeviceType_Controller_Right, inputIdAndTypes, numAttribs);
 
+    cxrControllerDesc controllerDesc = {};
+    controllerDesc.controllerName = "Oculus Touch";
+    //controllerDesc.controllerName = "vive_focus3_controller"; // CXR server does not recognize this name
+    // controllerDesc.controllerName = "VIVE FOCUS 3 Controller";
+    controllerDesc.inputCount = inputTouchLegacyCount;
+    controllerDesc.inputPaths = inputsTouchLegacy;
+    controllerDesc.inputValueTypes = inputValuesTouchLegacy;
+    mControllerManager.init(controllerDesc);
+
     // Init Wave Render
     WVR_RenderInitParams_t param;
     param = { WVR_GraphicsApiType_OpenGL, WVR_RenderConfig_Default };
@@ -189,55 +258,48 @@ bool WaveCloudXRApp::initGL() {
 
     gettimeofday(&mRtcTime, NULL);
 
-    // Setup stereo render targets
-    // WVR_GetRenderTargetSize(&mRenderWidth, &mRenderHeight);
-
-    // Focus 3 panel resolution
-    mRenderWidth = 2448;
-    mRenderHeight = 2448;
-    LOGD("Recommended size is %ux%u", mRenderWidth, mRenderHeight);
+    // Setup stereo render targets, the stream size comes from QueryDeviceProps()
+    SwapchainPlan plan = SwapchainPlanner::Plan(mStreamWidth, mStreamHeight, mProfile.maxResFactor,
+                                                mProfile.eyeBufferMB, SwapchainPlanner::EXPECTED_QUEUE_LENGTH);
+    mRenderWidth = plan.width;
+    mRenderHeight = plan.height;
     if (mRenderWidth == 0 || mRenderHeight == 0) {
         LOGE("Please check server configure");
         return false;
     }
 
-    mLeftEyeQ = WVR_ObtainTextureQueue(WVR_TextureTarget_2D, WVR_TextureFormat_RGBA, WVR_TextureType_UnsignedByte, mRenderWidth, mRenderHeight, 0);
-    for (int i = 0; i < WVR_GetTextureQueueLength(mLeftEyeQ); i++) {
-        GLuint fbo = CreateGLFramebuffer((GLuint)(size_t)WVR_GetTexture(mLeftEyeQ, i).id);
-        mLeftEyeFBO.push_back(fbo);
+    for (int eye = 0; eye < 2; eye++) {
+        if (!mEyeQueues[eye].allocate(mRenderWidth, mRenderHeight)) {
+            return false;
+        }
+        // The loading screen is a flat color, no need for full size eye buffers
+        if (!mLoadingQueues[eye].allocate(LOADING_TEXTURE_SIZE, LOADING_TEXTURE_SIZE)) {
+            return false;
+        }
     }
 
-    mRightEyeQ = WVR_ObtainTextureQueue(WVR_TextureTarget_2D, WVR_TextureFormat_RGBA, WVR_TextureType_UnsignedByte, mRenderWidth, mRenderHeight, 0);
-    for (int i = 0; i < WVR_GetTextureQueueLength(mRightEyeQ); i++) {
-        GLuint fbo = CreateGLFramebuffer((GLuint)(size_t)WVR_GetTexture(mRightEyeQ, i).id);
-        mRightEyeFBO.push_back(fbo);
-	}
+    // WVR picks the queue length, a longer queue than expected may not fit the budget
+    if (mEyeQueues[WVR_Eye_Left].length() != plan.queueLength) {
+        plan = SwapchainPlanner::Plan(mStreamWidth, mStreamHeight, mProfile.maxResFactor,
+                                      mProfile.eyeBufferMB, mEyeQueues[WVR_Eye_Left].length());
+        RecreateFramebuffer(plan.width, plan.height);
+    }
+    SwapchainPlanner::LogChoices(plan, mProfile.eyeBufferMB, mRefreshRate.displayHz());
 
     return true;
 }
 
-GLuint WaveCloudXRApp::CreateGLFramebuffer(const GLuint texId)
-{
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,
-                           GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0);
-
-    GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-
-    if (status != GL_FRAMEBUFFER_COMPLETE)
-    {
-        LOGE("Incomplete frame buffer object (%d). Requested dimensions: %d x %d.", status, mRenderWidth, mRenderHeight);
-    }
-    return fbo;
-}
-
 void WaveCloudXRApp::shutdownGL() {
     
     ReleaseFramebuffers();
+    for (int eye = 0; eye < 2; eye++) {
+        mLoadingQueues[eye].release();
+    }
+
+    if (EyeTextureQueue::LiveQueues() != 0 || EyeTextureQueue::LiveFramebuffers() != 0) {
+        LOGE("[Textures] Leaked %d texture queues and %d framebuffers",
+             EyeTextureQueue::LiveQueues(), EyeTextureQueue::LiveFramebuffers());
+    }
 }
 
 void WaveCloudXRApp::shutdownVR() {
@@ -245,6 +307,7 @@ void WaveCloudXRApp::shutdownVR() {
 }
 
 void WaveCloudXRApp::shutdownCloudXR() {
+    StallPhase phase(mWatchdog, Watched_Main, "shutdownCloudXR");
 
     if (mPlaybackStream)
     {
@@ -257,8 +320,18 @@ void WaveCloudXRApp::shutdownCloudXR() {
         mRecordStream->close();
         mRecordStream = nullptr;
     }
+    ThreadManager::Instance().unregisterRole(ThreadRole_Audio);
+    mRecordThreadRegistered = false;
+    mWatchdog.park(Watched_Mic);
+    mWatchdog.park(Watched_Speaker);
 
     if (mReceiver) {
+        mPredictionTuner.endSession();
+        mControllerManager.detach();
+        mStatsServer.setReceiver(nullptr);
+        // Handlers may still send, the dispatch thread is joined while the receiver is valid
+        mUserData.stop();
+        mUserDataTransport.setReceiver(nullptr);
         cxrDestroyReceiver(mReceiver);
         mReceiver = nullptr;
     }
@@ -269,6 +342,7 @@ void WaveCloudXRApp::shutdownCloudXR() {
 
 bool WaveCloudXRApp::HandleCloudXRLifecycle(const bool pause)
 {
+    StallPhase phase(mWatchdog, Watched_Main, "HandleCloudXRLifecycle");
     if (mPaused != pause) {
         if (pause) {
             Pause();
@@ -277,25 +351,24 @@ bool WaveCloudXRApp::HandleCloudXRLifecycle(const bool pause)
         }
     }
 
-    if (mStateDirty) {
+    LifecycleEvent event;
+    while (mLifecycleEvents.pop(event)) {
+        if (event.state == mClientState) {
+            continue;
+        }
+        LOGI("[Lifecycle] %s -> %s (%s), acted on after %.2f ms",
+             ClientStateEnumToString(mClientState), ClientStateEnumToString(event.state),
+             cxrErrorString(event.error), (LifecycleEventQueue::NowNs() - event.timeNs) / 1000000.0);
+        mFlightRecorder.recordLifecycle(mClientState, event.state, event.error, event.timeNs);
+        mClientState = event.state;
+
         switch (mClientState) {
             case cxrClientState_ReadyToConnect:
                 LOGI("Client is ready to connect.");
                 Connect();
                 break;
             case cxrClientState_Disconnected:
-                if (mRetryConnCount < mMaxRetryConnCount) {
-                    LOGE("Disconnected, reconnecting ... %d", mRetryConnCount);
-                    shutdownCloudXR();
-                    if (initCloudXR()) {
-                        mRetryConnCount++;
-                        Connect();
-                    } else {
-                        LOGE("Reinitialization failed, exiting app.");
-                        return false;
-                    }
-                } else {
-                    LOGE("Unrecoverable disconnection, exiting app. ");
+                if (!ScheduleReconnect()) {
                     return false;
                 }
                 break;
@@ -305,9 +378,52 @@ bool WaveCloudXRApp::HandleCloudXRLifecycle(const bool pause)
             default:
                 break;
         }
-        mStateDirty = false;
     }
 
+    if (mReconnectPending && !mServerProbe.probing()) {
+        mReconnectPending = false;
+        if (!Reconnect()) {
+            return false;
+        }
+    }
+
+    uint32_t dropped = mLifecycleEvents.takeDropped();
+    if (dropped > 0) {
+        LOGE("[Lifecycle] %u client state events lost, queue full", dropped);
+    }
+    return true;
+}
+
+bool WaveCloudXRApp::ScheduleReconnect() {
+    if (mRetryConnCount >= mMaxRetryConnCount) {
+        LOGE("Unrecoverable disconnection, exiting app. ");
+        return false;
+    }
+    // A refused Connect() has shut down already
+    if (mInited) {
+        LOGE("Disconnected, reconnecting ... %d", mRetryConnCount);
+        shutdownCloudXR();
+    } else {
+        LOGE("Connection refused, retrying ... %d", mRetryConnCount);
+    }
+    // Probe first, the device descriptor carries the picked server's prediction offset.
+    // That takes up to a second, so it runs off the main thread and Reconnect() waits
+    if (mServerProbe.candidateCount() > 1) {
+        mServerProbe.startProbe();
+    }
+    mReconnectPending = true;
+    return true;
+}
+
+bool WaveCloudXRApp::Reconnect() {
+    if (!initCloudXR()) {
+        LOGE("Reinitialization failed, exiting app.");
+        return false;
+    }
+    mRetryConnCount++;
+    if (!Connect()) {
+        return ScheduleReconnect();
+    }
     return true;
 }
 
@@ -316,6 +432,7 @@ bool WaveCloudXRApp::HandleCloudXRLifecycle(const bool pause)
 // Purpose: Poll events.  Quit application if return true.
 //-----------------------------------------------------------------------------
 bool WaveCloudXRApp::handleInput() {
+    StallPhase phase(mWatchdog, Watched_Main, "handleInput");
     // Process WVR events
     WVR_Event_t event;
     while(WVR_PollEventQueue(&event)) {
@@ -325,8 +442,33 @@ bool WaveCloudXRApp::handleInput() {
         }
 
         processVREvent(event);
+        if (mReplaying) {
+            continue;
+        }
+        mMotionRecorder.recordEvent(event);
         UpdateInput(event);
     }
+
+    // Controllers are registered for the whole stream, not on their first event
+    if (mConnected && mReceiver && !mControllerManager.attached()) {
+        mControllerManager.attach(mReceiver);
+    } else if (!mConnected && mControllerManager.attached()) {
+        mControllerManager.detach();
+    }
+    for (int hand = HAND_LEFT; hand <= HAND_RIGHT; hand++) {
+        mControllerManager.setHandTracked(hand, mHandTracker.tracked(hand));
+    }
+
+    if (mReplaying) {
+        std::vector<WVR_Event_t> events;
+        {
+            std::lock_guard<std::mutex> lock(mReplayEventMutex);
+            events.swap(mReplayEvents);
+        }
+        for (const WVR_Event_t& replayed : events) {
+            UpdateInput(replayed);
+        }
+    }
     UpdateAnalog();
 
     return true;
@@ -334,18 +476,8 @@ bool WaveCloudXRApp::handleInput() {
 
 void WaveCloudXRApp::ReleaseFramebuffers()
 {
-    if (mLeftEyeQ != 0) {
-        for (int i = 0; i < WVR_GetTextureQueueLength(mLeftEyeQ); i++) {
-            glDeleteFramebuffers(1, &mLeftEyeFBO.at(i));
-        }
-        WVR_ReleaseTextureQueue(mLeftEyeQ);
-    }
-
-    if (mRightEyeQ != 0) {
-        for (int i = 0; i < WVR_GetTextureQueueLength(mRightEyeQ); i++) {
-            glDeleteFramebuffers(1, &mRightEyeFBO.at(i));
-        }
-        WVR_ReleaseTextureQueue(mRightEyeQ);
+    for (int eye = 0; eye < 2; eye++) {
+        mEyeQueues[eye].release();
     }
 }
 
@@ -354,18 +486,8 @@ void WaveCloudXRApp::RecreateFramebuffer(const uint32_t width, const uint32_t he
     if (mRenderWidth == width && mRenderHeight == height)
         return;
 
-    ReleaseFramebuffers();
-
-    mLeftEyeQ = WVR_ObtainTextureQueue(WVR_TextureTarget_2D, WVR_TextureFormat_RGBA, WVR_TextureType_UnsignedByte, width, height, 0);
-    for (int i = 0; i < WVR_GetTextureQueueLength(mLeftEyeQ); i++) {
-        GLuint fbo = CreateGLFramebuffer((GLuint)(size_t)WVR_GetTexture(mLeftEyeQ, i).id);
-        mLeftEyeFBO.push_back(fbo);
-    }
-
-    mRightEyeQ = WVR_ObtainTextureQueue(WVR_TextureTarget_2D, WVR_TextureFormat_RGBA, WVR_TextureType_UnsignedByte, width, height, 0);
-    for (int i = 0; i < WVR_GetTextureQueueLength(mRightEyeQ); i++) {
-        GLuint fbo = CreateGLFramebuffer((GLuint)(size_t)WVR_GetTexture(mRightEyeQ, i).id);
-        mRightEyeFBO.push_back(fbo);
+    for (int eye = 0; eye < 2; eye++) {
+        mEyeQueues[eye].allocate(width, height);
     }
 
     mRenderWidth = width;
@@ -377,6 +499,10 @@ void WaveCloudXRApp::RecreateFramebuffer(const uint32_t width, const uint32_t he
 // Purpose: Processes a single VR event
 //-----------------------------------------------------------------------------
 void WaveCloudXRApp::processVREvent(const WVR_Event_t & event) {
+    if (mControllerManager.onEvent(event)) {
+        return;
+    }
+
     switch(event.common.type) {
     case WVR_EventType_IpdChanged:
         {
@@ -411,9 +537,28 @@ void WaveCloudXRApp::processVREvent(const WVR_Event_t & event) {
     }
 }
 bool WaveCloudXRApp::renderFrame() {
+    BeatMain();
+    StallPhase phase(mWatchdog, Watched_Main, "renderFrame");
+    ApplyTuning();
+    // Tuning changes may allocate, the rest of the frame must not
+    NoAllocScope noAlloc("renderFrame");
     updateTime();
+    ThreadManager::Instance().tick();
+    // Messages written since the last frame leave as one batch
+    {
+        StallPhase flushPhase(mWatchdog, Watched_Main, "UserDataChannel::flush");
+        mUserData.flush();
+    }
 
+    mFlightFrame = FlightFrame();
     bool frameValid = UpdateFrame();
+    mConsecutiveMisses = frameValid ? 0 : mConsecutiveMisses + 1;
+    mFlightFrame.misses = (uint16_t)std::min(mConsecutiveMisses, 0xffffu);
+    mFlightFrameFlags = frameValid ? FlightFrame_Valid : 0;
+    mStallMetrics.fps = mFPS;
+    mStallMetrics.consecutiveMisses = mConsecutiveMisses;
+    mStallMetrics.clientState = ClientStateEnumToString(mClientState);
+    mWatchdog.setMetrics(mStallMetrics);
     if (!frameValid) {
         // Exit program when no valid frame for too long
         mFrameInvalidTime += mTimeDiff;
@@ -424,18 +569,58 @@ bool WaveCloudXRApp::renderFrame() {
     } else {
         mFrameInvalidTime = 0.0f;
 
+        if (!mFirstFrameLogged) {
+            LOGI("First valid frame %.1f ms after launch", mStartup.elapsedUs() / 1000.0f);
+            mFirstFrameLogged = true;
+        }
+
         CheckStreamQuality();
     }
 
+    FrameCounters counters;
+    if (!mIdle && mFrameTracker.poll(counters)) {
+        ClientMetrics metrics;
+        metrics.renderFps = mFPS;
+        metrics.frames = counters;
+        mStatsServer.setClientMetrics(metrics);
+
+        LOGI("[Frames] %u frames, interval avg %.1f max %.1f ms, drops %u repeats %u late %u misses %u (concealed %u) resolution changes %u",
+             counters.frames, counters.avgIntervalMs, counters.maxIntervalMs, counters.drops,
+             counters.repeats, counters.late, counters.misses, counters.concealed, counters.resolutionChanges);
+        if (counters.drops || counters.repeats || counters.late) {
+            mFrameTracker.logTimeline(16);
+        }
+
+        if (mRefreshRate.update(counters, mServerFps)) {
+            ApplyRefreshRate();
+        }
+    }
+
+    UpdateIdleState(!frameValid && IsIdle());
+    if (mIdle) {
+        RenderIdleFrame();
+        WaitIdleFrame();
+        return true;
+    }
+
+    // Both eyes or neither, a latched frame still goes back to CloudXR
+    EyeTextureQueue::Slot* left = mEyeQueues[WVR_Eye_Left].acquire();
+    EyeTextureQueue::Slot* right = mEyeQueues[WVR_Eye_Right].acquire();
+    if (left == nullptr || right == nullptr) {
+        if (frameValid && mReceiver && mConnected) {
+            StallPhase releasePhase(mWatchdog, Watched_Main, "cxrReleaseFrame");
+            cxrReleaseFrame(mReceiver, &mFramesLatched);
+        }
+        return true;
+    }
+
     /*
      * Render & Submit
      * Left Eye
      * */
-    int32_t leftIdx = WVR_GetAvailableTextureIndex(mLeftEyeQ);
-    GLuint fbo = mLeftEyeFBO.at(leftIdx);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, left->fbo);
 
-    WVR_TextureParams_t leftEyeTexture = WVR_GetTexture(mLeftEyeQ, leftIdx);
+    WVR_TextureParams_t leftEyeTexture = left->texture;
 
     glViewport(0, 0, mRenderWidth, mRenderHeight);
     glScissor(0, 0, mRenderWidth, mRenderHeight);
@@ -443,17 +628,15 @@ bool WaveCloudXRApp::renderFrame() {
     WVR_RenderMask(WVR_Eye_Left);
 
     glClear(GL_COLOR_BUFFER_BIT);
-    Render(WVR_Eye_Left, leftEyeTexture, frameValid);
+    Render(WVR_Eye_Left, *left, frameValid);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
     /*
      * Render & Submit
      * Right Eye
      * */
-    int32_t rightIdx = WVR_GetAvailableTextureIndex(mRightEyeQ);
-    fbo = mRightEyeFBO.at(rightIdx);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
-    WVR_TextureParams_t rightEyeTexture = WVR_GetTexture(mRightEyeQ, rightIdx);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, right->fbo);
+    WVR_TextureParams_t rightEyeTexture = right->texture;
 
     glViewport(0, 0, mRenderWidth, mRenderHeight);
     glScissor(0, 0, mRenderWidth, mRenderHeight);
@@ -461,8 +644,13 @@ bool WaveCloudXRApp::renderFrame() {
     WVR_RenderMask(WVR_Eye_Right);
 
     glClear(GL_COLOR_BUFFER_BIT);
-    Render(WVR_Eye_Right, rightEyeTexture, frameValid);
+    Render(WVR_Eye_Right, *right, frameValid);
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    if (frameValid) {
+        mPoseLatency.onSubmitted();
+        mPredictionTuner.onSubmitted();
+    }
+    mFlightRecorder.recordFrame(mFlightFrame, mFlightFrameFlags);
 
     // Clear
     {
@@ -498,6 +686,14 @@ void WaveCloudXRApp::updateTime() {
         mFPS = mFrameCount / (mTimeAccumulator2S / 1000000.0f);
         LOGI("FPS %2.0f, UpdatePose: %d, GetPose: %d", mFPS, updatePoseCount, getPoseCount);
 
+        cxrConnectionStats stats = {};
+        mServerFps = 0.0f;
+        if (mReceiver && mConnected && cxrGetConnectionStats(mReceiver, &stats) == cxrError_Success) {
+            mFlightRecorder.recordStats(stats);
+            mPredictionTuner.addSample((float)stats.roundTripDelayMs, stats.jitterUs / 1000.0f, mRefreshRate.displayHz());
+            mServerFps = stats.framesPerSecond;
+        }
+
         updatePoseCount = 0;
         getPoseCount = 0;
         mFrameCount = 0;
@@ -505,15 +701,121 @@ void WaveCloudXRApp::updateTime() {
     }
 }
 
+// Apply tuning changes at a frame boundary so a frame never sees half of them
+void WaveCloudXRApp::ApplyTuning() {
+    StallPhase phase(mWatchdog, Watched_Main, "ApplyTuning");
+    TuningParams params;
+    if (!mTuningWatcher.fetch(params)) {
+        return;
+    }
+
+    // Also in the metrics streams, to line up with what the change did
+    TuningParams::LogChanges(mTuning, params, [this](const TuningChange& change) {
+        mFlightRecorder.recordTuning(change.id, change.from, change.to, change.fromText != nullptr);
+        char event[80];
+        if (change.fromText) {
+            snprintf(event, sizeof(event), "tuning %s \"%s\"->\"%s\"", change.name, change.fromText, change.toText);
+        } else {
+            snprintf(event, sizeof(event), "tuning %s %u->%u", change.name, change.from, change.to);
+        }
+        mStatsServer.addEvent(event);
+    });
+    TuningParams old = mTuning;
+    {
+        std::lock_guard<std::mutex> lock(mPoseMutex);
+        mTuning = params;
+    }
+
+    ThreadManager& threads = ThreadManager::Instance();
+    if (mTuning.threadRender != old.threadRender) threads.setPolicy(ThreadRole_Render, mTuning.threadRender);
+    if (mTuning.threadPose != old.threadPose) threads.setPolicy(ThreadRole_Pose, mTuning.threadPose);
+    if (mTuning.threadAudio != old.threadAudio) threads.setPolicy(ThreadRole_Audio, mTuning.threadAudio);
+    if (mTuning.threadWorker != old.threadWorker) threads.setPolicy(ThreadRole_Worker, mTuning.threadWorker);
+    mWatchdog.setBudgetMs(mTuning.stallBudgetMs);
+    mMicUplink.setGateDb(mTuning.micGateDb);
+
+    if (mTuning.replayMotionPct != old.replayMotionPct) {
+        StopMotionReplay();
+        if (mTuning.replayMotionPct > 0) StartMotionReplay(mTuning.replayMotionPct);
+    }
+    if (mTuning.recordMotion != old.recordMotion) {
+        if (mTuning.recordMotion && !mReplaying) mMotionRecorder.start(MOTION_RECORDING_PATH);
+        else mMotionRecorder.stop();
+    }
+
+    if (mPlaybackStream && mTuning.audioBufferBursts != old.audioBufferBursts) {
+        int bufferSizeFrames = mPlaybackStream->getFramesPerBurst() * mTuning.audioBufferBursts;
+        oboe::Result r = mPlaybackStream->setBufferSizeInFrames(bufferSizeFrames);
+        if (r != oboe::Result::OK) {
+            LOGE("[Tuning] Failed to set playback stream buffer size to: %d. Error: %s",
+                 bufferSizeFrames, oboe::convertToText(r));
+        }
+    }
+}
+
 void  WaveCloudXRApp::beginPoseStream() {
     if (mPoseStream == nullptr) {
         mPoseStream = new std::thread(&WaveCloudXRApp::updatePose, this);
     }
 }
 
+void WaveCloudXRApp::StartMotionReplay(const uint32_t speedPct) {
+    if (!mMotionReplayer.open(MOTION_RECORDING_PATH)) {
+        return;
+    }
+    mMotionRecorder.stop();
+
+    mReplaying = true;
+    mReplayThread = new std::thread([this, speedPct]() {
+        ThreadManager::Instance().registerCurrent(ThreadRole_Pose, "cxr-replay");
+        LOGI("[Motion] Replay started at %u%%", speedPct);
+
+        uint32_t count = mMotionReplayer.run(speedPct / 100.0f,
+            [this](WVR_DeviceType device, const WVR_PoseState_t& pose) {
+                std::lock_guard<std::mutex> lock(mPoseMutex);
+                if (device == WVR_DeviceType_HMD) {
+                    mHmdPose = pose;
+                    UpdateHMDPose(mHmdPose);
+                } else {
+                    int idx = (device == WVR_DeviceType_Controller_Left) ? 0 : 1;
+                    mCtrlPoses[idx] = pose;
+                    UpdateDevicePose(device, mCtrlPoses[idx]);
+                }
+            },
+            [this](const WVR_Event_t& event) {
+                // UpdateInput belongs to the render thread, see handleInput()
+                std::lock_guard<std::mutex> lock(mReplayEventMutex);
+                mReplayEvents.push_back(event);
+            });
+
+        LOGI("[Motion] Replay done, %u records", count);
+        mReplaying = false;
+        ThreadManager::Instance().unregisterCurrent();
+    });
+}
+
+void WaveCloudXRApp::StopMotionReplay() {
+    if (mReplayThread != nullptr) {
+        mMotionReplayer.stop();
+        if (mReplayThread->joinable()) {
+            mReplayThread->join();
+        }
+        delete mReplayThread;
+        mReplayThread = nullptr;
+    }
+    mMotionReplayer.close();
+    mReplaying = false;
+}
+
 void  WaveCloudXRApp::stopPoseStream() {
+    // The main loop is over, shutdown takes as long as it takes
+    mWatchdog.stop();
+    StopMotionReplay();
+    mMotionRecorder.stop();
+
     if(mPoseStream!=nullptr) {
         mExitPoseStream = true;
+        mIdleCond.notify_all();
         if(mPoseStream->joinable()) {
            mPoseStream->join();
            delete mPoseStream;
@@ -523,36 +825,96 @@ void  WaveCloudXRApp::stopPoseStream() {
 }
 // 1 sec = 1,000ms = 1,000,000,000ns
 void WaveCloudXRApp::updatePose() {
-    // Update pose 250 per second by default
-    int deno = (mDeviceDesc.posePollFreq == 0) ? 250 : mDeviceDesc.posePollFreq;
-    long long int sleepNs = 1000000000 / deno;
-    LOGI("PoseStream Update per %lldns", sleepNs);
+    // Each device is sampled between poseMinHz and posePollHz by its motion, see PoseSampler
+    uint32_t pollHz = 0;
+    uint32_t minHz = 0;
+    int64_t wakeNs = 0;
+    ThreadManager::Instance().registerCurrent(ThreadRole_Pose, "cxr-pose");
 
     while (!mExitPoseStream) {
 
         while (mInited && mConnected)
         {
-            std::lock_guard<std::mutex> lock(mPoseMutex);
+            ThreadManager::Instance().tick();
+            mWatchdog.beat(Watched_Pose);
             {
-                WVR_PoseOriginModel pom = WVR_PoseOriginModel_OriginOnGround;
-                // Returns immediately with latest pose
-                WVR_GetPoseState(WVR_DeviceType_HMD, pom, 0, &mHmdPose);
-                UpdateHMDPose(mHmdPose);
+                NoAllocScope noAlloc("updatePose");
+                StallPhase phase(mWatchdog, Watched_Pose, "WVR_GetPoseState");
+                std::lock_guard<std::mutex> lock(mPoseMutex);
+                int64_t now = PoseSampler::NowNs();
+                if (pollHz != mTuning.posePollHz || minHz != mTuning.poseMinHz) {
+                    pollHz = mTuning.posePollHz;
+                    minHz = mTuning.poseMinHz;
+                    mPoseSampler.configure(minHz, pollHz);
+                    mPoseSampler.reset(now);
+                    LOGI("PoseStream Update at %u-%u Hz per device", mPoseSampler.floorHz(), pollHz);
+                }
+                uint32_t predictMs = mTuning.posePredictionMs;
+                {
+                    StallPhase handPhase(mWatchdog, Watched_Pose, "HandTracker");
+                    mHandTracker.update(mTuning.handRateHz, mUserData);
+                }
 
-                pom = mIs6DoFHMD ? WVR_PoseOriginModel_OriginOnGround
-                                 : WVR_PoseOriginModel_OriginOnHead_3DoF;
+                if (!mReplaying) {
+                    // Devices not due keep their last pose in mCXRPoseState
+                    WVR_PoseOriginModel pom = WVR_PoseOriginModel_OriginOnGround;
+                    if (mPoseSampler.due(PoseSource_HMD, now)) {
+                        // Returns immediately with latest pose
+                        WVR_GetPoseState(WVR_DeviceType_HMD, pom, predictMs, &mHmdPose);
+                        mMotionRecorder.recordPose(WVR_DeviceType_HMD, mHmdPose);
+                        UpdateHMDPose(mHmdPose);
+                        int64_t end = PoseSampler::NowNs();
+                        mPoseSampler.onSample(PoseSource_HMD, mHmdPose, end, end - now);
+                        now = end;
+                    }
 
-                WVR_GetPoseState(WVR_DeviceType_Controller_Left, pom, 0, &mCtrlPoses[0]);
-                UpdateDevicePose(WVR_DeviceType_Controller_Left, mCtrlPoses[0]);
+                    pom = mIs6DoFHMD ? WVR_PoseOriginModel_OriginOnGround
+                                     : WVR_PoseOriginModel_OriginOnHead_3DoF;
+
+                    // A tracked hand stands in for a controller that is not connected
+                    if (mPoseSampler.due(PoseSource_Left, now)) {
+                        WVR_GetPoseState(WVR_DeviceType_Controller_Left, pom, predictMs, &mCtrlPoses[0]);
+                        if (!mControllerManager.connected(0)) mHandTracker.palmPose(0, mCtrlPoses[0]);
+                        mMotionRecorder.recordPose(WVR_DeviceType_Controller_Left, mCtrlPoses[0]);
+                        UpdateDevicePose(WVR_DeviceType_Controller_Left, mCtrlPoses[0]);
+                        int64_t end = PoseSampler::NowNs();
+                        mPoseSampler.onSample(PoseSource_Left, mCtrlPoses[0], end, end - now);
+                        now = end;
+                    }
 
-                WVR_GetPoseState(WVR_DeviceType_Controller_Right, pom, 0, &mCtrlPoses[1]);
-                UpdateDevicePose(WVR_DeviceType_Controller_Right, mCtrlPoses[1]);
+                    if (mPoseSampler.due(PoseSource_Right, now)) {
+                        WVR_GetPoseState(WVR_DeviceType_Controller_Right, pom, predictMs, &mCtrlPoses[1]);
+                        if (!mControllerManager.connected(1)) mHandTracker.palmPose(1, mCtrlPoses[1]);
+                        mMotionRecorder.recordPose(WVR_DeviceType_Controller_Right, mCtrlPoses[1]);
+                        UpdateDevicePose(WVR_DeviceType_Controller_Right, mCtrlPoses[1]);
+                        int64_t end = PoseSampler::NowNs();
+                        mPoseSampler.onSample(PoseSource_Right, mCtrlPoses[1], end, end - now);
+                        now = end;
+                    }
+                    wakeNs = mPoseSampler.nextDueNs();
+                } else {
+                    wakeNs = now + 1000000000LL / pollHz;
+                }
+                // Hand joints still go out at their own rate while every device is slow
+                uint32_t floorHz = mPoseSampler.floorHz();
+                uint32_t tickHz = floorHz > mTuning.handRateHz ? floorHz : mTuning.handRateHz;
+                if (tickHz > 0 && wakeNs > now + 1000000000LL / tickHz) wakeNs = now + 1000000000LL / tickHz;
                 updatePoseCount++;
             }
-            std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNs));
+            int64_t sleepNs = wakeNs - PoseSampler::NowNs();
+            if (sleepNs > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(sleepNs));
         }
+        mHandTracker.stop();
+        mWatchdog.park(Watched_Pose);
+
+        // Nothing to send while not streaming, sleep until the client state changes
+        std::unique_lock<std::mutex> lock(mIdleMutex);
+        mIdleCond.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return mExitPoseStream || (mInited && mConnected);
+        });
     }
 
+    ThreadManager::Instance().unregisterCurrent();
     LOGI("PoseStream end");
 }
 
@@ -588,6 +950,7 @@ WVR_Vector3f Convert(const cxrVector3& vec)
 // Make sure storage permission is granted before LoadConfig() and InitReceiver()
 // Make sure WaveVR is initialized before InitDeviceDesc()
 bool WaveCloudXRApp::initCloudXR() {
+    StallPhase phase(mWatchdog, Watched_Main, "initCloudXR");
 
     if (mInited) {
         return true;
@@ -595,6 +958,7 @@ bool WaveCloudXRApp::initCloudXR() {
 
     if (!LoadConfig()) return false;
     if (!InitCallbacks()) return false;
+    if (!QueryDeviceProps()) return false;
     if (!InitDeviceDesc()) return false;
     if (!InitReceiver()) return false;
     if (!InitAudio()) return false;
@@ -606,13 +970,32 @@ bool WaveCloudXRApp::initCloudXR() {
 
 bool WaveCloudXRApp::LoadConfig() {
 
-    ParseStatus result = mOptions.ParseFile("/sdcard/CloudXRLaunchOptions.txt");
+    // Client profile options are split out, CloudXR's parser rejects unknown flags
+    std::string cloudXRArgs;
+    std::vector<std::string> clientArgs;
+    ParseStatus result = ParseStatus_FileNotFound;
+    if (ClientProfile::ReadLaunchOptions(LAUNCH_OPTIONS_PATH, cloudXRArgs, clientArgs)) {
+        result = mOptions.ParseString(cloudXRArgs);
+    }
+
+    if (result == ParseStatus_Success) {
+        ClientProfile profile;
+        profile.maxResFactor = mOptions.mMaxResFactor;
+        profile.foveation = (mOptions.mFoveation < 100) ? mOptions.mFoveation : 0;
+        if (!profile.apply(clientArgs)) {
+            result = ParseStatus_BadVal;
+        } else {
+            mProfile = profile;
+            mProfile.log();
+        }
+    }
 
     bool ret = false;
     switch(result)
     {
         case ParseStatus_Success:
             LOGI("Loaded server IP from config: %s", mOptions.mServerIP.c_str());
+            mServerProbe.setCandidates(ServerProbe::SplitServerList(mOptions.mServerIP));
             ret = true;
             break;
         case ParseStatus_FileNotFound:
@@ -643,10 +1026,10 @@ bool WaveCloudXRApp::InitCallbacks() {
     {
         return reinterpret_cast<WaveCloudXRApp*>(context)->RenderAudio(audioFrame);
     };
-    //mClientCallbacks.ReceiveUserData = [](void* context, const void* data, uint32_t size)
-    //{
-    //    return reinterpret_cast<CloudXRStream*>(context)->ReceiveUserData(data, size);
-    //};
+    mClientCallbacks.ReceiveUserData = [](void* context, const void* data, uint32_t size)
+    {
+        return reinterpret_cast<WaveCloudXRApp*>(context)->mUserData.receive(data, size);
+    };
 
     mClientCallbacks.UpdateClientState = [](void* context, cxrClientState state, cxrError error)
     {
@@ -685,7 +1068,13 @@ bool WaveCloudXRApp::InitCallbacks() {
 
 bool WaveCloudXRApp::InitAudio() {
 
-    if (mDeviceDesc.receiveAudio)
+    return OpenAudio() && StartAudio();
+}
+
+// Safe to call from a worker thread once mTuning is loaded, only reads mOptions and mTuning
+bool WaveCloudXRApp::OpenAudio() {
+
+    if (mOptions.mReceiveAudio)
     {
         // Initialize audio playback
         oboe::AudioStreamBuilder playbackStreamBuilder;
@@ -703,22 +1092,16 @@ bool WaveCloudXRApp::InitAudio() {
             return false;
         }
 
-        int bufferSizeFrames = mPlaybackStream->getFramesPerBurst() * 2;
+        int bufferSizeFrames = mPlaybackStream->getFramesPerBurst() * mTuning.audioBufferBursts;
         r = mPlaybackStream->setBufferSizeInFrames(bufferSizeFrames);
         if (r != oboe::Result::OK) {
             LOGE("Failed to set playback stream buffer size to: %d. Error: %s",
                  bufferSizeFrames, oboe::convertToText(r));
             return false;
         }
-
-        r = mPlaybackStream->start();
-        if (r != oboe::Result::OK) {
-            LOGE("Failed to start playback stream. Error: %s", oboe::convertToText(r));
-            return false;
-        }
     }
 
-    if (mDeviceDesc.sendAudio)
+    if (mOptions.mSendAudio)
     {
         // Initialize audio recording
         oboe::AudioStreamBuilder recordingStreamBuilder;
@@ -726,7 +1109,8 @@ bool WaveCloudXRApp::InitAudio() {
         recordingStreamBuilder.setPerformanceMode(oboe::PerformanceMode::LowLatency);
         recordingStreamBuilder.setSharingMode(oboe::SharingMode::Exclusive);
         recordingStreamBuilder.setFormat(oboe::AudioFormat::I16);
-        recordingStreamBuilder.setChannelCount(oboe::ChannelCount::Stereo);
+        // Voice is mono, MicUplink duplicates the blocks it sends to the channels CloudXR takes
+        recordingStreamBuilder.setChannelCount(oboe::ChannelCount::Mono);
         recordingStreamBuilder.setSampleRate(CXR_AUDIO_SAMPLING_RATE);
         recordingStreamBuilder.setInputPreset(oboe::InputPreset::VoiceCommunication);
         recordingStreamBuilder.setDataCallback(this);
@@ -735,37 +1119,117 @@ bool WaveCloudXRApp::InitAudio() {
         if (r != oboe::Result::OK) {
             LOGE("Failed to open recording stream. Error: %s", oboe::convertToText(r));
             LOGE("Continuing to run, without recording ability.");
-            mDeviceDesc.sendAudio = false;
+            mRecordStream = nullptr;
         } else {
-            r = mRecordStream->start();
-            if (r != oboe::Result::OK)
-            {
-                LOGE("Failed to start recording stream. Error: %s", oboe::convertToText(r));
-                LOGE("Continuing to run, without recording ability.");
-                mRecordStream->close();
-                mDeviceDesc.sendAudio = false;
-            }
+            mMicUplink.prepare(mRecordStream->getChannelCount(), mRecordStream->getBufferCapacityInFrames());
         }
     }
 
     return true;
 }
 
+// Record callback sends to mReceiver, so this runs after InitReceiver()
+bool WaveCloudXRApp::StartAudio() {
+
+    if (mPlaybackStream)
+    {
+        oboe::Result r = mPlaybackStream->start();
+        if (r != oboe::Result::OK) {
+            LOGE("Failed to start playback stream. Error: %s", oboe::convertToText(r));
+            return false;
+        }
+    }
+
+    if (mRecordStream)
+    {
+        oboe::Result r = mRecordStream->start();
+        if (r != oboe::Result::OK)
+        {
+            LOGE("Failed to start recording stream. Error: %s", oboe::convertToText(r));
+            LOGE("Continuing to run, without recording ability.");
+            mRecordStream->close();
+            mRecordStream = nullptr;
+        }
+    }
+
+    if (mDeviceDesc.sendAudio && !mRecordStream) {
+        mDeviceDesc.sendAudio = false;
+    }
+
+    return true;
+}
+
+// Display, pose sampling and the stream rate of the next receiver follow mRefreshRate
+void WaveCloudXRApp::ApplyRefreshRate() {
+    StallPhase refreshPhase(mWatchdog, Watched_Main, "DisplayRefresh::Request");
+    AllocAllowedScope allowed;
+    if (!DisplayRefresh::Request(mRefreshRate.displayHz())) {
+        LOGW("[Refresh] Display rate change to %.0f Hz not available", mRefreshRate.displayHz());
+    }
+    mPoseSampler.setDisplayHz(mRefreshRate.displayHz());
+    // CloudXR takes the stream rate when the receiver is created
+    for (uint32_t i = 0; i < mDeviceDesc.numVideoStreamDescs; i++) {
+        mDeviceDesc.videoStreamDescs[i].fps = mRefreshRate.streamFps();
+    }
+    mFrameTracker.reset(mRefreshRate.streamFps());
+}
+
+// WVR queries only, safe to run off the main thread once WVR is initialized
+bool WaveCloudXRApp::QueryDeviceProps() {
+    WVR_GetRenderProps(&mRenderProps);
+
+    // The recommended eye render target size is requested as the stream size
+    uint32_t width = 0, height = 0;
+    WVR_GetRenderTargetSize(&width, &height);
+    if (width == 0 || height == 0) {
+        LOGW("No recommended render target size, using %ux%u", FALLBACK_STREAM_SIZE, FALLBACK_STREAM_SIZE);
+        width = height = FALLBACK_STREAM_SIZE;
+    }
+    mStreamWidth = width;
+    mStreamHeight = height;
+    LOGD("Recommended size is %ux%u", mStreamWidth, mStreamHeight);
+
+    // Once, a reconnect keeps what was learned about the server
+    if (!mRefreshRate.initialized()) {
+        float rates[DisplayRefresh::MAX_RATES];
+        uint32_t rateCount = DisplayRefresh::SupportedRates(rates, DisplayRefresh::MAX_RATES);
+        mRefreshRate.init(rates, rateCount, mRenderProps.refreshRate);
+        mPoseSampler.setDisplayHz(mRefreshRate.displayHz());
+    }
+
+    float l,r,t,b;
+    for (int i=0; i<2; ++i) {
+        WVR_GetClippingPlaneBoundary((WVR_Eye)i, &l, &r, &t, &b);
+        mClippingPlanes[i][0] = l;
+        mClippingPlanes[i][1] = r;
+        mClippingPlanes[i][2] = t;
+        mClippingPlanes[i][3] = b;
+    }
+
+    mArena = WVR_GetArena();
+    return true;
+}
+
+// Make sure QueryDeviceProps() is called before
 bool WaveCloudXRApp::InitDeviceDesc() {
-    WVR_RenderProps_t props;
-    WVR_GetRenderProps(&props);
+    const WVR_RenderProps_t& props = mRenderProps;
+
+    // A step up waits for a new receiver, the server streams at most the rate it asked for
+    if (mRefreshRate.beginSession()) {
+        ApplyRefreshRate();
+    }
 
     mDeviceDesc.numVideoStreamDescs = CXR_NUM_VIDEO_STREAMS_XR;
     for (uint32_t i = 0; i < mDeviceDesc.numVideoStreamDescs; i++) {
         mDeviceDesc.videoStreamDescs[i].format = cxrClientSurfaceFormat_RGB;
-        mDeviceDesc.videoStreamDescs[i].width = mRenderWidth;
-        mDeviceDesc.videoStreamDescs[i].height = mRenderHeight;
-        mDeviceDesc.videoStreamDescs[i].fps = props.refreshRate;
+        mDeviceDesc.videoStreamDescs[i].width = mStreamWidth;
+        mDeviceDesc.videoStreamDescs[i].height = mStreamHeight;
+        mDeviceDesc.videoStreamDescs[i].fps = mRefreshRate.streamFps();
         mDeviceDesc.videoStreamDescs[i].maxBitrate = mOptions.mMaxVideoBitrate;
     }
 
     mDeviceDesc.stereoDisplay = true;
-    mDeviceDesc.maxResFactor = mOptions.mMaxResFactor;
+    mDeviceDesc.maxResFactor = mProfile.maxResFactor;
 
     mDeviceDesc.ipd = props.ipdMeter;
     mDeviceDesc.receiveAudio = mOptions.mReceiveAudio;
@@ -774,13 +1238,16 @@ bool WaveCloudXRApp::InitDeviceDesc() {
 
     mDeviceDesc.disablePosePrediction = false;
     mDeviceDesc.angularVelocityInDeviceSpace = true;
-    mDeviceDesc.foveatedScaleFactor = (mOptions.mFoveation < 100) ? mOptions.mFoveation : 0;
+    mDeviceDesc.foveatedScaleFactor = mProfile.foveation;
     mDeviceDesc.disableVVSync = false;
 
     // Frustum
     float l,r,t,b;
     for (int i=0; i<2; ++i) {
-        WVR_GetClippingPlaneBoundary((WVR_Eye)i, &l, &r, &t, &b);
+        l = mClippingPlanes[i][0];
+        r = mClippingPlanes[i][1];
+        t = mClippingPlanes[i][2];
+        b = mClippingPlanes[i][3];
         if(l < 0) l *= -1;
         if(r < 0) r *= -1;
         if(t < 0) t *= -1;
@@ -791,7 +1258,9 @@ bool WaveCloudXRApp::InitDeviceDesc() {
         mDeviceDesc.proj[i][3] = t;
     }
 
-    mDeviceDesc.predOffset = 0.01f;
+    mPredOffsetMs = mProfile.autoPredOffset ?
+            mPredictionTuner.offsetMsFor(mServerProbe.best(), mProfile.predOffsetMs) : mProfile.predOffsetMs;
+    mDeviceDesc.predOffset = mPredOffsetMs / 1000.0f;
 
     // Set up server chaperone play area
     mDeviceDesc.chaperone.universe = cxrUniverseOrigin_Standing;
@@ -800,7 +1269,7 @@ bool WaveCloudXRApp::InitDeviceDesc() {
     mDeviceDesc.chaperone.origin.m[1][0] = mDeviceDesc.chaperone.origin.m[1][2] = mDeviceDesc.chaperone.origin.m[1][3] = 0;
     mDeviceDesc.chaperone.origin.m[2][0] = mDeviceDesc.chaperone.origin.m[2][1] = mDeviceDesc.chaperone.origin.m[2][3] = 0;
 
-    WVR_Arena_t arena = WVR_GetArena();
+    const WVR_Arena_t& arena = mArena;
     if (arena.shape == WVR_ArenaShape_Round)
     {
         mDeviceDesc.chaperone.playArea.v[0] = arena.area.round.diameter;
@@ -858,10 +1327,15 @@ bool WaveCloudXRApp::InitReceiver() {
     }
 
     LOGV("Receiver created!");
+    mFlightRecorder.beginSession();
+    mStatsServer.setReceiver(mReceiver);
+    mUserDataTransport.setReceiver(mReceiver);
+    mUserData.start(&mUserDataTransport);
     return true;
 }
 
 bool WaveCloudXRApp::Connect(const bool async) {
+    StallPhase phase(mWatchdog, Watched_Main, "Connect");
 
     if (mConnected) {
         LOGE("Already connected");
@@ -873,7 +1347,8 @@ bool WaveCloudXRApp::Connect(const bool async) {
         return false;
     }
 
-    if (mOptions.mServerIP.empty()) {
+    mServerAddress = mServerProbe.pick();
+    if (mServerAddress.empty()) {
         LOGE("Server IP is not specified.");
         return false;
     }
@@ -882,17 +1357,19 @@ bool WaveCloudXRApp::Connect(const bool async) {
     mConnectionDesc.useL4S = mOptions.mUseL4S; // Low Latency, Low Loss, and Scalable Throughput
     mConnectionDesc.clientNetwork = mOptions.mClientNetwork;
     mConnectionDesc.topology = mOptions.mTopology;
-    cxrError err = cxrConnect(mReceiver, mOptions.mServerIP.c_str(), &mConnectionDesc);
-    std::string constr = async ? "Connection request sent" : "Connection" ;
+    cxrError err = cxrConnect(mReceiver, mServerAddress.c_str(), &mConnectionDesc);
+    const char* constr = async ? "Connection request sent" : "Connection";
     if (err != cxrError_Success) {
         LOGE("%s failed, %s. Error %d, %s.",
-             constr.c_str(),
-             mOptions.mServerIP.c_str(), (int) err, cxrErrorString(err));
+             constr,
+             mServerAddress.c_str(), (int) err, cxrErrorString(err));
+        mServerProbe.reportConnectFailure();
         shutdownCloudXR();
         return false;
     }
 
-    LOGV("%s success. %s", constr.c_str(), mOptions.mServerIP.c_str());
+    LOGV("%s success. %s", constr, mServerAddress.c_str());
+    mPredictionTuner.beginSession(mServerAddress, mPredOffsetMs);
     return true;
 }
 
@@ -908,18 +1385,30 @@ bool WaveCloudXRApp::UpdateFrame() {
     {
         if (mConnected)
         {
-            cxrError frameErr = cxrLatchFrame(mReceiver, &mFramesLatched,
-                                              cxrFrameMask_All, LATCHFRAME_TIMEOUT_MS);
+            cxrError frameErr;
+            int64_t latchBeginNs = FlightRecorder::NowNs();
+            {
+                StallPhase phase(mWatchdog, Watched_Main, "cxrLatchFrame");
+                frameErr = cxrLatchFrame(mReceiver, &mFramesLatched, cxrFrameMask_All, mTuning.latchTimeoutMs);
+            }
+            mFlightFrame.latchUs = (uint32_t)((FlightRecorder::NowNs() - latchBeginNs) / 1000);
+            mFlightFrame.latchResult = (int16_t)frameErr;
             frameValid = (frameErr == cxrError_Success);
             if (!frameValid)
             {
-                if (frameErr == cxrError_Frame_Not_Ready)
-                    LOGW("LatchFrame failed, frame not ready for %d ms", LATCHFRAME_TIMEOUT_MS);
+                if (frameErr == cxrError_Frame_Not_Ready) {
+                    mFrameTracker.onMiss();
+                    LOGW("LatchFrame failed, frame not ready for %u ms", mTuning.latchTimeoutMs);
+                }
                 else if (frameErr == cxrError_Not_Connected)
                     LOGW("LatchFrame failed, receiver no longer connected.");
                 else
                     LOGE("Error in LatchFrame [%0d] = %s", frameErr, cxrErrorString(frameErr));
             } else {
+                mFrameTracker.onLatched(mFramesLatched);
+                mPoseLatency.onLatched(mFramesLatched.poseMatrix);
+                mPredictionTuner.onLatched();
+                mFlightFrame.poseAgeUs = mPoseLatency.latchedAgeUs();
 
                 // CloudXR SDK 3.1.1:
                 // If network condition is bad, e.g. bitrate usage down below ~5Mbps
@@ -969,6 +1458,7 @@ bool WaveCloudXRApp::UpdateHMDPose(const WVR_PoseState_t hmdPose) {
         cxrMatrixToVecQuat(&mat, &mCXRPoseState.hmd.pose.position, &mCXRPoseState.hmd.pose.rotation);
         mCXRPoseState.hmd.pose.velocity = Convert(hmdPose.velocity);
         mCXRPoseState.hmd.pose.angularVelocity = Convert(hmdPose.angularVelocity);
+        mHmdPoseTimeNs = hmdPose.timestamp;
 
         mHmdPose = hmdPose;
     }
@@ -983,7 +1473,7 @@ bool WaveCloudXRApp::UpdateDevicePose(const WVR_DeviceType type, const WVR_PoseS
 
     {
         size_t idx = type == WVR_DeviceType_Controller_Left ? 0 : 1;
-        if (!WVR_IsDeviceConnected(type))
+        if (!mControllerManager.present(idx))
         {
             mCXRPoseState.controller[idx].pose.poseIsValid = cxrFalse;
             mCXRPoseState.controller[idx].pose.deviceIsConnected = cxrFalse;
@@ -1016,7 +1506,12 @@ bool WaveCloudXRApp::UpdateAnalog()
         WVR_DeviceType ctl = (hand == HAND_LEFT) ?
                              WVR_DeviceType_Controller_Left : WVR_DeviceType_Controller_Right;
 
-        if(!WVR_IsDeviceConnected(ctl)) {
+        cxrControllerHandle controller = mControllerManager.handle(hand);
+        if (controller == nullptr) {
+            continue;
+        }
+        if (!mControllerManager.connected(hand)) {
+            UpdateHandInput(hand, controller);
             continue;
         }
 
@@ -1024,7 +1519,7 @@ bool WaveCloudXRApp::UpdateAnalog()
         uint32_t buttons = 0;
         uint32_t touches = 0;
         WVR_AnalogState_t analogState[3];
-        uint32_t analogCount = (uint32_t)WVR_GetInputTypeCount(ctl, WVR_InputType_Analog);
+        uint32_t analogCount = mControllerManager.analogCount(hand);
         if (!WVR_GetInputDeviceState(ctl, inputType, &buttons, &touches, analogState, analogCount)) {
             continue;
         }
@@ -1070,7 +1565,7 @@ bool WaveCloudXRApp::UpdateAnalog()
         }
 
         if (mCTLEventCount[hand] > 0) {
-            cxrError err = cxrFireControllerEvents(mReceiver, mControllers[hand], mCTLEvents[hand], mCTLEventCount[hand]);
+            cxrError err = cxrFireControllerEvents(mReceiver, controller, mCTLEvents[hand], mCTLEventCount[hand]);
             if (err != cxrError_Success)
             {
                 LOGE("[UpdateInput] cxrFireControllerEvents failed: %s", cxrErrorString(err));
@@ -1084,23 +1579,41 @@ bool WaveCloudXRApp::UpdateAnalog()
     return true;
 }
 
-bool WaveCloudXRApp::Render(const uint32_t eye, WVR_TextureParams_t eyeTexture, const bool frameValid) {
+bool WaveCloudXRApp::Render(const uint32_t eye, const EyeTextureQueue::Slot& slot, const bool frameValid) {
 
+    WVR_TextureParams_t eyeTexture = slot.texture;
     if (frameValid) {
         // Submit frame with pose that render this frame
         auto& framePose = mFramesLatched.poseMatrix;
         WVR_Matrix4f_t headMatrix = Convert(framePose);
         WVR_ConvertMatrixQuaternion(&headMatrix, &mHmdPose.rawPose.rotation, true);
 
-        cxrBool result = cxrBlitFrame(mReceiver, &mFramesLatched, 1 << eye);
+        {
+            StallPhase phase(mWatchdog, Watched_Main, "cxrBlitFrame");
+            cxrBlitFrame(mReceiver, &mFramesLatched, 1 << eye);
+        }
 
         WVR_SubmitExtend ext = WVR_SubmitExtend_Default;
-        WVR_SubmitFrame((WVR_Eye)eye, &eyeTexture, &mHmdPose, ext);
+        {
+            StallPhase phase(mWatchdog, Watched_Main, "WVR_SubmitFrame");
+            WVR_SubmitFrame((WVR_Eye)eye, &eyeTexture, &mHmdPose, ext);
+        }
 
         if (eye == (uint32_t)WVR_Eye_Right && mReceiver && mConnected) {
+            StallPhase phase(mWatchdog, Watched_Main, "cxrReleaseFrame");
             cxrReleaseFrame(mReceiver, &mFramesLatched);
         }
 
+        LastFrame& last = mLastFrame[eye];
+        last.fbo = slot.fbo;
+        last.generation = mEyeQueues[eye].generation();
+        last.pose = mHmdPose;
+    }
+    else if (ConcealMiss(eye, slot)) {
+        if (eye == (uint32_t)WVR_Eye_Right) {
+            mFrameTracker.onConcealed();
+            mFlightFrameFlags |= FlightFrame_Concealed;
+        }
     }
     // Render grey color gradient when frame invalid for whatever reason
     else {
@@ -1118,12 +1631,134 @@ bool WaveCloudXRApp::Render(const uint32_t eye, WVR_TextureParams_t eyeTexture,
         glClear(GL_COLOR_BUFFER_BIT);
 
         WVR_SubmitExtend ext = WVR_SubmitExtend_Default;
+        StallPhase phase(mWatchdog, Watched_Main, "WVR_SubmitFrame");
         WVR_SubmitFrame((WVR_Eye)eye, &eyeTexture, &mHmdPose, ext);
     }
 
     return true;
 }
 
+bool WaveCloudXRApp::ConcealMiss(const uint32_t eye, const EyeTextureQueue::Slot& slot) {
+    LastFrame& last = mLastFrame[eye];
+    if (mConsecutiveMisses > mTuning.concealMisses || last.fbo == 0 ||
+        last.generation != mEyeQueues[eye].generation()) {
+        return false;
+    }
+
+    // The last image may sit in a texture the queue hands out again, copy it
+    // forward into the texture being submitted so the chain survives any streak
+    if (last.fbo != slot.fbo) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, last.fbo);
+        glBlitFramebuffer(0, 0, mRenderWidth, mRenderHeight, 0, 0, mRenderWidth, mRenderHeight,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        last.fbo = slot.fbo;
+    }
+
+    WVR_TextureParams_t texture = slot.texture;
+    WVR_SubmitExtend ext = WVR_SubmitExtend_Default;
+    StallPhase phase(mWatchdog, Watched_Main, "WVR_SubmitFrame");
+    WVR_SubmitFrame((WVR_Eye)eye, &texture, &last.pose, ext);
+    return true;
+}
+
+bool WaveCloudXRApp::IsIdle() const {
+    return mPaused || !mInited || !mConnected;
+}
+
+void WaveCloudXRApp::UpdateIdleState(const bool idle) {
+    if (idle == mIdle) {
+        return;
+    }
+    mIdle = idle;
+
+    struct timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    int64_t cpuNs = cpu.tv_sec * 1000000000LL + cpu.tv_nsec;
+    auto now = std::chrono::steady_clock::now();
+
+    if (idle) {
+        mIdleBegin = now;
+        mIdleFrameBegin = now;
+        mIdleCpuBeginNs = cpuNs;
+        mIdleFrames = 0;
+        LOGI("[Idle] Enter idle mode at %u fps", mTuning.idleFps);
+    } else {
+        float wallSec = std::chrono::duration<float>(now - mIdleBegin).count();
+        float cpuSec = (cpuNs - mIdleCpuBeginNs) / 1000000000.0f;
+        mFrameTracker.reset(mDeviceDesc.videoStreamDescs[0].fps);
+        mPoseLatency.reset();
+        // Don't bring back an image from before the pause or reconnect
+        mLastFrame[WVR_Eye_Left].fbo = 0;
+        mLastFrame[WVR_Eye_Right].fbo = 0;
+        LOGI("[Idle] Leave idle mode after %.1f s: %u frames submitted (%.1f fps), process CPU %.2f s (%.0f%% of a core)",
+             wallSec, mIdleFrames, wallSec > 0 ? mIdleFrames / wallSec : 0.0f,
+             cpuSec, wallSec > 0 ? 100.0f * cpuSec / wallSec : 0.0f);
+    }
+}
+
+void WaveCloudXRApp::RenderIdleFrame() {
+    // Grey pulse quantized to a few levels, textures are only cleared when their level changes
+    static const int levels = 32;
+    static const float periodSec = 3.6f;
+    static const float pong = 0.4f;
+
+    float phase = fmodf(std::chrono::duration<float>(std::chrono::steady_clock::now() - mIdleBegin).count(), periodSec) / periodSec;
+    float triangle = phase < 0.5f ? phase * 2.0f : 2.0f - phase * 2.0f;
+    int level = (int)(triangle * (levels - 1) + 0.5f);
+    float color = pong * level / (levels - 1);
+
+    for (int eye = 0; eye < 2; eye++) {
+        EyeTextureQueue::Slot* slot = mLoadingQueues[eye].acquire();
+        if (slot == nullptr) {
+            continue;
+        }
+
+        if (slot->tag != level) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, slot->fbo);
+            glViewport(0, 0, LOADING_TEXTURE_SIZE, LOADING_TEXTURE_SIZE);
+            glScissor(0, 0, LOADING_TEXTURE_SIZE, LOADING_TEXTURE_SIZE);
+            glClearColor(color, color, color, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            slot->tag = level;
+        }
+
+        WVR_SubmitExtend ext = WVR_SubmitExtend_Default;
+        StallPhase phase(mWatchdog, Watched_Main, "WVR_SubmitFrame");
+        WVR_SubmitFrame((WVR_Eye)eye, &slot->texture, &mHmdPose, ext);
+    }
+    mIdleFrames++;
+}
+
+void WaveCloudXRApp::WaitIdleFrame() {
+    // Sleep the rest of the idle frame, wake up as soon as the session starts streaming
+    mIdleFrameBegin += std::chrono::microseconds(1000000 / mTuning.idleFps);
+    auto now = std::chrono::steady_clock::now();
+    if (mIdleFrameBegin < now) {
+        mIdleFrameBegin = now;
+    }
+
+    // Sleeping on purpose is not a stall
+    mWatchdog.park(Watched_Main);
+    {
+        std::unique_lock<std::mutex> lock(mIdleMutex);
+        mIdleCond.wait_until(lock, mIdleFrameBegin, [this]() {
+            return mInited && mConnected && !mPaused;
+        });
+    }
+    BeatMain();
+}
+
+// While paused the system may hold the main loop as long as it likes
+void WaveCloudXRApp::BeatMain() {
+    if (mPaused) {
+        mWatchdog.park(Watched_Main);
+    } else {
+        mWatchdog.beat(Watched_Main);
+    }
+}
+
 // Fire 1 input event once at a time
 // checkme: update all button states at fixed freq and fire all button event at once
 bool WaveCloudXRApp::UpdateInput(const WVR_Event_t& event)
@@ -1147,38 +1782,10 @@ bool WaveCloudXRApp::UpdateInput(const WVR_Event_t& event)
     }
 
     uint8_t hand = (ctl == WVR_DeviceType_Controller_Left) ? HAND_LEFT : HAND_RIGHT;
-    // Create CXR controller handle
-    if (mControllers[hand] == nullptr) {
-        if (!WVR_IsDeviceConnected(ctl)) {
-            // device disconnected but have input event incoming?
-            // continue;
-            return false;
-        }
-
-        cxrControllerDesc desc = {};
-        desc.id = ctl;
-        desc.role = (hand == HAND_LEFT) ?
-                    "cxr://input/hand/left" : "cxr://input/hand/right";
-        desc.controllerName = "Oculus Touch";
-        //desc.controllerName = "vive_focus3_controller"; // CXR server does not recognize this name
-        // desc.controllerName = "VIVE FOCUS 3 Controller";
-        desc.inputCount = inputTouchLegacyCount;
-        desc.inputPaths = inputsTouchLegacy;
-        desc.inputValueTypes = inputValuesTouchLegacy;
-        cxrError e = cxrAddController(mReceiver, &desc, &mControllers[hand]);
-        if (e!=cxrError_Success)
-        {
-            LOGE("[UpdateInput] Error adding controller: %s", cxrErrorString(e));
-            //continue;
-            return false;
-        }
-        LOGE("[UpdateInput] Added controller %s, %s", desc.controllerName, desc.role);
-    } else {
-        // Controller handle exist but device is actually disconnected
-        if (!WVR_IsDeviceConnected(ctl)) {
-            LOGE("[UpdateInput] Device %d is disconnected.", ctl);
-            // destroy controller handle
-        }
+    // Registered by mControllerManager, none while the device is disconnected
+    cxrControllerHandle controller = mControllerManager.handle(hand);
+    if (controller == nullptr) {
+        return false;
     }
 
     // button
@@ -1238,7 +1845,7 @@ bool WaveCloudXRApp::UpdateInput(const WVR_Event_t& event)
     }
 
     if (mCTLEventCount[hand] > 0) {
-        cxrError err = cxrFireControllerEvents(mReceiver, mControllers[hand], mCTLEvents[hand], mCTLEventCount[hand]);
+        cxrError err = cxrFireControllerEvents(mReceiver, controller, mCTLEvents[hand], mCTLEventCount[hand]);
         /*LOGE("[UpdateInput] %s, WVRInputId %d, %s, %d, Timestamp %lu",
              hand == HAND_LEFT ? "LEFT" : "RIGHT", event.input.inputId,
              inputsTouchLegacy[e.clientInputIndex], e.inputValue.vBool, e.clientTimeNS);*/
@@ -1253,15 +1860,70 @@ bool WaveCloudXRApp::UpdateInput(const WVR_Event_t& event)
     return true;
 }
 
+// Hand tracking as input of a hand with no controller connected, polled every frame.
+// Pinch drives the trigger and grip the grip, clicks with hysteresis. Only changes are sent
+void WaveCloudXRApp::UpdateHandInput(const uint8_t hand, cxrControllerHandle controller)
+{
+    HandInput input = mHandTracker.input(hand);
+    HandInputSent& sent = mHandInputSent[hand];
+    HandInputSent now = sent;
+    if (input.valid) {
+        now.pinch = input.pinch;
+        now.grip = input.grip;
+        now.pinchClick = sent.pinchClick ? input.pinch > 0.6f : input.pinch > 0.8f;
+        now.gripClick = sent.gripClick ? input.grip > 0.6f : input.grip > 0.8f;
+    } else if (!mHandTracker.tracked(hand)) {
+        now = HandInputSent();
+    }
+
+    uint32_t count = 0;
+    cxrControllerEvent* events = mCTLEvents[hand];
+    if (fabsf(now.pinch - sent.pinch) > 0.01f || (now.pinch == 0.0f) != (sent.pinch == 0.0f)) {
+        events[count].clientInputIndex = 4; // "/input/trigger/value"
+        events[count].inputValue.valueType = cxrInputValueType_float32;
+        events[count++].inputValue.vF32 = now.pinch;
+    }
+    if (now.pinchClick != sent.pinchClick) {
+        events[count].clientInputIndex = 2; // "/input/trigger/click"
+        events[count].inputValue.valueType = cxrInputValueType_boolean;
+        events[count++].inputValue.vBool = now.pinchClick ? cxrTrue : cxrFalse;
+    }
+    if (fabsf(now.grip - sent.grip) > 0.01f || (now.grip == 0.0f) != (sent.grip == 0.0f)) {
+        events[count].clientInputIndex = 7; // "/input/grip/value"
+        events[count].inputValue.valueType = cxrInputValueType_float32;
+        events[count++].inputValue.vF32 = now.grip;
+    }
+    if (now.gripClick != sent.gripClick) {
+        events[count].clientInputIndex = 5; // "/input/grip/click"
+        events[count].inputValue.valueType = cxrInputValueType_boolean;
+        events[count++].inputValue.vBool = now.gripClick ? cxrTrue : cxrFalse;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    cxrError err = cxrFireControllerEvents(mReceiver, controller, events, count);
+    if (err != cxrError_Success) {
+        LOGE("[UpdateInput] cxrFireControllerEvents failed: %s", cxrErrorString(err));
+        return;
+    }
+    sent = now;
+}
+
 /*
  * CloudXR callbacks
  *
  * */
 oboe::DataCallbackResult WaveCloudXRApp::onAudioReady(oboe::AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-    cxrAudioFrame recordedFrame{};
-    recordedFrame.streamBuffer = (int16_t*)audioData;
-    recordedFrame.streamSizeBytes = numFrames * CXR_AUDIO_CHANNEL_COUNT * CXR_AUDIO_SAMPLE_SIZE;
-    cxrSendAudio(mReceiver, &recordedFrame);
+    if (!mRecordThreadRegistered) {
+        ThreadManager::Instance().registerCurrent(ThreadRole_Audio, "cxr-mic");
+        mRecordThreadRegistered = true;
+    }
+    NoAllocScope noAlloc("onAudioReady");
+    mWatchdog.beat(Watched_Mic);
+    StallPhase phase(mWatchdog, Watched_Mic, "cxrSendAudio");
+
+    mMicUplink.send(mReceiver, (const int16_t*)audioData, numFrames);
 
     return oboe::DataCallbackResult::Continue;
 }
@@ -1273,11 +1935,13 @@ void WaveCloudXRApp::GetTrackingState(cxrVRTrackingState *trackingState) {
 
     // std::lock_guard<std::mutex> lock(mPoseMutex);
     *trackingState = mCXRPoseState;
+    mPoseLatency.onPoseSent(trackingState->hmd.pose, mHmdPoseTimeNs);
 
     getPoseCount++;
 }
 
 cxrBool WaveCloudXRApp::RenderAudio(const cxrAudioFrame *audioFrame) {
+    NoAllocScope noAlloc("RenderAudio");
     if (!mPlaybackStream || !mInited || !mConnected)
     {
         return cxrFalse;
@@ -1286,6 +1950,8 @@ cxrBool WaveCloudXRApp::RenderAudio(const cxrAudioFrame *audioFrame) {
     const uint32_t timeout = audioFrame->streamSizeBytes / CXR_AUDIO_BYTES_PER_MS;
     const uint32_t numFrames = timeout * CXR_AUDIO_SAMPLING_RATE / 1000;
     uint32_t timeoutMS = 4*timeout; // WAR for oboe timing issue on Focus+.
+    mWatchdog.beat(Watched_Speaker);
+    StallPhase phase(mWatchdog, Watched_Speaker, "AudioStream::write");
     mPlaybackStream->write(audioFrame->streamBuffer, numFrames, timeoutMS * oboe::kNanosPerMillisecond);
 
     return cxrTrue;
@@ -1341,6 +2007,7 @@ void WaveCloudXRApp::HandleClientState(void* context, cxrClientState state, cxrE
             break;
         case cxrClientState_ConnectionAttemptFailed:
             LOGE("Connection attempt failed with error: %s", cxrErrorString(error));
+            mServerProbe.reportConnectFailure();
             state = cxrClientState_Disconnected; // retry connection
             mConnected = false;
             break;
@@ -1349,15 +2016,18 @@ void WaveCloudXRApp::HandleClientState(void* context, cxrClientState state, cxrE
             mConnected = false;
             break;
         default:
-            LOGW("Client state updated: %s to %s, reason: %s", ClientStateEnumToString(mClientState), ClientStateEnumToString(state), cxrErrorString(error));
+            LOGW("Client state updated to %s, reason: %s", ClientStateEnumToString(state), cxrErrorString(error));
             break;
     }
 
-    if (mClientState != state) {
-        mClientState = state;
+    // The main loop acts on it, see HandleCloudXRLifecycle()
+    mLifecycleEvents.push(state, error);
 
-        mStateDirty = true;
+    // Lock so the notification can't slip between a waiter's predicate check and its wait
+    {
+        std::lock_guard<std::mutex> lock(mIdleMutex);
     }
+    mIdleCond.notify_all();
 }
 
 uint16_t WaveCloudXRApp::GetTouchInputIndex(const bool touched, const WVR_InputId wvrInputId) {
@@ -1457,8 +2127,7 @@ uint16_t WaveCloudXRApp::GetAnalogInputIndex(const bool pressed, const WVR_Input
 
 void WaveCloudXRApp::CheckStreamQuality() {
 
-    // Log connection stats every 3 seconds
-    const int STATS_INTERVAL_SEC = 3;
+    // Log connection stats every mTuning.statsIntervalSec seconds
     mFramesUntilStats--;
     cxrConnectionStats mStats = {};
     if (mFramesUntilStats <= 0 &&
@@ -1507,7 +2176,16 @@ void WaveCloudXRApp::CheckStreamQuality() {
         }
 
         LOGI("%s    %s    %s", statsString, qualityString, reasonString);
-        mFramesUntilStats = (int)mStats.framesPerSecond * STATS_INTERVAL_SEC;
+        mStallMetrics.roundTripMs = mStats.roundTripDelayMs;
+        mStallMetrics.bitrateKbps = mStats.bandwidthUtilizationKbps;
+        mPoseLatency.logReport();
+        mHandTracker.logReport();
+        mUserData.logReport();
+        mMicUplink.logReport();
+        mPoseSampler.logReport();
+        ThreadManager::Instance().logReport();
+        AllocTracker::LogReport();
+        mFramesUntilStats = (int)mStats.framesPerSecond * mTuning.statsIntervalSec;
     }
 }
 
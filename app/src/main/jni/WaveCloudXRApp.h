@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <condition_variable>
 
 #include <GLES3/gl31.h>
 
@@ -22,11 +23,40 @@
 #include <CloudXRCommon.h>
 #include <CloudXRClientOptions.h>
 
+#include "StartupOrchestrator.h"
+#include "TuningConfig.h"
+#include "ClientProfile.h"
+#include "ServerProbe.h"
+#include "ThreadManager.h"
+#include "FrameTracker.h"
+#include "PoseLatencyTracker.h"
+#include "MotionRecorder.h"
+#include "StatsServer.h"
+#include "EyeTextureQueue.h"
+#include "ControllerManager.h"
+#include "HandTracker.h"
+#include "UserDataChannel.h"
+#include "LifecycleEventQueue.h"
+#include "AllocTracker.h"
+#include "StallWatchdog.h"
+#include "FlightRecorder.h"
+#include "MicUplink.h"
+#include "RefreshRateNegotiator.h"
+#include "SwapchainPlanner.h"
+#include "PredictionTuner.h"
+#include "PoseSampler.h"
+
 class WaveCloudXRApp : public oboe::AudioStreamDataCallback
 {
 public:
     WaveCloudXRApp();
 
+    /*
+     * Cold start: runs initVR, initGL and initCloudXR steps concurrently where
+     * possible and sends the first connection request
+     * */
+    bool startup();
+
     bool initVR();
     bool initGL();
     bool initCloudXR();
@@ -60,24 +90,34 @@ public:
 protected:
     void Pause();
     void Resume();
+    // After a disconnect or a refused Connect(), false when out of retries
+    bool ScheduleReconnect();
+    // Once the candidates are probed again
+    bool Reconnect();
 
 protected:
     uint16_t GetTouchInputIndex(const bool touched, const WVR_InputId wvrInputId);
     uint16_t GetPressInputIndex(const uint8_t hand, const bool pressed, const WVR_InputId wvrInputId);
     uint16_t GetAnalogInputIndex(const bool pressed, const WVR_InputId wvrInputId);
     void updateTime();
+    void ApplyTuning();
+    void ApplyRefreshRate();
+    void BeatMain();
+    void StartMotionReplay(const uint32_t speedPct);
+    void StopMotionReplay();
     void processVREvent(const WVR_Event_t & event);
 
     void ReleaseFramebuffers();
     void RecreateFramebuffer(const uint32_t width, const uint32_t height);
 
-    GLuint CreateGLFramebuffer(const GLuint texId);
-
 // CloudXR function
 protected:
     bool LoadConfig();
     bool InitAudio();
+    bool OpenAudio();
+    bool StartAudio();
     bool InitCallbacks();
+    bool QueryDeviceProps();
     bool InitDeviceDesc();
     bool InitReceiver();
 
@@ -93,11 +133,26 @@ protected:
     bool UpdateDevicePose(const WVR_DeviceType type, const WVR_PoseState_t ctrlPose);
     bool UpdateInput(const WVR_Event_t& event);
     bool UpdateAnalog();
+    void UpdateHandInput(const uint8_t hand, cxrControllerHandle controller);
 
     /*
      * Render the video frame to the currently bound target surface
      */
-    bool Render(const uint32_t eye, WVR_TextureParams_t eyeTexture, const bool frameValid);
+    bool Render(const uint32_t eye, const EyeTextureQueue::Slot& slot, const bool frameValid);
+
+    /*
+     * Re-submit the last valid image of an eye with the pose it was rendered with,
+     * the compositor reprojects it. False once the miss streak is too long
+     * */
+    bool ConcealMiss(const uint32_t eye, const EyeTextureQueue::Slot& slot);
+
+    /*
+     * Idle mode: not streaming, submit the cached loading texture at mTuning.idleFps
+     * */
+    bool IsIdle() const;
+    void UpdateIdleState(const bool idle);
+    void RenderIdleFrame();
+    void WaitIdleFrame();
 
     void CheckStreamQuality();
 private:
@@ -109,15 +164,43 @@ private:
     cxrClientCallbacks mClientCallbacks;
     cxrGraphicsContext mContext;
     CloudXR::ClientOptions mOptions;
+    ClientProfile mProfile;         // from the launch options, see ClientProfile.h
     cxrConnectionDesc mConnectionDesc = {};
+    ServerProbe mServerProbe;
+    std::string mServerAddress;     // candidate picked by the last Connect(), main thread only
+
+    // WVR properties cached by QueryDeviceProps()
+    WVR_RenderProps_t mRenderProps{};
+    float mClippingPlanes[2][4] = {};
+    WVR_Arena_t mArena{};
+
+    // Display and requested stream rate follow what the server sustains
+    RefreshRateNegotiator mRefreshRate;
+    float mServerFps = 0.0f;        // from the connection stats, 0 while not streaming
 
-    bool mStateDirty = false;
+    // Prediction offset learned per server, applied when the receiver is created
+    PredictionTuner mPredictionTuner;
+    uint32_t mPredOffsetMs = 0;
+
+    // Client state changes from CloudXR threads, mClientState is what the main loop acted on
+    LifecycleEventQueue mLifecycleEvents;
     cxrClientState mClientState = cxrClientState_ReadyToConnect;
+
+    // Stall reports, what the main loop last published for them
+    StallWatchdog mWatchdog;
+    StallMetrics mStallMetrics;
+
+    // Telemetry ring, the frame record is filled in while rendering it
+    FlightRecorder mFlightRecorder;
+    FlightFrame mFlightFrame = {};
+    uint8_t mFlightFrameFlags = 0;
     // cxrStateReason mClientStateReason = cxrStateReason_NoError;
 
     // Audio
     oboe::AudioStream* mPlaybackStream= nullptr;
     oboe::AudioStream* mRecordStream= nullptr;
+    std::atomic<bool> mRecordThreadRegistered{false};   // set on the Oboe callback thread
+    MicUplink mMicUplink;
 
     // Pose
     std::mutex mPoseMutex;
@@ -125,7 +208,17 @@ private:
     bool mExitPoseStream = false;
     cxrVRTrackingState mCXRPoseState;
     WVR_PoseState_t mHmdPose;
+    std::atomic<int64_t> mHmdPoseTimeNs{0};   // WVR sample time of the pose in mCXRPoseState
     WVR_PoseState_t mCtrlPoses[2];
+    PoseSampler mPoseSampler;       // pose thread, logReport() from the main loop
+
+    // Motion capture, replayed poses replace WVR ones while mReplaying
+    MotionRecorder mMotionRecorder;
+    MotionReplayer mMotionReplayer;
+    std::thread* mReplayThread = nullptr;
+    std::atomic<bool> mReplaying{false};
+    std::mutex mReplayEventMutex;
+    std::vector<WVR_Event_t> mReplayEvents;
 
     // Input
     const uint8_t HAND_LEFT = 0;
@@ -133,7 +226,20 @@ private:
     const uint8_t IDX_TRIGGER = 0;
     const uint8_t IDX_GRIP = 1;
     const uint8_t IDX_THUMBSTICK = 2;
-    cxrControllerHandle mControllers[2] = {};
+    ControllerManager mControllerManager;
+
+    // Side channel to the server over CloudXR user data
+    CloudXRUserDataTransport mUserDataTransport;
+    UserDataChannel mUserData;
+    HandTracker mHandTracker;
+    // Hand gesture values last fired, per hand
+    struct HandInputSent {
+        float pinch = 0.0f;
+        float grip = 0.0f;
+        bool pinchClick = false;
+        bool gripClick = false;
+    };
+    HandInputSent mHandInputSent[2];
     bool mUpdateAnalogs[2][3] = {false};// [L|R][TRIGGER|GRIP|THUMBSTICK]
     // CXR Input event container
     cxrControllerEvent mCTLEvents[2][64] = {};
@@ -146,23 +252,56 @@ private:
     bool mIs6DoFHMD = false;
     bool mIs6DoFController[2] = {false, false};
 
-    bool mConnected;
-    bool mPaused;
-    bool mInited;
+    // Read by the pose, audio and CloudXR threads
+    std::atomic<bool> mConnected;
+    std::atomic<bool> mPaused;
+    std::atomic<bool> mInited;
 
-    // Render
-    void* mLeftEyeQ;
-    void* mRightEyeQ;
+    // Render, [WVR_Eye_Left|WVR_Eye_Right]
+    EyeTextureQueue mEyeQueues[2];
 
-    std::vector<GLuint> mLeftEyeFBO;
-    std::vector<GLuint> mRightEyeFBO;
+    // Last valid image per eye, for concealing latch misses
+    struct LastFrame {
+        GLuint fbo = 0;             // 0 = nothing to show
+        uint32_t generation = 0;    // of mEyeQueues[eye]
+        WVR_PoseState_t pose;       // submitted with it
+    };
+    LastFrame mLastFrame[2];
+    uint32_t mConsecutiveMisses = 0;
 
+    // Eye buffer size from SwapchainPlanner, the stream size is what cxrDeviceDesc requests
     uint32_t mRenderWidth;
     uint32_t mRenderHeight;
+    uint32_t mStreamWidth = 0;
+    uint32_t mStreamHeight = 0;
 
     float mFrameInvalidTime = 0.0f;
+    FrameTracker mFrameTracker;
+    PoseLatencyTracker mPoseLatency;
+
+    // Idle, small per eye queues holding the loading screen.
+    // The slot tag is the gradient level the texture currently holds
+    static const uint32_t LOADING_TEXTURE_SIZE = 256;
+    EyeTextureQueue mLoadingQueues[2];
+    bool mIdle = false;
+    std::chrono::steady_clock::time_point mIdleFrameBegin;
+    std::chrono::steady_clock::time_point mIdleBegin;
+    int64_t mIdleCpuBeginNs = 0;
+    uint32_t mIdleFrames = 0;
+    // Notified on client state changes, wakes the idle render wait and the pose thread
+    std::mutex mIdleMutex;
+    std::condition_variable mIdleCond;
+
+    // Live tuning, mTuning is written by ApplyTuning() under mPoseMutex
+    TuningParams mTuning;
+    TuningWatcher mTuningWatcher;
+
+    // Startup
+    StartupOrchestrator mStartup;
+    bool mFirstFrameLogged = false;
 
     // Statistics
+    StatsServer mStatsServer;
     float mTimeDiff;
     uint32_t mTimeAccumulator2S;  // add in micro second.
     struct timeval mRtcTime;
@@ -171,6 +310,7 @@ private:
     uint32_t mClockCount = 0;
     uint8_t mRetryConnCount = 0;
     const uint8_t mMaxRetryConnCount = 5;
+    bool mReconnectPending = false; // waiting for mServerProbe.startProbe()
 
     int mFramesUntilStats = 60;
-};
\ No newline at end of file
+};
@@ -5,30 +5,29 @@
 #include <WaveCloudXRApp.h>
 #include <unistd.h>
 #include <wvr/wvr.h>
+#include <mutex>
+
+#include "DisplayRefresh.h"
 
 bool gPaused = true;
 
-int main(int argc, char *argv[]) {
+static JavaVM* gJavaVM = nullptr;
+static jclass gActivityClass = nullptr;
+static std::mutex gRefreshMutex;
+static float gRefreshRates[DisplayRefresh::MAX_RATES];
+static uint32_t gRefreshRateCount = 0;
 
-    WaveCloudXRApp *app = new WaveCloudXRApp();
-    if (!app->initVR()) {
-        app->shutdownVR();
-        delete app;
-        return 1;
-    }
+int main(int argc, char *argv[]) {
 
-    if (!app->initGL()) {
-        app->shutdownGL();
-        app->shutdownVR();
-        delete app;
-        return 1;
-    }
+    AsyncLog::Instance().start();
 
-    if (!app->initCloudXR()) {
+    WaveCloudXRApp *app = new WaveCloudXRApp();
+    if (!app->startup()) {
         app->shutdownGL();
         app->shutdownVR();
         app->shutdownCloudXR();
         delete app;
+        AsyncLog::Instance().stop();
         return 1;
     }
 
@@ -54,14 +53,63 @@ int main(int argc, char *argv[]) {
     app->shutdownCloudXR();
 
     delete app;
+    AsyncLog::Instance().stop();
     return 0;
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_htc_vr_samples_wavecloudxr_MainActivity_nativeInit(JNIEnv * env, jobject activityInstance, jobject assetManagerInstance) {
+    // Static natives get the class, FindClass can't see app classes from native threads
+    if (gActivityClass == nullptr) {
+        gActivityClass = (jclass)env->NewGlobalRef(activityInstance);
+    }
     LOGI("Register WVR main");
     WVR_RegisterMain(main);
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_htc_vr_samples_wavecloudxr_MainActivity_nativeSetRefreshRates(JNIEnv * env, jobject activityInstance, jfloatArray rates) {
+    std::lock_guard<std::mutex> lock(gRefreshMutex);
+    jsize length = env->GetArrayLength(rates);
+    gRefreshRateCount = length < (jsize)DisplayRefresh::MAX_RATES ? (uint32_t)length : DisplayRefresh::MAX_RATES;
+    env->GetFloatArrayRegion(rates, 0, (jsize)gRefreshRateCount, gRefreshRates);
+}
+
+uint32_t DisplayRefresh::SupportedRates(float* rates, uint32_t capacity) {
+    std::lock_guard<std::mutex> lock(gRefreshMutex);
+    uint32_t count = gRefreshRateCount < capacity ? gRefreshRateCount : capacity;
+    for (uint32_t i = 0; i < count; i++) {
+        rates[i] = gRefreshRates[i];
+    }
+    return count;
+}
+
+bool DisplayRefresh::Request(float hz) {
+    if (gJavaVM == nullptr || gActivityClass == nullptr) {
+        return false;
+    }
+    JNIEnv* env = nullptr;
+    bool attached = false;
+    if (gJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_EDETACHED) {
+        if (gJavaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+            return false;
+        }
+        attached = true;
+    }
+
+    bool ok = false;
+    jmethodID method = env->GetStaticMethodID(gActivityClass, "requestRefreshRate", "(F)V");
+    if (method != nullptr) {
+        env->CallStaticVoidMethod(gActivityClass, method, (jfloat)hz);
+        ok = !env->ExceptionCheck();
+    }
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+    }
+    if (attached) {
+        gJavaVM->DetachCurrentThread();
+    }
+    return ok;
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_htc_vr_samples_wavecloudxr_MainActivity_nativeOnPause(JNIEnv * env, jobject activityInstance) {
     gPaused = true;
 }
@@ -72,6 +120,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_htc_vr_samples_wavecloudxr_MainActivi
 
 
 jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+    gJavaVM = vm;
 
     return JNI_VERSION_1_6;
 }
@@ -9,6 +9,9 @@
 
 #include <android/log.h>
 
+// Define LOG_SYNCHRONOUS to write from the calling thread, e.g. when chasing a crash
+#ifdef LOG_SYNCHRONOUS
+
 #define LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -16,6 +19,25 @@
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGF(...) __android_log_print(ANDROID_LOG_FATAL, LOG_TAG, __VA_ARGS__)
 
+#else
+
+#include "AsyncLog.h"
+
+// The unevaluated call keeps the compiler's printf format checks
+#define LOG_ASYNC(prio, ...) do { \
+    (void)sizeof(__android_log_print(prio, LOG_TAG, __VA_ARGS__)); \
+    AsyncLog::Write(prio, LOG_TAG, __VA_ARGS__); \
+} while (0)
+
+#define LOGV(...) LOG_ASYNC(ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#define LOGD(...) LOG_ASYNC(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define LOGI(...) LOG_ASYNC(ANDROID_LOG_INFO, __VA_ARGS__)
+#define LOGW(...) LOG_ASYNC(ANDROID_LOG_WARN, __VA_ARGS__)
+#define LOGE(...) LOG_ASYNC(ANDROID_LOG_ERROR, __VA_ARGS__)
+#define LOGF(...) __android_log_print(ANDROID_LOG_FATAL, LOG_TAG, __VA_ARGS__)
+
+#endif
+
 #define LogD(tag, ...) __android_log_print(ANDROID_LOG_DEBUG, tag, __VA_ARGS__)
 #define LogE(tag, ...) __android_log_print(ANDROID_LOG_ERROR, tag, __VA_ARGS__)
 
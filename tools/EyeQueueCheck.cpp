@@ -0,0 +1,184 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Leak check of EyeTextureQueue against counting fakes of the WVR texture queue
+ * and GL framebuffer calls it makes. Allocates, reallocates and releases both eye
+ * queues the way initGL, RecreateFramebuffer and shutdownGL do and checks that
+ * every queue and FBO handed out comes back, and that acquire() and
+ * framebufferFor() don't touch the heap.
+ *
+ *   g++ -std=c++11 -O2 -DLOG_SYNCHRONOUS -DCXR_TRACK_ALLOCATIONS -I tools/host -I app/src/main/jni \
+ *       -I $VR_SDK_ROOT/include tools/EyeQueueCheck.cpp app/src/main/jni/EyeTextureQueue.cpp \
+ *       app/src/main/jni/AllocTracker.cpp -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc \
+ *       -lpthread -o EyeQueueCheck
+ *   ./EyeQueueCheck
+ *
+ * GLES3 headers come from the host (mesa) or the NDK sysroot. Exits 1 on a failure.
+ * */
+
+#include <android/log.h>
+#include <stdio.h>
+#include <set>
+
+#include "AllocTracker.h"
+#include "Check.h"
+#include "EyeTextureQueue.h"
+
+/*
+ * Fakes, every handle they give out is tracked until it is released
+ * */
+struct FakeQueue {
+    uint32_t length;
+    GLuint firstTexture;
+    int32_t next;
+};
+
+static std::set<FakeQueue*> sQueues;
+static std::set<GLuint> sFramebuffers;
+static uint32_t sQueueLength = 3;       // of the next queue obtained
+static GLuint sNextTexture = 1;
+static GLuint sNextFramebuffer = 1;
+static uint32_t sBadDeletes = 0;
+
+extern "C" {
+
+WVR_TextureQueueHandle_t WVR_ObtainTextureQueue(WVR_TextureTarget, WVR_TextureFormat, WVR_TextureType,
+                                                uint32_t width, uint32_t height, int32_t) {
+    if (width == 0 || height == 0) {
+        return nullptr;
+    }
+    FakeQueue* queue = new FakeQueue{ sQueueLength, sNextTexture, 0 };
+    // Ids far apart so they collide in the lookup table
+    sNextTexture += 16 * sQueueLength;
+    sQueues.insert(queue);
+    return queue;
+}
+
+uint32_t WVR_GetTextureQueueLength(WVR_TextureQueueHandle_t handle) {
+    return ((FakeQueue*)handle)->length;
+}
+
+WVR_TextureParams_t WVR_GetTexture(WVR_TextureQueueHandle_t handle, int32_t index) {
+    WVR_TextureParams_t texture = {};
+    texture.id = (WVR_Texture_t)(size_t)(((FakeQueue*)handle)->firstTexture + 16 * index);
+    return texture;
+}
+
+int32_t WVR_GetAvailableTextureIndex(WVR_TextureQueueHandle_t handle) {
+    FakeQueue* queue = (FakeQueue*)handle;
+    int32_t index = queue->next;
+    queue->next = (queue->next + 1) % queue->length;
+    return index;
+}
+
+void WVR_ReleaseTextureQueue(WVR_TextureQueueHandle_t handle) {
+    FakeQueue* queue = (FakeQueue*)handle;
+    if (sQueues.erase(queue) == 0) {
+        fprintf(stderr, "Released a queue twice or one never obtained\n");
+        sFailures++;
+        return;
+    }
+    delete queue;
+}
+
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    for (GLsizei i = 0; i < n; i++) {
+        framebuffers[i] = sNextFramebuffer++;
+        sFramebuffers.insert(framebuffers[i]);
+    }
+}
+
+void glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    for (GLsizei i = 0; i < n; i++) {
+        if (sFramebuffers.erase(framebuffers[i]) == 0) sBadDeletes++;
+    }
+}
+
+void glBindFramebuffer(GLenum, GLuint) {}
+void glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) {}
+GLenum glCheckFramebufferStatus(GLenum) { return GL_FRAMEBUFFER_COMPLETE; }
+
+}
+
+static GLuint TextureId(const EyeTextureQueue::Slot& slot) {
+    return (GLuint)(size_t)slot.texture.id;
+}
+
+// Every slot's FBO is found by its texture id, and each acquired slot is one of them
+static void CheckLookups(EyeTextureQueue& queue) {
+    AllocCounters before = AllocTracker::Current();
+    {
+        NoAllocScope noAlloc("EyeQueueCheck");
+        for (int32_t i = 0; i < queue.length() * 2; i++) {
+            EyeTextureQueue::Slot* slot = queue.acquire();
+            CHECK(slot != nullptr);
+            if (slot == nullptr) continue;
+            CHECK(slot->fbo != 0 && sFramebuffers.count(slot->fbo) == 1);
+            CHECK(queue.framebufferFor(TextureId(*slot)) == slot->fbo);
+        }
+        CHECK(queue.framebufferFor(0xdead) == 0);
+    }
+    CHECK(AllocTracker::Current().allocations == before.allocations);
+}
+
+static void CheckLive(uint32_t queues, uint32_t framebuffers) {
+    CHECK(sQueues.size() == queues);
+    CHECK(sFramebuffers.size() == framebuffers);
+    CHECK(EyeTextureQueue::LiveQueues() == (int32_t)queues);
+    CHECK(EyeTextureQueue::LiveFramebuffers() == (int32_t)framebuffers);
+    CHECK(sBadDeletes == 0);
+}
+
+int main() {
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+    EyeTextureQueue eyes[2];
+
+    // initGL
+    for (EyeTextureQueue& eye : eyes) CHECK(eye.allocate(1440, 1600));
+    CheckLive(2, 6);
+    for (EyeTextureQueue& eye : eyes) CheckLookups(eye);
+
+    // Same size again is a no-op, the generation stays
+    uint32_t generation = eyes[0].generation();
+    CHECK(eyes[0].allocate(1440, 1600));
+    CHECK(eyes[0].generation() == generation);
+    CheckLive(2, 6);
+
+    // RecreateFramebuffer on resolution changes, every step a new size and queue length
+    for (uint32_t i = 0; i < 50; i++) {
+        sQueueLength = 2 + i % 3;
+        uint32_t width = 1024 + 64 * (i % 7);
+        for (EyeTextureQueue& eye : eyes) {
+            uint32_t before = eye.generation();
+            CHECK(eye.allocate(width, width * 10 / 9));
+            CHECK(eye.width() == width && eye.length() == (int32_t)sQueueLength);
+            CHECK(eye.generation() == before + 1);
+            CheckLookups(eye);
+        }
+        CheckLive(2, 2 * eyes[0].length());
+    }
+
+    // A queue longer than MAX_TEXTURES, the extra textures get no FBO
+    sQueueLength = EyeTextureQueue::MAX_TEXTURES + 2;
+    for (EyeTextureQueue& eye : eyes) CHECK(eye.allocate(2048, 2048));
+    CheckLive(2, 2 * EyeTextureQueue::MAX_TEXTURES);
+
+    // A failed allocation leaves nothing behind
+    sQueueLength = 3;
+    CHECK(!eyes[0].allocate(0, 0));
+    CHECK(!eyes[0].valid() && eyes[0].acquire() == nullptr);
+    CheckLive(1, EyeTextureQueue::MAX_TEXTURES);
+
+    // shutdownGL, twice like a pause followed by the exit
+    for (int pass = 0; pass < 2; pass++) {
+        for (EyeTextureQueue& eye : eyes) eye.release();
+        CheckLive(0, 0);
+    }
+
+    if (sFailures) {
+        printf("EyeQueueCheck: %d failures\n", sFailures);
+        return 1;
+    }
+    printf("EyeQueueCheck: no leaks, lookups allocation free\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Prints a flight recorder file as text, oldest record first.
+ *
+ *   adb pull /sdcard/CloudXRFlightRecorder.bin        (or .prev for the session before)
+ *   g++ -std=c++11 -O2 -I app/src/main/jni tools/FlightDecode.cpp -o FlightDecode
+ *   ./FlightDecode CloudXRFlightRecorder.bin
+ *
+ * Times are wall clock, client states and errors are the numeric CloudXR enums.
+ * Tuning keys are numbered in the order of kTuningKeys in TuningConfig.cpp, the
+ * thread placement keys follow it.
+ * */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "FlightRecord.h"
+
+static void PrintTime(const FlightFileHeader& header, int64_t timeNs) {
+    int64_t us = header.startRealtimeUs + (timeNs - header.startMonotonicNs) / 1000;
+    time_t seconds = (time_t)(us / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char text[32];
+    strftime(text, sizeof(text), "%H:%M:%S", &local);
+    printf("%s.%06d ", text, (int)(us % 1000000));
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s CloudXRFlightRecorder.bin\n", argv[0]);
+        return 2;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    FlightFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != FLIGHT_FILE_MAGIC) {
+        fprintf(stderr, "%s: not a flight recorder file\n", argv[1]);
+        fclose(file);
+        return 1;
+    }
+    if (header.version != FLIGHT_FILE_VERSION || header.recordSize != sizeof(FlightRecord)) {
+        fprintf(stderr, "%s: version %u with %u byte records, expected %u with %zu\n", argv[1],
+                header.version, header.recordSize, FLIGHT_FILE_VERSION, sizeof(FlightRecord));
+        fclose(file);
+        return 1;
+    }
+
+    std::vector<FlightRecord> records(header.recordCount);
+    size_t read = fread(records.data(), sizeof(FlightRecord), records.size(), file);
+    fclose(file);
+    records.resize(read);
+    records.erase(std::remove_if(records.begin(), records.end(),
+                                 [](const FlightRecord& r) { return r.sequence == 0; }), records.end());
+    std::sort(records.begin(), records.end(),
+              [](const FlightRecord& a, const FlightRecord& b) { return a.sequence < b.sequence; });
+    if (records.empty()) {
+        printf("No records\n");
+        return 0;
+    }
+
+    uint32_t frames = 0, valid = 0, concealed = 0, maxIntervalUs = 0, maxLatchUs = 0;
+    uint64_t intervalSumUs = 0;
+    for (const FlightRecord& r : records) {
+        PrintTime(header, r.timeNs);
+        switch (r.kind) {
+            case FlightRecord_Frame: {
+                const FlightFrame& f = r.frame;
+                printf("#%u frame %s interval %.2f ms latch %.2f ms (%d) pose age %.2f ms misses %u\n",
+                       r.sequence, (r.flags & FlightFrame_Valid) ? "valid    " :
+                       (r.flags & FlightFrame_Concealed) ? "concealed" : "missed   ",
+                       f.intervalUs / 1000.0, f.latchUs / 1000.0, f.latchResult, f.poseAgeUs / 1000.0, f.misses);
+                frames++;
+                if (r.flags & FlightFrame_Valid) valid++;
+                if (r.flags & FlightFrame_Concealed) concealed++;
+                intervalSumUs += f.intervalUs;
+                maxIntervalUs = std::max(maxIntervalUs, f.intervalUs);
+                maxLatchUs = std::max(maxLatchUs, f.latchUs);
+                break;
+            }
+            case FlightRecord_Stats: {
+                const FlightStats& s = r.stats;
+                printf("#%u stats %.1f fps %u kbps RTT %u ms jitter %u us lost %u quality %u reasons 0x%x\n",
+                       r.sequence, s.fps, s.bitrateKbps, s.roundTripMs, s.jitterUs, r.aux,
+                       s.quality, s.qualityReasons);
+                break;
+            }
+            case FlightRecord_Lifecycle: {
+                const FlightLifecycle& l = r.lifecycle;
+                printf("#%u lifecycle state %d -> %d error %d, acted on after %.2f ms\n",
+                       r.sequence, l.from, l.to, l.error, l.actedAfterUs / 1000.0);
+                break;
+            }
+            case FlightRecord_Tuning: {
+                if (r.flags & FlightTuning_Text) {
+                    printf("#%u tuning key %u changed\n", r.sequence, r.aux);
+                } else {
+                    printf("#%u tuning key %u %u -> %u\n", r.sequence, r.aux, r.tuning.from, r.tuning.to);
+                }
+                break;
+            }
+            default:
+                printf("#%u unknown kind %u\n", r.sequence, r.kind);
+                break;
+        }
+    }
+
+    double spanSec = (records.back().timeNs - records.front().timeNs) / 1e9;
+    printf("\n%zu records over %.1f s, %u torn\n", records.size(), spanSec,
+           records.back().sequence - records.front().sequence + 1 - (uint32_t)records.size());
+    if (frames) {
+        printf("%u frames: %u valid, %u concealed, %u missed; interval avg %.2f max %.2f ms; latch max %.2f ms\n",
+               frames, valid, concealed, frames - valid - concealed,
+               intervalSumUs / 1000.0 / frames, maxIntervalUs / 1000.0, maxLatchUs / 1000.0);
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Feeds FrameTracker server timestamps the way a stream delivers them and
+ * checks the drops and repeats it counts: a server at the requested rate, one
+ * settled at half of it, one dropping every fifth frame, a repeated frame and
+ * a server clock that starts over.
+ *
+ *   g++ -std=c++11 -O2 -DLOG_SYNCHRONOUS -I tools/host -I app/src/main/jni -I $CLOUDXR_SDK_ROOT/include \
+ *       tools/FrameTrackerCheck.cpp app/src/main/jni/FrameTracker.cpp -o FrameTrackerCheck
+ *   ./FrameTrackerCheck
+ *
+ * Each case waits out a one second FrameTracker window. Exits 1 on a failure.
+ * */
+
+#include <android/log.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+
+#include "Check.h"
+#include "FrameTracker.h"
+
+struct Stream
+{
+    float requestedFps;
+    float serverFps;
+    uint32_t dropEvery;         // every n-th server frame never arrives, 0 for none
+};
+
+// Latches frames frames of stream and returns the counters of the window
+static FrameCounters Run(const Stream& stream, uint32_t frames) {
+    FrameTracker tracker;
+    tracker.reset(stream.requestedFps);
+
+    cxrFramesLatched latched = {};
+    latched.frames[0].widthFinal = 1920;
+    latched.frames[0].heightFinal = 1920;
+    uint64_t periodNs = (uint64_t)(1e9 / stream.serverFps);
+    uint64_t serverNs = 1000000000ull;
+    for (uint32_t i = 0; i < frames; i++) {
+        serverNs += periodNs;
+        if (stream.dropEvery && i % stream.dropEvery == stream.dropEvery - 1) serverNs += periodNs;
+        latched.frames[0].timeStamp = serverNs;
+        tracker.onLatched(latched);
+    }
+
+    FrameCounters counters;
+    while (!tracker.poll(counters)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return counters;
+}
+
+static void Print(const char* name, const FrameCounters& counters) {
+    printf("%-24s %u frames, %u drops, %u repeats\n", name, counters.frames, counters.drops, counters.repeats);
+}
+
+int main() {
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+
+    FrameCounters full = Run({ 90.0f, 90.0f, 0 }, 900);
+    Print("90 fps, 90 requested", full);
+    CHECK(full.frames == 900 && full.drops == 0);
+
+    // The server settled below the request, its rate is the cadence and nothing is dropped
+    FrameCounters half = Run({ 90.0f, 45.0f, 0 }, 450);
+    Print("45 fps, 90 requested", half);
+    CHECK(half.drops == 0);
+
+    FrameCounters low = Run({ 72.0f, 30.0f, 0 }, 300);
+    Print("30 fps, 72 requested", low);
+    CHECK(low.drops == 0);
+
+    // One frame in five missing from the sequence, from the first window on
+    FrameCounters dropping = Run({ 90.0f, 90.0f, 5 }, 720);
+    Print("90 fps, every 5th lost", dropping);
+    CHECK(dropping.drops >= 720 / 5 - 2 && dropping.drops <= 720 / 5);
+
+    // The same timestamp twice is a repeat, not a drop
+    {
+        FrameTracker tracker;
+        tracker.reset(90.0f);
+        cxrFramesLatched latched = {};
+        for (uint32_t i = 0; i < 100; i++) {
+            latched.frames[0].timeStamp = 1000000000ull + (i - (i >= 50)) * 11111111ull;
+            tracker.onLatched(latched);
+        }
+        FrameCounters counters;
+        while (!tracker.poll(counters)) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Print("90 fps, one repeat", counters);
+        CHECK(counters.repeats == 1 && counters.drops == 0);
+    }
+
+    // A restarted stream starts its clock over, the step back is neither drops nor a new cadence
+    {
+        FrameTracker tracker;
+        tracker.reset(90.0f);
+        cxrFramesLatched latched = {};
+        for (uint32_t i = 0; i < 400; i++) {
+            uint64_t start = i < 200 ? 50000000000ull : 1000000000ull;
+            latched.frames[0].timeStamp = start + (i % 200) * 11111111ull;
+            tracker.onLatched(latched);
+        }
+        FrameCounters counters;
+        while (!tracker.poll(counters)) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Print("90 fps, clock restarted", counters);
+        CHECK(counters.frames == 400 && counters.drops == 0);
+    }
+
+    if (sFailures) {
+        printf("FrameTrackerCheck: %d failures\n", sFailures);
+        return 1;
+    }
+    printf("FrameTrackerCheck: ok\n");
+    return 0;
+}
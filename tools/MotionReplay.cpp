@@ -0,0 +1,193 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Replays a motion recording on the host through MotionReplayer, the same code
+ * the replayMotionPct tuning key runs on the headset, and reports how closely
+ * the records are delivered to their recorded timing.
+ *
+ *   adb pull /sdcard/CloudXRMotion.bin
+ *   g++ -std=c++11 -O2 -DLOG_SYNCHRONOUS -I tools/host -I app/src/main/jni -I $VR_SDK_ROOT/include \
+ *       tools/MotionReplay.cpp app/src/main/jni/MotionRecorder.cpp -lpthread -o MotionReplay
+ *   ./MotionReplay CloudXRMotion.bin [speedPct]
+ *   ./MotionReplay --bench CloudXRMotion.bin [passes]
+ *   ./MotionReplay --synth out.bin [seconds]
+ *
+ * speedPct defaults to 100, 0 replays as fast as possible. --bench decodes the
+ * whole file passes times (default 100) and prints records per second. --synth
+ * records a head turn at 90 Hz with both controllers and a button press every
+ * second through MotionRecorder, for a recording that is the same on every
+ * machine. Exits 1 if a record is lost or its timestamp doesn't come back.
+ * */
+
+#include <android/log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "MotionRecorder.h"
+
+// Synthetic WVR timestamps lag the record call by this much
+static const int64_t SYNTH_POSE_AGE_US = 2000;
+static const int64_t SYNTH_EVENT_AGE_US = 500;
+// Records delivered later than this count as late, about a frame at 90 Hz
+static const int64_t LATE_US = 11000;
+
+static int64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t Percentile(std::vector<int64_t>& values, double fraction) {
+    if (values.empty()) return 0;
+    size_t index = std::min(values.size() - 1, (size_t)(values.size() * fraction));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static int Synth(const char* path, double seconds) {
+    MotionRecorder recorder;
+    if (!recorder.start(path)) {
+        fprintf(stderr, "%s: can't record\n", path);
+        return 1;
+    }
+
+    const int64_t frameUs = 11111;
+    int64_t begin = NowUs();
+    uint32_t frames = (uint32_t)(seconds * 90.0);
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                std::chrono::microseconds(begin + frame * frameUs)));
+        int64_t now = NowUs();
+        double t = frame / 90.0;
+
+        // Yaw back and forth, 1 rad/s at the peak
+        WVR_PoseState_t pose = {};
+        double yaw = sin(t);
+        pose.poseMatrix.m[0][0] = (float)cos(yaw);
+        pose.poseMatrix.m[0][2] = (float)sin(yaw);
+        pose.poseMatrix.m[1][1] = 1.0f;
+        pose.poseMatrix.m[2][0] = (float)-sin(yaw);
+        pose.poseMatrix.m[2][2] = (float)cos(yaw);
+        pose.poseMatrix.m[1][3] = 1.6f;
+        pose.angularVelocity.v[1] = (float)cos(t);
+        pose.isValidPose = true;
+        pose.is6DoFPose = true;
+        pose.timestamp = (now - SYNTH_POSE_AGE_US) * 1000;
+        recorder.recordPose(WVR_DeviceType_HMD, pose);
+
+        pose.poseMatrix.m[1][3] = 1.1f;
+        recorder.recordPose(WVR_DeviceType_Controller_Left, pose);
+        recorder.recordPose(WVR_DeviceType_Controller_Right, pose);
+
+        if (frame % 90 == 45) {
+            WVR_Event_t event = {};
+            event.common.type = (frame / 90) % 2 ? WVR_EventType_ButtonUnpressed : WVR_EventType_ButtonPressed;
+            event.common.timestamp = (now - SYNTH_EVENT_AGE_US) * 1000;
+            event.device.deviceType = WVR_DeviceType_Controller_Right;
+            event.input.inputId = WVR_InputId_Alias1_Trigger;
+            recorder.recordEvent(event);
+        }
+    }
+    recorder.stop();
+    printf("%s: %u frames of synthetic motion\n", path, frames);
+    return 0;
+}
+
+static int Bench(const char* path, uint32_t passes) {
+    MotionReplayer replayer;
+    if (!replayer.open(path)) {
+        fprintf(stderr, "%s: not a motion recording\n", path);
+        return 1;
+    }
+
+    MotionSample sample;
+    uint64_t records = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        replayer.rewind();
+        while (replayer.next(sample)) records++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("%llu records in %.3f s, %.1f M records/s, %.0f ns per record\n",
+           (unsigned long long)records, seconds, records / seconds / 1e6, seconds * 1e9 / std::max<uint64_t>(records, 1));
+    return records > 0 ? 0 : 1;
+}
+
+static int Replay(const char* path, uint32_t speedPct) {
+    MotionReplayer replayer;
+    if (!replayer.open(path)) {
+        fprintf(stderr, "%s: not a motion recording\n", path);
+        return 1;
+    }
+
+    // What the file holds, to compare against what run() delivers
+    std::vector<MotionSample> expected;
+    MotionSample sample;
+    while (replayer.next(sample)) expected.push_back(sample);
+    replayer.rewind();
+    if (expected.empty()) {
+        fprintf(stderr, "%s: no records\n", path);
+        return 1;
+    }
+
+    float speed = speedPct / 100.0f;
+    std::vector<int64_t> lateness;
+    lateness.reserve(expected.size());
+    uint32_t poses = 0, events = 0, ageErrors = 0, aged = 0;
+    size_t index = 0;
+    int64_t begin = NowUs();
+
+    // Both handlers see the records in file order, index follows along
+    auto check = [&](int64_t timestampNs) {
+        int64_t now = NowUs();
+        const MotionSample& recorded = expected[std::min(index, expected.size() - 1)];
+        lateness.push_back(now - begin - (speed > 0.0f ? (int64_t)(recorded.timeUs / speed) : 0));
+        if (recorded.ageUs >= 0) {
+            aged++;
+            // The replay stamps just before the call, allow for the handler getting there
+            int64_t age = now - timestampNs / 1000;
+            if (age < recorded.ageUs || age > recorded.ageUs + 1000) ageErrors++;
+        }
+        index++;
+    };
+    uint32_t count = replayer.run(speed,
+        [&](WVR_DeviceType, const WVR_PoseState_t& pose) { poses++; check(pose.timestamp); },
+        [&](const WVR_Event_t& event) { events++; check(event.common.timestamp); });
+
+    int64_t p50 = Percentile(lateness, 0.5);
+    int64_t p99 = Percentile(lateness, 0.99);
+    int64_t worst = *std::max_element(lateness.begin(), lateness.end());
+    uint32_t late = (uint32_t)std::count_if(lateness.begin(), lateness.end(),
+                                            [](int64_t us) { return us > LATE_US; });
+    printf("%u records (%u poses, %u events) over %.2f s at %u%%\n", count, poses, events,
+           (NowUs() - begin) / 1e6, speedPct);
+    printf("delivery after the recorded time: p50 %lld us, p99 %lld us, max %lld us, %u over %lld us\n",
+           (long long)p50, (long long)p99, (long long)worst, late, (long long)LATE_US);
+    printf("%u records with a WVR timestamp, %u restamped wrong\n", aged, ageErrors);
+
+    bool ok = count == expected.size() && poses + events == count && ageErrors == 0;
+    printf("MotionReplay: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+    if (argc >= 3 && strcmp(argv[1], "--synth") == 0) {
+        return Synth(argv[2], argc > 3 ? atof(argv[3]) : 5.0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) {
+        return Bench(argv[2], argc > 3 ? (uint32_t)atoi(argv[3]) : 100);
+    }
+    if (argc >= 2 && argv[1][0] != '-') {
+        return Replay(argv[1], argc > 2 ? (uint32_t)atoi(argv[2]) : 100);
+    }
+    fprintf(stderr, "usage: %s CloudXRMotion.bin [speedPct]\n"
+                    "       %s --bench CloudXRMotion.bin [passes]\n"
+                    "       %s --synth out.bin [seconds]\n", argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,184 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Runs the per-frame work of the client components that build on the host
+ * inside NoAllocScope, the way renderFrame, updatePose and GetTrackingState do,
+ * and fails if any of it allocates. Covers user data send, flush and loopback
+ * receive, the lifecycle queue, frame and pose latency tracking, pose sampling,
+ * the flight recorder, stall phases and logging.
+ *
+ *   g++ -std=c++11 -O2 -DCXR_TRACK_ALLOCATIONS -I tools/host -I app/src/main/jni \
+ *       -I $CLOUDXR_SDK_ROOT/include -I $VR_SDK_ROOT/include tools/NoAllocCheck.cpp \
+ *       app/src/main/jni/{AllocTracker,AsyncLog,ThreadManager,UserDataChannel,LifecycleEventQueue}.cpp \
+ *       app/src/main/jni/{FrameTracker,PoseLatencyTracker,FlightRecorder,StallWatchdog,PoseSampler}.cpp \
+ *       -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -lpthread -o NoAllocCheck
+ *   ./NoAllocCheck [frames]
+ *
+ * frames defaults to 10000. The first frames may set up per thread buffers inside
+ * AllocAllowedScope, after WARMUP_FRAMES nothing may allocate at all. Exits 1 on a
+ * failure.
+ * */
+
+#include <log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+
+#include "AllocTracker.h"
+#include "FlightRecorder.h"
+#include "FrameTracker.h"
+#include "LifecycleEventQueue.h"
+#include "PoseLatencyTracker.h"
+#include "PoseSampler.h"
+#include "StallWatchdog.h"
+#include "UserDataChannel.h"
+
+static const uint32_t WARMUP_FRAMES = 10;
+static const char* RECORDER_PATH = "NoAllocCheck.bin";
+
+// Only the loopback transport is used, the CloudXR one is never handed a receiver
+extern "C" cxrError cxrSendUserData(cxrReceiverHandle, const void*, uint32_t) {
+    return cxrError_Not_Connected;
+}
+
+struct SampleMessage
+{
+    uint32_t frame;
+    float values[8];
+};
+
+struct ThreadResult
+{
+    uint64_t allocations = 0;   // after the warmup
+    uint64_t violations = 0;
+};
+
+static bool Report(const char* name, const ThreadResult& result) {
+    printf("%-8s %llu allocations after warmup, %llu in no-alloc regions\n", name,
+           (unsigned long long)result.allocations, (unsigned long long)result.violations);
+    return result.allocations == 0 && result.violations == 0;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t frames = argc > 1 ? (uint32_t)atoi(argv[1]) : 10000;
+    if (!AllocTracker::Enabled()) {
+        fprintf(stderr, "Build with -DCXR_TRACK_ALLOCATIONS and the --wrap flags, see the top of this file\n");
+        return 2;
+    }
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+    AsyncLog::Instance().start();
+
+    // The server end of the user data channel counts what arrives
+    UserDataChannel client, server;
+    std::atomic<uint32_t> received{0};
+    server.setHandler<SampleMessage>(1, [&received](const SampleMessage&) { received++; });
+    LoopbackTransport toServer(server);
+    client.start(&toServer);
+    server.start(nullptr);
+
+    LifecycleEventQueue lifecycle;
+    FrameTracker frameTracker;
+    frameTracker.reset(90.0f);
+    PoseLatencyTracker poseLatency;
+    StallWatchdog watchdog;
+    FlightRecorder recorder;
+    recorder.start(RECORDER_PATH, 1024);
+
+    // Pose thread: sampling decisions and the poses GetTrackingState hands out
+    ThreadResult poseResult;
+    std::thread poseThread([&]() {
+        PoseSampler sampler;
+        sampler.configure(0, 250);
+        sampler.setDisplayHz(90.0f);
+        sampler.reset(PoseSampler::NowNs());
+        AllocCounters warm = {};
+        for (uint32_t tick = 0; tick < frames * 3; tick++) {
+            if (tick == WARMUP_FRAMES) warm = AllocTracker::Current();
+            NoAllocScope noAlloc("updatePose");
+            watchdog.beat(Watched_Pose);
+            StallPhase phase(watchdog, Watched_Pose, "WVR_GetPoseState");
+            int64_t now = PoseSampler::NowNs();
+            WVR_PoseState_t pose = {};
+            pose.isValidPose = true;
+            pose.velocity.v[0] = 0.01f * (tick % 50);
+            for (int source = 0; source < PoseSource_Count; source++) {
+                sampler.onSample((PoseSource)source, pose, now, 2000);
+            }
+            cxrTrackedDevicePose hmd = {};
+            hmd.position.v[1] = 1.6f + 0.001f * (tick % 100);
+            hmd.rotation.w = 1.0f;
+            hmd.poseIsValid = cxrTrue;
+            poseLatency.onPoseSent(hmd, now);
+            if (tick % 1000 == 0) LOGW("[NoAllocCheck] pose tick %u", tick);
+        }
+        AllocCounters end = AllocTracker::Current();
+        poseResult.allocations = end.allocations - warm.allocations;
+        poseResult.violations = end.violations;
+    });
+
+    // Render thread
+    AllocCounters warm = {};
+    FlightFrame flightFrame = {};
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (frame == WARMUP_FRAMES) warm = AllocTracker::Current();
+        NoAllocScope noAlloc("renderFrame");
+        watchdog.beat(Watched_Main);
+        StallPhase phase(watchdog, Watched_Main, "renderFrame");
+
+        SampleMessage message = {};
+        message.frame = frame;
+        client.send(1, &message, sizeof(message));
+        client.write(2, 64, [frame](uint8_t* out) {
+            out[0] = (uint8_t)frame;
+            return 1u;
+        });
+        client.flush();
+
+        if (frame % 500 == 0) lifecycle.push(cxrClientState_StreamingSessionInProgress, cxrError_Success);
+        LifecycleEvent event;
+        while (lifecycle.pop(event)) {}
+
+        cxrFramesLatched latched = {};
+        latched.count = 2;
+        latched.frames[0].widthFinal = 1920;
+        latched.frames[0].heightFinal = 1920;
+        latched.frames[0].timeStamp = frame * 11111111ULL;
+        latched.poseMatrix.m[1][3] = 1.6f + 0.001f * (frame % 100);
+        frameTracker.onLatched(latched);
+        poseLatency.onLatched(latched.poseMatrix);
+        poseLatency.onSubmitted();
+
+        FrameCounters counters;
+        frameTracker.poll(counters);
+
+        flightFrame.intervalUs = 11111;
+        flightFrame.poseAgeUs = poseLatency.latchedAgeUs();
+        recorder.recordFrame(flightFrame, 1);
+        if (frame % 90 == 0) {
+            cxrConnectionStats stats = {};
+            recorder.recordStats(stats);
+        }
+        if (frame % 1000 == 0) LOGW("[NoAllocCheck] frame %u", frame);
+    }
+    AllocCounters end = AllocTracker::Current();
+    ThreadResult renderResult;
+    renderResult.allocations = end.allocations - warm.allocations;
+    renderResult.violations = end.violations;
+
+    poseThread.join();
+    client.stop();
+    server.stop();
+    recorder.stop();
+    AsyncLog::Instance().stop();
+    remove(RECORDER_PATH);
+    remove((std::string(RECORDER_PATH) + ".prev").c_str());
+
+    // Frames run back to back, faster than the dispatch thread drains the receive pool
+    printf("%u frames, %u of %u user data messages delivered, the rest dropped by a full pool\n",
+           frames, received.load(), frames);
+    bool ok = Report("render", renderResult);
+    ok = Report("pose", poseResult) && ok;
+    printf("NoAllocCheck: %s\n", ok ? "no allocations" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Probes loopback stand-ins for CloudXR servers with ServerProbe: two listening
+ * on 127.0.0.1 and 127.0.0.3, none on 127.0.0.2. Checks that the unreachable one
+ * is never picked, that failures reported from another thread, the way
+ * HandleClientState does, move the pick to the other server, and that
+ * startProbe() returns right away while the probe runs.
+ *
+ *   g++ -std=c++11 -O2 -DLOG_SYNCHRONOUS -I tools/host -I app/src/main/jni tools/ServerProbeCheck.cpp \
+ *       app/src/main/jni/ServerProbe.cpp app/src/main/jni/ThreadManager.cpp -lpthread -o ServerProbeCheck
+ *   ./ServerProbeCheck
+ *
+ * Exits 1 on a failure. A -fsanitize=thread build also checks that the failure
+ * reports and the background probe lock against pick().
+ * */
+
+#include <android/log.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <thread>
+
+#include "Check.h"
+#include "ServerProbe.h"
+
+// The kernel completes the handshake from the backlog, nothing needs to accept
+static int Listen(const char* address, uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, address, &addr.sin_addr);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        perror(address);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+int main() {
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+
+    uint16_t port = 0;
+    int first = Listen("127.0.0.1", port);
+    int second = Listen("127.0.0.3", port);
+    if (first < 0 || second < 0) {
+        return 1;
+    }
+
+    ServerProbe probe(port);
+    probe.setCandidates(ServerProbe::SplitServerList("127.0.0.2, 127.0.0.1,127.0.0.3"));
+    CHECK(probe.candidateCount() == 3);
+    probe.probe(300, 3);
+    std::string picked = probe.pick();
+    CHECK(picked == "127.0.0.1" || picked == "127.0.0.3");
+
+    // A connection attempt failing on the CloudXR thread while the main thread keeps picking
+    std::string other = picked == "127.0.0.1" ? "127.0.0.3" : "127.0.0.1";
+    std::thread callback([&probe]() { probe.reportConnectFailure(); });
+    for (int i = 0; i < 1000; i++) CHECK(probe.best() != "127.0.0.2");
+    callback.join();
+    CHECK(probe.pick() == other);
+
+    // Failures count per candidate, the fewer wins again
+    probe.reportConnectFailure();
+    probe.reportConnectFailure();
+    CHECK(probe.pick() == picked);
+
+    // The reconnect path, the caller keeps running while the candidates are probed
+    auto begin = std::chrono::steady_clock::now();
+    probe.startProbe(300, 3);
+    double startMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    probe.startProbe(300, 3);   // ignored while one runs
+    uint32_t polls = 0;
+    while (probe.probing()) {
+        polls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printf("startProbe returned after %.2f ms, results after %u polls\n", startMs, polls);
+    CHECK(startMs < 50.0);
+    CHECK(probe.pick() == picked);
+
+    // A server going away is noticed by the next probe
+    close(picked == "127.0.0.1" ? first : second);
+    probe.startProbe(300, 3);
+    while (probe.probing()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(probe.pick() == other);
+    close(picked == "127.0.0.1" ? second : first);
+
+    if (sFailures) {
+        printf("ServerProbeCheck: %d failures\n", sFailures);
+        return 1;
+    }
+    printf("ServerProbeCheck: ok\n");
+    return 0;
+}
@@ -0,0 +1,222 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+/*
+ * Round trips user data messages between two UserDataChannels joined by a
+ * LoopbackTransport each way, the way the client and a server plugin talk over
+ * CloudXR user data. Covers fixed size and raw messages, batching of small
+ * messages, the largest payload, oversized and malformed input, unhandled types
+ * and a stop() racing a receive on the callback thread.
+ *
+ *   g++ -std=c++11 -O2 -DLOG_SYNCHRONOUS -I tools/host -I app/src/main/jni -I $CLOUDXR_SDK_ROOT/include \
+ *       tools/UserDataCheck.cpp app/src/main/jni/UserDataChannel.cpp app/src/main/jni/ThreadManager.cpp \
+ *       -lpthread -o UserDataCheck
+ *   ./UserDataCheck
+ *
+ * Exits 1 on a failure. Run a -fsanitize=thread build too, the stop race is
+ * only half checked without it.
+ * */
+
+#include <android/log.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Check.h"
+#include "UserDataChannel.h"
+
+// Only the loopback transport is used
+extern "C" cxrError cxrSendUserData(cxrReceiverHandle, const void*, uint32_t) {
+    return cxrError_Not_Connected;
+}
+
+enum MessageType : uint8_t
+{
+    Message_Ping = 1,       // fixed size, echoed back as Message_Pong
+    Message_Pong,
+    Message_Blob,           // raw, any size, echoed back as Message_BlobEcho
+    Message_BlobEcho,
+    Message_Session,        // fixed size, for the stop() race
+    Message_Unhandled = 200,
+};
+
+struct Ping
+{
+    uint32_t sequence;
+    float pose[7];
+};
+
+static uint32_t Checksum(const uint8_t* data, uint32_t size) {
+    uint32_t sum = 2166136261u;
+    for (uint32_t i = 0; i < size; i++) sum = (sum ^ data[i]) * 16777619u;
+    return sum;
+}
+
+static void Fill(std::vector<uint8_t>& blob, uint32_t size, uint32_t seed) {
+    blob.resize(size);
+    for (uint32_t i = 0; i < size; i++) blob[i] = (uint8_t)(seed * 31 + i * 7);
+}
+
+// Waits for the dispatch thread to catch up
+template<typename Done>
+static bool WaitFor(Done done) {
+    for (int i = 0; i < 2000 && !done(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return done();
+}
+
+static void CheckRoundTrip() {
+    UserDataChannel client, server;
+    LoopbackTransport toServer(server), toClient(client);
+
+    // The server echoes, sending from its dispatch thread and flushing right away
+    std::mutex serverMutex;
+    server.setHandler<Ping>(Message_Ping, [&](const Ping& ping) {
+        std::lock_guard<std::mutex> lock(serverMutex);
+        server.send(Message_Pong, &ping, sizeof(ping));
+        server.flush();
+    });
+    server.setHandler(Message_Blob, [&](const uint8_t* payload, uint32_t size) {
+        std::lock_guard<std::mutex> lock(serverMutex);
+        server.send(Message_BlobEcho, payload, size);
+        server.flush();
+    });
+
+    std::atomic<uint32_t> pongs{0}, badPongs{0}, blobs{0}, badBlobs{0}, unhandled{0};
+    std::atomic<uint64_t> blobBytes{0};
+    client.setHandler<Ping>(Message_Pong, [&](const Ping& ping) {
+        if (ping.sequence != pongs || ping.pose[6] != ping.sequence * 0.5f) badPongs++;
+        pongs++;
+    });
+    client.setHandler(Message_BlobEcho, [&](const uint8_t* payload, uint32_t size) {
+        std::vector<uint8_t> expected;
+        Fill(expected, size, size);
+        if (Checksum(payload, size) != Checksum(expected.data(), size)) badBlobs++;
+        blobs++;
+        blobBytes += size;
+    });
+    // Message_Unhandled has no handler, its neighbour must not get it either
+    server.setHandler(Message_Unhandled + 1, [&](const uint8_t*, uint32_t) { unhandled++; });
+
+    client.start(&toServer);
+    server.start(&toClient);
+
+    // Small messages batched into one packet per frame, in order
+    const uint32_t PINGS = 1000;
+    for (uint32_t i = 0; i < PINGS; i++) {
+        Ping ping = {};
+        ping.sequence = i;
+        ping.pose[6] = i * 0.5f;
+        CHECK(client.send(Message_Ping, &ping, sizeof(ping)));
+        if (i % 10 == 9) {
+            client.flush();
+            // Stay under the receive pool, a full pool drops like on the headset
+            WaitFor([&]() { return pongs == i + 1; });
+        }
+    }
+    CHECK(WaitFor([&]() { return pongs == PINGS; }));
+    CHECK(badPongs == 0);
+
+    // Raw payloads of every size class up to the largest that fits a packet
+    const uint32_t sizes[] = { 1, 2, 3, 64, 500, 1000, UserDataChannel::MAX_PAYLOAD };
+    uint64_t sentBytes = 0;
+    std::vector<uint8_t> blob;
+    for (uint32_t size : sizes) {
+        Fill(blob, size, size);
+        CHECK(client.send(Message_Blob, blob.data(), size));
+        client.flush();
+        sentBytes += size;
+    }
+    uint32_t blobCount = sizeof(sizes) / sizeof(sizes[0]);
+    CHECK(WaitFor([&]() { return blobs == blobCount; }));
+    CHECK(badBlobs == 0 && blobBytes == sentBytes);
+
+    // Too large for a packet, nothing is sent
+    Fill(blob, UserDataChannel::MAX_PAYLOAD + 1, 0);
+    CHECK(!client.send(Message_Blob, blob.data(), (uint32_t)blob.size()));
+    // write() cancelled by returning 0 or overrunning its size
+    CHECK(!client.write(Message_Blob, 16, [](uint8_t*) { return 0u; }));
+    CHECK(!client.write(Message_Blob, 16, [](uint8_t*) { return 17u; }));
+    // Wrong size for a fixed size handler, no type handler at all
+    CHECK(client.send(Message_Ping, blob.data(), sizeof(Ping) - 1));
+    CHECK(client.send(Message_Unhandled, blob.data(), 8));
+    client.flush();
+
+    // Malformed packets straight from the transport: truncated header, length past the end
+    const uint8_t truncated[] = { 4, 0 };
+    const uint8_t overrun[] = { 200, 0, Message_Blob, 1, 2, 3 };
+    server.receive(truncated, sizeof(truncated));
+    server.receive(overrun, sizeof(overrun));
+    server.receive(blob.data(), 0);
+
+    // The channel still works after all of it
+    Ping last = {};
+    last.sequence = PINGS;
+    last.pose[6] = PINGS * 0.5f;
+    CHECK(client.send(Message_Ping, &last, sizeof(last)));
+    client.flush();
+    CHECK(WaitFor([&]() { return pongs == PINGS + 1; }));
+    CHECK(blobs == blobCount && badPongs == 0 && unhandled == 0);
+
+    client.stop();
+    server.stop();
+    printf("round trip: %u pings, %u raw messages of up to %u bytes\n", pongs.load(), blobs.load(),
+           UserDataChannel::MAX_PAYLOAD);
+}
+
+// The CloudXR thread keeps delivering while the main thread stops and restarts
+// the channel, as shutdownCloudXR and initCloudXR do on a reconnect
+static void CheckStopRace() {
+    UserDataChannel channel;
+    std::atomic<uint32_t> session{0}, stale{0}, delivered{0};
+    channel.setHandler<uint32_t>(Message_Session, [&](const uint32_t& sent) {
+        if (sent != session) stale++;
+        delivered++;
+    });
+
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> calls{0};
+    std::thread callback([&]() {
+        uint8_t packet[UserDataChannel::FRAME_HEADER + sizeof(uint32_t)] = { sizeof(uint32_t), 0, Message_Session };
+        while (!done) {
+            uint32_t current = session;
+            memcpy(packet + UserDataChannel::FRAME_HEADER, &current, sizeof(current));
+            channel.receive(packet, sizeof(packet));
+            calls++;
+        }
+    });
+
+    const uint32_t SESSIONS = 2000;
+    for (uint32_t i = 0; i < SESSIONS; i++) {
+        channel.start(nullptr);
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        channel.stop();
+        session++;
+        // The second call to return started after the new session, everything before it is done
+        uint32_t seen = calls;
+        while (calls < seen + 2) std::this_thread::yield();
+    }
+    done = true;
+    callback.join();
+
+    // Packets of a stopped session must not reach the next one
+    printf("stop race: %u sessions, %u messages delivered, %u from a stopped session\n",
+           SESSIONS, delivered.load(), stale.load());
+    CHECK(stale == 0);
+    CHECK(delivered > 0);
+}
+
+int main() {
+    HostLogMinPriority() = ANDROID_LOG_WARN;
+    CheckRoundTrip();
+    CheckStopRace();
+
+    if (sFailures) {
+        printf("UserDataCheck: %d failures\n", sFailures);
+        return 1;
+    }
+    printf("UserDataCheck: ok\n");
+    return 0;
+}
@@ -0,0 +1,19 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+
+/*
+ * Assertions of the host checks in tools/. A failed CHECK prints where and
+ * carries on, main() reports sFailures at the end and exits 1 if any.
+ * */
+
+#include <stdio.h>
+
+static int sFailures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        sFailures++; \
+    } \
+} while (0)
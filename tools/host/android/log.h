@@ -0,0 +1,64 @@
+//========= Copyright 2016-2021, HTC Corporation. All rights reserved. ===========
+
+#pragma once
+
+/*
+ * Host stand-in for the NDK's <android/log.h>, so the host checks in tools/
+ * can build client sources that log. Put tools/host first on the include path
+ * and build with -DLOG_SYNCHRONOUS, everything goes to stderr.
+ * */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT,
+};
+
+// Messages below this priority are dropped, checks raise it to keep their output short
+inline int& HostLogMinPriority() {
+    static int priority = ANDROID_LOG_INFO;
+    return priority;
+}
+
+static inline int __android_log_vprint(int prio, const char* tag, const char* fmt, va_list ap) {
+    if (prio < HostLogMinPriority()) return 0;
+    static const char kLevels[] = "??VDIWEFS";
+    fprintf(stderr, "%c/%s: ", kLevels[prio & 7], tag);
+    int n = vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    return n;
+}
+
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = __android_log_vprint(prio, tag, fmt, ap);
+    va_end(ap);
+    return n;
+}
+
+static inline int __android_log_write(int prio, const char* tag, const char* text) {
+    return __android_log_print(prio, tag, "%s", text);
+}
+
+static inline void __android_log_assert(const char* cond, const char* tag, const char* fmt, ...)
+        __attribute__((noreturn, format(printf, 3, 4)));
+static inline void __android_log_assert(const char* cond, const char* tag, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    __android_log_vprint(ANDROID_LOG_FATAL, tag, fmt, ap);
+    va_end(ap);
+    abort();
+}